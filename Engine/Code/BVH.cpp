@@ -0,0 +1,531 @@
+#include "BVH.h"
+
+#include <chrono>
+#include <random>
+
+#define BVH_STACK_SIZE 256
+
+// Traversal stack for the queries. The fixed part is enough for any tree the
+// rotations keep balanced, whatever goes deeper spills to the heap.
+template <typename T>
+struct QueryStack
+{
+    T local[BVH_STACK_SIZE];
+    std::vector<T> overflow;
+    u32 size = 0;
+
+    bool Empty() const { return size == 0; }
+
+    void Push(const T& value)
+    {
+        if (size < BVH_STACK_SIZE)
+        {
+            local[size] = value;
+        }
+        else
+        {
+            overflow.push_back(value);
+        }
+        size++;
+    }
+
+    T Pop()
+    {
+        size--;
+        if (size < BVH_STACK_SIZE)
+        {
+            return local[size];
+        }
+        const T value = overflow.back();
+        overflow.pop_back();
+        return value;
+    }
+};
+
+static f32 SurfaceArea(const AABB& aabb)
+{
+    const glm::vec3 size = aabb.max - aabb.min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool Contains(const AABB& outer, const AABB& inner)
+{
+    return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+}
+
+static bool Overlaps(const AABB& aabb, const glm::vec3& center, f32 radius)
+{
+    const glm::vec3 closest = glm::clamp(center, aabb.min, aabb.max);
+    const glm::vec3 delta = closest - center;
+    return glm::dot(delta, delta) <= radius * radius;
+}
+
+// Slab test, returns the entry distance through tMin
+static bool RayIntersects(const AABB& aabb, const glm::vec3& origin, const glm::vec3& inverseDirection, f32 maxDistance, f32& tMin)
+{
+    const glm::vec3 t1 = (aabb.min - origin) * inverseDirection;
+    const glm::vec3 t2 = (aabb.max - origin) * inverseDirection;
+    const glm::vec3 tNear = glm::min(t1, t2);
+    const glm::vec3 tFar = glm::max(t1, t2);
+
+    tMin = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+    const f32 tMax = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance));
+    return tMin <= tMax;
+}
+
+static i32 AllocateNode(DynamicAABBTree& tree)
+{
+    if (tree.freeList == BVH_NULL_NODE)
+    {
+        tree.nodes.push_back({});
+        tree.nodes.back().parent = BVH_NULL_NODE;
+        tree.nodes.back().height = -1;
+        tree.freeList = (i32)tree.nodes.size() - 1;
+    }
+
+    const i32 nodeId = tree.freeList;
+    BVHNode& node = tree.nodes[nodeId];
+    tree.freeList = node.parent;
+    node.parent = BVH_NULL_NODE;
+    node.child1 = BVH_NULL_NODE;
+    node.child2 = BVH_NULL_NODE;
+    node.height = 0;
+    node.userData = 0;
+    return nodeId;
+}
+
+static void FreeNode(DynamicAABBTree& tree, i32 nodeId)
+{
+    tree.nodes[nodeId].parent = tree.freeList;
+    tree.nodes[nodeId].height = -1;
+    tree.freeList = nodeId;
+}
+
+// Rotates the taller grandchild up when the children heights differ by more than one
+static i32 Balance(DynamicAABBTree& tree, i32 iA)
+{
+    std::vector<BVHNode>& nodes = tree.nodes;
+    BVHNode& A = nodes[iA];
+    if (A.IsLeaf() || A.height < 2)
+    {
+        return iA;
+    }
+
+    const i32 iB = A.child1;
+    const i32 iC = A.child2;
+    BVHNode& B = nodes[iB];
+    BVHNode& C = nodes[iC];
+    const i32 balance = C.height - B.height;
+
+    // Rotate C up
+    if (balance > 1)
+    {
+        const i32 iF = C.child1;
+        const i32 iG = C.child2;
+        BVHNode& F = nodes[iF];
+        BVHNode& G = nodes[iG];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if (C.parent != BVH_NULL_NODE)
+        {
+            if (nodes[C.parent].child1 == iA) nodes[C.parent].child1 = iC;
+            else                              nodes[C.parent].child2 = iC;
+        }
+        else
+        {
+            tree.root = iC;
+        }
+
+        if (F.height > G.height)
+        {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.aabb = MergeAABB(B.aabb, G.aabb);
+            C.aabb = MergeAABB(A.aabb, F.aabb);
+            A.height = 1 + glm::max(B.height, G.height);
+            C.height = 1 + glm::max(A.height, F.height);
+        }
+        else
+        {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.aabb = MergeAABB(B.aabb, F.aabb);
+            C.aabb = MergeAABB(A.aabb, G.aabb);
+            A.height = 1 + glm::max(B.height, F.height);
+            C.height = 1 + glm::max(A.height, G.height);
+        }
+        return iC;
+    }
+
+    // Rotate B up
+    if (balance < -1)
+    {
+        const i32 iD = B.child1;
+        const i32 iE = B.child2;
+        BVHNode& D = nodes[iD];
+        BVHNode& E = nodes[iE];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if (B.parent != BVH_NULL_NODE)
+        {
+            if (nodes[B.parent].child1 == iA) nodes[B.parent].child1 = iB;
+            else                              nodes[B.parent].child2 = iB;
+        }
+        else
+        {
+            tree.root = iB;
+        }
+
+        if (D.height > E.height)
+        {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.aabb = MergeAABB(C.aabb, E.aabb);
+            B.aabb = MergeAABB(A.aabb, D.aabb);
+            A.height = 1 + glm::max(C.height, E.height);
+            B.height = 1 + glm::max(A.height, D.height);
+        }
+        else
+        {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.aabb = MergeAABB(C.aabb, D.aabb);
+            B.aabb = MergeAABB(A.aabb, E.aabb);
+            A.height = 1 + glm::max(C.height, D.height);
+            B.height = 1 + glm::max(A.height, E.height);
+        }
+        return iB;
+    }
+
+    return iA;
+}
+
+// Walks up from nodeId refitting bounds and heights and rebalancing
+static void Refit(DynamicAABBTree& tree, i32 nodeId)
+{
+    while (nodeId != BVH_NULL_NODE)
+    {
+        nodeId = Balance(tree, nodeId);
+
+        BVHNode& node = tree.nodes[nodeId];
+        const BVHNode& child1 = tree.nodes[node.child1];
+        const BVHNode& child2 = tree.nodes[node.child2];
+        node.height = 1 + glm::max(child1.height, child2.height);
+        node.aabb = MergeAABB(child1.aabb, child2.aabb);
+
+        nodeId = node.parent;
+    }
+}
+
+static void InsertLeaf(DynamicAABBTree& tree, i32 leaf)
+{
+    if (tree.root == BVH_NULL_NODE)
+    {
+        tree.root = leaf;
+        tree.nodes[leaf].parent = BVH_NULL_NODE;
+        return;
+    }
+
+    // Descend towards the sibling that grows the total surface area the least
+    const AABB leafAABB = tree.nodes[leaf].aabb;
+    i32 index = tree.root;
+    while (!tree.nodes[index].IsLeaf())
+    {
+        const BVHNode& node = tree.nodes[index];
+        const f32 area = SurfaceArea(node.aabb);
+        const f32 combinedArea = SurfaceArea(MergeAABB(node.aabb, leafAABB));
+
+        // Cost of pairing the leaf with this node, and the cost pushed down to the children
+        const f32 cost = 2.0f * combinedArea;
+        const f32 inheritanceCost = 2.0f * (combinedArea - area);
+
+        f32 childCosts[2];
+        const i32 children[2] = { node.child1, node.child2 };
+        for (u32 i = 0; i < 2; ++i)
+        {
+            const BVHNode& child = tree.nodes[children[i]];
+            const f32 mergedArea = SurfaceArea(MergeAABB(leafAABB, child.aabb));
+            childCosts[i] = (child.IsLeaf() ? mergedArea : mergedArea - SurfaceArea(child.aabb)) + inheritanceCost;
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1])
+        {
+            break;
+        }
+        index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+
+    const i32 sibling = index;
+    const i32 oldParent = tree.nodes[sibling].parent;
+    const i32 newParent = AllocateNode(tree);
+
+    BVHNode& parentNode = tree.nodes[newParent];
+    parentNode.parent = oldParent;
+    parentNode.aabb = MergeAABB(leafAABB, tree.nodes[sibling].aabb);
+    parentNode.height = tree.nodes[sibling].height + 1;
+    parentNode.child1 = sibling;
+    parentNode.child2 = leaf;
+
+    if (oldParent != BVH_NULL_NODE)
+    {
+        if (tree.nodes[oldParent].child1 == sibling) tree.nodes[oldParent].child1 = newParent;
+        else                                         tree.nodes[oldParent].child2 = newParent;
+    }
+    else
+    {
+        tree.root = newParent;
+    }
+
+    tree.nodes[sibling].parent = newParent;
+    tree.nodes[leaf].parent = newParent;
+
+    Refit(tree, newParent);
+}
+
+static void RemoveLeaf(DynamicAABBTree& tree, i32 leaf)
+{
+    if (leaf == tree.root)
+    {
+        tree.root = BVH_NULL_NODE;
+        return;
+    }
+
+    const i32 parent = tree.nodes[leaf].parent;
+    const i32 grandParent = tree.nodes[parent].parent;
+    const i32 sibling = tree.nodes[parent].child1 == leaf ? tree.nodes[parent].child2 : tree.nodes[parent].child1;
+
+    // The sibling takes the place of the parent
+    if (grandParent != BVH_NULL_NODE)
+    {
+        if (tree.nodes[grandParent].child1 == parent) tree.nodes[grandParent].child1 = sibling;
+        else                                          tree.nodes[grandParent].child2 = sibling;
+        tree.nodes[sibling].parent = grandParent;
+        FreeNode(tree, parent);
+
+        Refit(tree, grandParent);
+    }
+    else
+    {
+        tree.root = sibling;
+        tree.nodes[sibling].parent = BVH_NULL_NODE;
+        FreeNode(tree, parent);
+    }
+}
+
+void ClearTree(DynamicAABBTree& tree)
+{
+    tree.nodes.clear();
+    tree.root = BVH_NULL_NODE;
+    tree.freeList = BVH_NULL_NODE;
+    tree.proxyCount = 0;
+}
+
+i32 CreateProxy(DynamicAABBTree& tree, const AABB& aabb, u32 userData)
+{
+    const i32 proxyId = AllocateNode(tree);
+    BVHNode& node = tree.nodes[proxyId];
+    node.aabb = { aabb.min - glm::vec3(tree.margin), aabb.max + glm::vec3(tree.margin) };
+    node.userData = userData;
+    node.height = 0;
+
+    InsertLeaf(tree, proxyId);
+    tree.proxyCount++;
+    return proxyId;
+}
+
+void DestroyProxy(DynamicAABBTree& tree, i32 proxyId)
+{
+    ASSERT(tree.nodes[proxyId].IsLeaf(), "BVH proxies must be leaves");
+
+    RemoveLeaf(tree, proxyId);
+    FreeNode(tree, proxyId);
+    tree.proxyCount--;
+}
+
+bool MoveProxy(DynamicAABBTree& tree, i32 proxyId, const AABB& aabb)
+{
+    ASSERT(tree.nodes[proxyId].IsLeaf(), "BVH proxies must be leaves");
+
+    // Still inside the fattened bounds, the tree doesn't need to change
+    if (Contains(tree.nodes[proxyId].aabb, aabb))
+    {
+        return false;
+    }
+
+    RemoveLeaf(tree, proxyId);
+    tree.nodes[proxyId].aabb = { aabb.min - glm::vec3(tree.margin), aabb.max + glm::vec3(tree.margin) };
+    InsertLeaf(tree, proxyId);
+    return true;
+}
+
+u32 GetTreeHeight(const DynamicAABBTree& tree)
+{
+    return tree.root == BVH_NULL_NODE ? 0 : tree.nodes[tree.root].height;
+}
+
+void QuerySphere(const DynamicAABBTree& tree, const glm::vec3& center, f32 radius, std::vector<u32>& results)
+{
+    if (tree.root == BVH_NULL_NODE)
+    {
+        return;
+    }
+
+    QueryStack<i32> stack;
+    stack.Push(tree.root);
+
+    while (!stack.Empty())
+    {
+        const BVHNode& node = tree.nodes[stack.Pop()];
+        if (!Overlaps(node.aabb, center, radius))
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            results.push_back(node.userData);
+            continue;
+        }
+
+        stack.Push(node.child1);
+        stack.Push(node.child2);
+    }
+}
+
+bool QueryRay(const DynamicAABBTree& tree, const glm::vec3& origin, const glm::vec3& direction, f32 maxDistance, u32& hitUserData, f32& hitDistance)
+{
+    if (tree.root == BVH_NULL_NODE)
+    {
+        return false;
+    }
+
+    const glm::vec3 inverseDirection = 1.0f / direction;
+    bool hit = false;
+    hitDistance = maxDistance;
+
+    QueryStack<i32> stack;
+    stack.Push(tree.root);
+
+    while (!stack.Empty())
+    {
+        const BVHNode& node = tree.nodes[stack.Pop()];
+
+        // Anything further than the closest hit so far can be skipped
+        f32 entry = 0.0f;
+        if (!RayIntersects(node.aabb, origin, inverseDirection, hitDistance, entry))
+        {
+            continue;
+        }
+
+        if (node.IsLeaf())
+        {
+            hit = true;
+            hitDistance = entry;
+            hitUserData = node.userData;
+            continue;
+        }
+
+        stack.Push(node.child1);
+        stack.Push(node.child2);
+    }
+
+    return hit;
+}
+
+BVHBenchmarkResult RunBVHBenchmark(u32 count)
+{
+    const std::vector<AABB> boxes = GenerateRandomAABBs(count, 1234);
+
+    BVHBenchmarkResult result = {};
+    result.count = count;
+
+    DynamicAABBTree tree;
+    tree.margin = 0.0f; // Exact leaves so both scans report the same boxes
+
+    auto buildStart = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < count; ++i)
+    {
+        CreateProxy(tree, boxes[i], i);
+    }
+    auto buildEnd = std::chrono::high_resolution_clock::now();
+    result.buildTime = std::chrono::duration<f64, std::milli>(buildEnd - buildStart).count();
+
+    // Same volume as the boxes, GenerateRandomAABBs spreads them over +-100
+    std::mt19937 generator(4321);
+    std::uniform_real_distribution<f32> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<f32> direction(-1.0f, 1.0f);
+    std::vector<glm::vec3> centers(BVH_BENCHMARK_QUERIES);
+    std::vector<glm::vec3> directions(BVH_BENCHMARK_QUERIES);
+    for (u32 i = 0; i < BVH_BENCHMARK_QUERIES; ++i)
+    {
+        centers[i] = glm::vec3(position(generator), position(generator), position(generator));
+        directions[i] = glm::normalize(glm::vec3(direction(generator), direction(generator), direction(generator)) + glm::vec3(0.0f, 0.0f, 0.001f));
+    }
+    const f32 sphereRadius = 5.0f;
+    const f32 rayLength = 400.0f;
+
+    auto sphereLinearStart = std::chrono::high_resolution_clock::now();
+    for (const auto& center : centers)
+    {
+        for (const auto& box : boxes)
+        {
+            result.sphereHitsLinear += Overlaps(box, center, sphereRadius) ? 1 : 0;
+        }
+    }
+    auto sphereLinearEnd = std::chrono::high_resolution_clock::now();
+    result.sphereLinearTime = std::chrono::duration<f64, std::milli>(sphereLinearEnd - sphereLinearStart).count();
+
+    std::vector<u32> hits;
+    auto sphereTreeStart = std::chrono::high_resolution_clock::now();
+    for (const auto& center : centers)
+    {
+        hits.clear();
+        QuerySphere(tree, center, sphereRadius, hits);
+        result.sphereHitsTree += hits.size();
+    }
+    auto sphereTreeEnd = std::chrono::high_resolution_clock::now();
+    result.sphereTreeTime = std::chrono::duration<f64, std::milli>(sphereTreeEnd - sphereTreeStart).count();
+
+    // Closest hit, the linear scan also shortens the ray as it finds boxes
+    auto rayLinearStart = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < BVH_BENCHMARK_QUERIES; ++i)
+    {
+        const glm::vec3 inverseDirection = 1.0f / directions[i];
+        f32 hitDistance = rayLength;
+        bool hit = false;
+        for (const auto& box : boxes)
+        {
+            f32 entry = 0.0f;
+            if (RayIntersects(box, centers[i], inverseDirection, hitDistance, entry))
+            {
+                hitDistance = entry;
+                hit = true;
+            }
+        }
+        result.rayHitsLinear += hit ? 1 : 0;
+    }
+    auto rayLinearEnd = std::chrono::high_resolution_clock::now();
+    result.rayLinearTime = std::chrono::duration<f64, std::milli>(rayLinearEnd - rayLinearStart).count();
+
+    auto rayTreeStart = std::chrono::high_resolution_clock::now();
+    for (u32 i = 0; i < BVH_BENCHMARK_QUERIES; ++i)
+    {
+        u32 hitUserData = 0;
+        f32 hitDistance = 0.0f;
+        result.rayHitsTree += QueryRay(tree, centers[i], directions[i], rayLength, hitUserData, hitDistance) ? 1 : 0;
+    }
+    auto rayTreeEnd = std::chrono::high_resolution_clock::now();
+    result.rayTreeTime = std::chrono::duration<f64, std::milli>(rayTreeEnd - rayTreeStart).count();
+
+    return result;
+}
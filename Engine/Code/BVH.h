@@ -0,0 +1,79 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "platform.h"
+#include "Culling.h"
+
+#include <vector>
+
+#define BVH_NULL_NODE -1
+
+struct BVHNode
+{
+    AABB aabb;      // Fattened by the tree margin on leaves
+    i32 parent;     // Next free node while the node is in the free list
+    i32 child1;
+    i32 child2;
+    i32 height;     // 0 for leaves, -1 for free nodes
+    u32 userData;   // Entity index on leaves
+
+    bool IsLeaf() const { return child1 == BVH_NULL_NODE; }
+};
+
+// Dynamic AABB tree: leaves hold a fattened copy of the object bounds, so
+// small movements need no tree update at all, and larger ones remove and
+// reinsert a single leaf. Inserts use a surface area cost and the tree is
+// kept balanced with AVL style rotations, so updates stay O(log n).
+// It answers the sparse queries, picking rays and light ranges; frustum
+// culling touches a large share of the boxes and stays a linear SIMD scan.
+struct DynamicAABBTree
+{
+    std::vector<BVHNode> nodes;
+    i32 root = BVH_NULL_NODE;
+    i32 freeList = BVH_NULL_NODE;
+    u32 proxyCount = 0;
+    f32 margin = 0.1f;  // World units added around every leaf
+};
+
+struct BVHBenchmarkResult
+{
+    u32 count;
+    f64 buildTime;          // ms
+
+    // BVH_BENCHMARK_QUERIES small sphere queries, as used for light ranges
+    u32 sphereHitsLinear;
+    u32 sphereHitsTree;
+    f64 sphereLinearTime;   // ms
+    f64 sphereTreeTime;     // ms
+
+    // BVH_BENCHMARK_QUERIES closest hit rays, as used for picking
+    u32 rayHitsLinear;
+    u32 rayHitsTree;
+    f64 rayLinearTime;      // ms
+    f64 rayTreeTime;        // ms
+};
+
+#define BVH_BENCHMARK_QUERIES 100
+#define BVH_BENCHMARK_SIZES 3   // 1k, 10k and 100k boxes
+
+void ClearTree(DynamicAABBTree& tree);
+
+// Proxies are leaf node indices
+i32 CreateProxy(DynamicAABBTree& tree, const AABB& aabb, u32 userData);
+void DestroyProxy(DynamicAABBTree& tree, i32 proxyId);
+
+// Returns true when the leaf had to be reinserted because it left its fattened bounds
+bool MoveProxy(DynamicAABBTree& tree, i32 proxyId, const AABB& aabb);
+
+u32 GetTreeHeight(const DynamicAABBTree& tree);
+
+// Queries append the userData of every hit leaf
+void QuerySphere(const DynamicAABBTree& tree, const glm::vec3& center, f32 radius, std::vector<u32>& results);
+
+// Closest leaf hit by the ray, tested against the leaf bounds
+bool QueryRay(const DynamicAABBTree& tree, const glm::vec3& origin, const glm::vec3& direction, f32 maxDistance, u32& hitUserData, f32& hitDistance);
+
+// Builds a tree over count random boxes and compares its sphere and ray queries with linear scans
+BVHBenchmarkResult RunBVHBenchmark(u32 count);
+
+#endif // BVH_H
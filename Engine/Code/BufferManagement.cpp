@@ -1,5 +1,9 @@
 #include "BufferManagement.h"
 
+#include <chrono>
+
+static PFNGLBUFFERSTORAGEPROC glBufferStorageProc = nullptr;
+
 bool IsPowerOf2(u32 value)
 {
     return value && !(value & (value - 1));
@@ -24,6 +28,20 @@ Buffer CreateBuffer(u32 size, GLenum type, GLenum usage)
     return buffer;
 }
 
+void ReserveBuffer(Buffer& buffer, u32 size, GLenum usage)
+{
+    // Grow geometrically so repeated reserves stay amortized
+    if (size > buffer.size)
+    {
+        buffer.size = glm::max(size, buffer.size * 2);
+    }
+
+    // Always respecify the storage, orphaning whatever the GPU may still be reading
+    glBindBuffer(buffer.type, buffer.handle);
+    glBufferData(buffer.type, buffer.size, NULL, usage);
+    glBindBuffer(buffer.type, 0);
+}
+
 #define CreateConstantBuffer(size) CreateBuffer(size, GL_UNIFORM_BUFFER, GL_STREAM_DRAW)
 #define CreateStaticVertexBuffer(size) CreateBuffer(size, GL_ARRAY_BUFFER, GL_STATIC_DRAW)
 #define CreateStaticIndexBuffer(size) CreateBuffer(size, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW)
@@ -56,6 +74,7 @@ void PushAlignedData(Buffer& buffer, const void* data, u32 size, u32 alignment)
 {
     ASSERT(buffer.data != NULL, "The buffer must be mapped first");
     AlignHead(buffer, alignment);
+    ASSERT(buffer.head + size <= buffer.size, "Trying to push more data than the buffer can hold");
     memcpy((u8*)buffer.data + buffer.head, data, size);
     buffer.head += size;
 }
@@ -66,6 +85,199 @@ void WriteBufferData(Buffer& buffer, u32 offset, const void* data, u32 size)
     memcpy(static_cast<u8*>(buffer.data) + offset, data, size);
 }
 
+bool LoadBufferStorage()
+{
+    glBufferStorageProc = (PFNGLBUFFERSTORAGEPROC)GetGLProcAddress("glBufferStorage");
+    return glBufferStorageProc != nullptr;
+}
+
+Buffer CreateRingBuffer(u32 regionSize, GLenum type, u32 regionCount, u32 alignment)
+{
+    ASSERT(regionCount <= MAX_FRAMES_IN_FLIGHT, "Too many ring buffer regions");
+
+    Buffer buffer = {};
+    buffer.size = Align(regionSize, alignment);
+    buffer.type = type;
+    buffer.regionCount = regionCount;
+
+    const u32 storageSize = buffer.size * regionCount;
+
+    glGenBuffers(1, &buffer.handle);
+    glBindBuffer(type, buffer.handle);
+    if (glBufferStorageProc)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorageProc(type, storageSize, NULL, flags);
+        buffer.mapping = (u8*)glMapBufferRange(type, 0, storageSize, flags);
+    }
+    else
+    {
+        glBufferData(type, storageSize, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(type, 0);
+
+    return buffer;
+}
+
+void DestroyRingBuffer(Buffer& buffer)
+{
+    for (u32 i = 0; i < buffer.regionCount; ++i)
+    {
+        if (buffer.fences[i])
+        {
+            glDeleteSync(buffer.fences[i]);
+            buffer.fences[i] = 0;
+        }
+    }
+
+    if (buffer.mapping)
+    {
+        glBindBuffer(buffer.type, buffer.handle);
+        glUnmapBuffer(buffer.type);
+        glBindBuffer(buffer.type, 0);
+        buffer.mapping = nullptr;
+    }
+
+    glDeleteBuffers(1, &buffer.handle);
+    buffer.handle = 0;
+    buffer.data = nullptr;
+}
+
+void MapRingBufferRegion(Buffer& buffer)
+{
+    buffer.stallTime = 0.0;
+
+    GLsync& fence = buffer.fences[buffer.region];
+    if (fence)
+    {
+        // Only time the wait if the GPU has not released the region yet
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            auto stallStart = std::chrono::high_resolution_clock::now();
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+            auto stallEnd = std::chrono::high_resolution_clock::now();
+            buffer.stallTime = std::chrono::duration<f64, std::milli>(stallEnd - stallStart).count();
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    const u32 regionOffset = GetRingBufferOffset(buffer);
+    if (buffer.mapping)
+    {
+        buffer.data = buffer.mapping + regionOffset;
+    }
+    else
+    {
+        glBindBuffer(buffer.type, buffer.handle);
+        buffer.data = (u8*)glMapBufferRange(buffer.type, regionOffset, buffer.size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+    buffer.head = 0;
+}
+
+void UnmapRingBufferRegion(Buffer& buffer)
+{
+    // Coherent persistent mappings stay mapped, the writes are already visible to the GPU
+    if (!buffer.mapping)
+    {
+        glUnmapBuffer(buffer.type);
+        glBindBuffer(buffer.type, 0);
+        buffer.data = nullptr;
+    }
+}
+
+void FenceRingBufferRegion(Buffer& buffer)
+{
+    buffer.fences[buffer.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer.region = (buffer.region + 1) % buffer.regionCount;
+}
+
+u32 GetRingBufferOffset(const Buffer& buffer)
+{
+    return buffer.region * buffer.size;
+}
+
+ReadbackBuffer CreateReadbackBuffer(u32 size)
+{
+    ReadbackBuffer readback = {};
+    readback.size = size;
+
+    glGenBuffers(MAX_FRAMES_IN_FLIGHT, readback.staging);
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readback.staging[i]);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return readback;
+}
+
+void DestroyReadbackBuffer(ReadbackBuffer& readback)
+{
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        if (readback.fences[i])
+        {
+            glDeleteSync(readback.fences[i]);
+            readback.fences[i] = 0;
+        }
+    }
+
+    glDeleteBuffers(MAX_FRAMES_IN_FLIGHT, readback.staging);
+    memset(readback.staging, 0, sizeof(readback.staging));
+}
+
+void RequestReadback(ReadbackBuffer& readback, GLuint source)
+{
+    if (readback.fences[readback.next])
+    {
+        return;
+    }
+
+    // Shader atomics and stores must land before the copy reads them
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readback.staging[readback.next]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, readback.size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    readback.fences[readback.next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.next = (readback.next + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+bool ConsumeReadback(ReadbackBuffer& readback, void* data)
+{
+    // Oldest request first, the GPU completes them in order
+    bool consumed = false;
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        const u32 slot = (readback.next + i) % MAX_FRAMES_IN_FLIGHT;
+        GLsync& fence = readback.fences[slot];
+        if (!fence)
+        {
+            continue;
+        }
+
+        const GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+        glDeleteSync(fence);
+        fence = 0;
+
+        glBindBuffer(GL_COPY_READ_BUFFER, readback.staging[slot]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, readback.size, data);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        consumed = true;
+    }
+    return consumed;
+}
+
 #define PushData(buffer, data, size) PushAlignedData(buffer, data, size, 1)
 #define PushUInt(buffer, value) { u32 v = value; PushAlignedData(buffer, &v, sizeof(v), 4); }
 #define PushVec3(buffer, value) PushAlignedData(buffer, value_ptr(value), sizeof(value), sizeof(vec4))
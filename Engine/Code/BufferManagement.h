@@ -23,17 +23,37 @@ using u32 = unsigned int;
         } while(0)
 #endif
 
+// Not part of the GL 4.3 headers we ship (GL 4.4 / ARB_buffer_storage)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+#define MAX_FRAMES_IN_FLIGHT 3
+
 struct Buffer {
     u32 handle = 0;
     u32 size = 0;
     GLenum type = 0;
     u8* data = nullptr;
     u32 head = 0;
+
+    // Ring buffer variant: the storage is split into one region per frame in
+    // flight, and data/head/size refer to the region being written this frame.
+    u8* mapping = nullptr;          // Persistent mapping of the whole storage
+    u32 regionCount = 0;
+    u32 region = 0;
+    GLsync fences[MAX_FRAMES_IN_FLIGHT] = {};
+    f64 stallTime = 0.0;            // ms blocked on the GPU by the last MapRingBufferRegion
 };
 
 bool IsPowerOf2(u32 value);
 u32 Align(u32 value, u32 alignment);
 Buffer CreateBuffer(u32 size, GLenum type, GLenum usage);
+void ReserveBuffer(Buffer& buffer, u32 size, GLenum usage);
 void BindBuffer(const Buffer& buffer);
 void MapBuffer(Buffer& buffer, GLenum access);
 void UnmapBuffer(Buffer& buffer);
@@ -41,12 +61,45 @@ void AlignHead(Buffer& buffer, u32 alignment);
 void PushAlignedData(Buffer& buffer, const void* data, u32 size, u32 alignment);
 void WriteBufferData(Buffer& buffer, u32 offset, const void* data, u32 size);
 
+// Ring buffer: persistent coherent storage when glBufferStorage is available,
+// unsynchronized glMapBufferRange per region otherwise. Fences keep the CPU
+// from writing a region the GPU may still be reading.
+bool LoadBufferStorage();
+Buffer CreateRingBuffer(u32 regionSize, GLenum type, u32 regionCount, u32 alignment);
+void DestroyRingBuffer(Buffer& buffer);
+void MapRingBufferRegion(Buffer& buffer);
+void UnmapRingBufferRegion(Buffer& buffer);
+void FenceRingBufferRegion(Buffer& buffer);
+u32 GetRingBufferOffset(const Buffer& buffer);
+
+// GPU written counters read back without waiting on the GPU: every request
+// copies them into the next of MAX_FRAMES_IN_FLIGHT staging buffers behind a
+// fence, and only the copies whose fence has signalled are read.
+struct ReadbackBuffer
+{
+    GLuint staging[MAX_FRAMES_IN_FLIGHT];
+    GLsync fences[MAX_FRAMES_IN_FLIGHT];
+    u32 size;
+    u32 next;       // Staging buffer of the next request
+};
+
+ReadbackBuffer CreateReadbackBuffer(u32 size);
+void DestroyReadbackBuffer(ReadbackBuffer& readback);
+
+// After the shader writes to the source buffer. Skipped while every staging
+// buffer is still in flight.
+void RequestReadback(ReadbackBuffer& readback, GLuint source);
+
+// Newest completed copy, false when none completed since the last call
+bool ConsumeReadback(ReadbackBuffer& readback, void* data);
+
 #define CreateConstantBuffer(size) CreateBuffer(size, GL_UNIFORM_BUFFER, GL_STREAM_DRAW)
 #define CreateStaticVertexBuffer(size) CreateBuffer(size, GL_ARRAY_BUFFER, GL_STATIC_DRAW)
 #define CreateStaticIndexBuffer(size) CreateBuffer(size, GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW)
 
 #define PushData(buffer, data, size) PushAlignedData(buffer, data, size, 1)
 #define PushUInt(buffer, value) { u32 v = value; PushAlignedData(buffer, &v, sizeof(v), 4); }
+#define PushIVec2(buffer, value) PushAlignedData(buffer, value_ptr(value), sizeof(value), sizeof(ivec2))
 #define PushVec3(buffer, value) PushAlignedData(buffer, value_ptr(value), sizeof(value), sizeof(vec4))
 #define PushVec4(buffer, value) PushAlignedData(buffer, value_ptr(value), sizeof(value), sizeof(vec4))
 #define PushMat3(buffer, value) PushAlignedData(buffer, value_ptr(value), sizeof(value), sizeof(vec4))
@@ -88,7 +88,6 @@ void Camera::Update(App * app)
     if (c_componentsChanged)
     {
         SetViewMatrix();
-        app->UpdateCameraUniforms(app);
         c_componentsChanged = false;
     }
 }
@@ -171,7 +170,6 @@ void Camera::SetAspectRatio(App* app, float aspectRatio) {
     m_aspectRatio = aspectRatio;
     SetProjectionMatrix();
     SetViewMatrix();
-    app->UpdateCameraUniforms(app);
 }
 
 //-------- Camera View --------//
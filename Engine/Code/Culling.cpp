@@ -0,0 +1,354 @@
+#include "Culling.h"
+
+#include <float.h>
+#include <chrono>
+#include <random>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// The project targets the SSE2 baseline, AVX is not enabled for the build
+// (no /arch:AVX): the 8-wide loop is compiled for AVX on its own and only
+// run when the CPU and the OS support it, see SupportsAVX
+#if defined(_MSC_VER)
+#define AVX_TARGET
+#else
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
+
+AABB ComputeAABB(const f32* vertices, u32 floatCount, u32 floatStride)
+{
+    AABB aabb = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    for (u32 i = 0; i + 2 < floatCount; i += floatStride)
+    {
+        const glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+        aabb.min = glm::min(aabb.min, position);
+        aabb.max = glm::max(aabb.max, position);
+    }
+
+    if (aabb.min.x > aabb.max.x)
+    {
+        aabb = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    }
+    return aabb;
+}
+
+BoundingSphere ComputeBoundingSphere(const f32* vertices, u32 floatCount, u32 floatStride, const AABB& aabb)
+{
+    BoundingSphere sphere = { (aabb.min + aabb.max) * 0.5f, 0.0f };
+    for (u32 i = 0; i + 2 < floatCount; i += floatStride)
+    {
+        const glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+        sphere.radius = glm::max(sphere.radius, glm::length(position - sphere.center));
+    }
+    return sphere;
+}
+
+AABB MergeAABB(const AABB& a, const AABB& b)
+{
+    return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+AABB TransformAABB(const AABB& aabb, const glm::mat4& transform)
+{
+    // Transform the center and project the extents onto the new axes
+    const glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+    const glm::vec3 extent = (aabb.max - aabb.min) * 0.5f;
+
+    const glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+    const glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+    const glm::vec3 worldExtent = absolute * extent;
+
+    return { worldCenter - worldExtent, worldCenter + worldExtent };
+}
+
+Frustum ExtractFrustumPlanes(const glm::mat4& viewProjection)
+{
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others
+    const glm::mat4 m = glm::transpose(viewProjection);
+
+    Frustum frustum = {};
+    frustum.planes[0] = m[3] + m[0];
+    frustum.planes[1] = m[3] - m[0];
+    frustum.planes[2] = m[3] + m[1];
+    frustum.planes[3] = m[3] - m[1];
+    frustum.planes[4] = m[3] + m[2];
+    frustum.planes[5] = m[3] - m[2];
+
+    for (auto& plane : frustum.planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+void ClearCullingBounds(CullingBounds& bounds)
+{
+    bounds.centerX.clear();
+    bounds.centerY.clear();
+    bounds.centerZ.clear();
+    bounds.extentX.clear();
+    bounds.extentY.clear();
+    bounds.extentZ.clear();
+}
+
+void PushCullingBounds(CullingBounds& bounds, const AABB& aabb)
+{
+    const glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+    const glm::vec3 extent = (aabb.max - aabb.min) * 0.5f;
+
+    bounds.centerX.push_back(center.x);
+    bounds.centerY.push_back(center.y);
+    bounds.centerZ.push_back(center.z);
+    bounds.extentX.push_back(extent.x);
+    bounds.extentY.push_back(extent.y);
+    bounds.extentZ.push_back(extent.z);
+}
+
+static u32 CullAABBRange(const Frustum& frustum, const CullingBounds& bounds, u8* visibility, u32 first, u32 count)
+{
+    u32 visible = 0;
+    for (u32 i = first; i < count; ++i)
+    {
+        bool inside = true;
+        for (u32 p = 0; p < 6 && inside; ++p)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+
+            // Distance of the box corner furthest along the plane normal
+            const f32 distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] +
+                                 glm::abs(plane.x) * bounds.extentX[i] + glm::abs(plane.y) * bounds.extentY[i] + glm::abs(plane.z) * bounds.extentZ[i] +
+                                 plane.w;
+            inside = distance >= 0.0f;
+        }
+
+        visibility[i] = inside ? 1 : 0;
+        visible += inside ? 1 : 0;
+    }
+    return visible;
+}
+
+u32 CullAABBsScalar(const Frustum& frustum, const CullingBounds& bounds, u8* visibility)
+{
+    return CullAABBRange(frustum, bounds, visibility, 0, (u32)bounds.centerX.size());
+}
+
+// CPUID reports AVX and the OS saving the YMM registers (XCR0 bits 1 and 2)
+static bool SupportsAVX()
+{
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    const bool osSaves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    return osSaves && (info[2] & (1 << 28)) != 0;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+u32 GetCullingSIMDWidth()
+{
+    static const u32 width = SupportsAVX() ? 8 : 4;
+    return width;
+}
+
+// Tests the boxes from i on 8 at a time, leaving i at the first one left
+static AVX_TARGET u32 CullAABBBlocksAVX(const Frustum& frustum, const CullingBounds& bounds, u8* visibility, u32 count, u32& i)
+{
+    const f32* cx = bounds.centerX.data();
+    const f32* cy = bounds.centerY.data();
+    const f32* cz = bounds.centerZ.data();
+    const f32* ex = bounds.extentX.data();
+    const f32* ey = bounds.extentY.data();
+    const f32* ez = bounds.extentZ.data();
+
+    u32 visible = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 centerX = _mm256_loadu_ps(cx + i);
+        const __m256 centerY = _mm256_loadu_ps(cy + i);
+        const __m256 centerZ = _mm256_loadu_ps(cz + i);
+        const __m256 extentX = _mm256_loadu_ps(ex + i);
+        const __m256 extentY = _mm256_loadu_ps(ey + i);
+        const __m256 extentZ = _mm256_loadu_ps(ez + i);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (u32 p = 0; p < 6; ++p)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+
+            __m256 distance = _mm256_set1_ps(plane.w);
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(centerX, _mm256_set1_ps(plane.x)));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(centerY, _mm256_set1_ps(plane.y)));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(centerZ, _mm256_set1_ps(plane.z)));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(extentX, _mm256_set1_ps(glm::abs(plane.x))));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(extentY, _mm256_set1_ps(glm::abs(plane.y))));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(extentZ, _mm256_set1_ps(glm::abs(plane.z))));
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+
+        const int outsideMask = _mm256_movemask_ps(outside);
+        for (u32 lane = 0; lane < 8; ++lane)
+        {
+            const u8 laneVisible = (outsideMask >> lane) & 1 ? 0 : 1;
+            visibility[i + lane] = laneVisible;
+            visible += laneVisible;
+        }
+    }
+
+    // The SSE code that follows is not VEX encoded
+    _mm256_zeroupper();
+    return visible;
+}
+
+u32 CullAABBsSIMD(const Frustum& frustum, const CullingBounds& bounds, u8* visibility)
+{
+    const u32 count = (u32)bounds.centerX.size();
+    const f32* cx = bounds.centerX.data();
+    const f32* cy = bounds.centerY.data();
+    const f32* cz = bounds.centerZ.data();
+    const f32* ex = bounds.extentX.data();
+    const f32* ey = bounds.extentY.data();
+    const f32* ez = bounds.extentZ.data();
+
+    u32 visible = 0;
+    u32 i = 0;
+
+    if (GetCullingSIMDWidth() == 8)
+    {
+        visible += CullAABBBlocksAVX(frustum, bounds, visibility, count, i);
+    }
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 centerX = _mm_loadu_ps(cx + i);
+        const __m128 centerY = _mm_loadu_ps(cy + i);
+        const __m128 centerZ = _mm_loadu_ps(cz + i);
+        const __m128 extentX = _mm_loadu_ps(ex + i);
+        const __m128 extentY = _mm_loadu_ps(ey + i);
+        const __m128 extentZ = _mm_loadu_ps(ez + i);
+
+        __m128 outside = _mm_setzero_ps();
+        for (u32 p = 0; p < 6; ++p)
+        {
+            const glm::vec4& plane = frustum.planes[p];
+
+            __m128 distance = _mm_set1_ps(plane.w);
+            distance = _mm_add_ps(distance, _mm_mul_ps(centerX, _mm_set1_ps(plane.x)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(centerY, _mm_set1_ps(plane.y)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, _mm_set1_ps(plane.z)));
+            distance = _mm_add_ps(distance, _mm_mul_ps(extentX, _mm_set1_ps(glm::abs(plane.x))));
+            distance = _mm_add_ps(distance, _mm_mul_ps(extentY, _mm_set1_ps(glm::abs(plane.y))));
+            distance = _mm_add_ps(distance, _mm_mul_ps(extentZ, _mm_set1_ps(glm::abs(plane.z))));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+        }
+
+        const int outsideMask = _mm_movemask_ps(outside);
+        for (u32 lane = 0; lane < 4; ++lane)
+        {
+            const u8 laneVisible = (outsideMask >> lane) & 1 ? 0 : 1;
+            visibility[i + lane] = laneVisible;
+            visible += laneVisible;
+        }
+    }
+
+    // Remaining boxes that don't fill a register
+    return visible + CullAABBRange(frustum, bounds, visibility, i, count);
+}
+
+bool IsOccluded(const DepthPyramidReadback& pyramid, const glm::vec3& center, const glm::vec3& extent)
+{
+    if (pyramid.depth.empty())
+    {
+        return false;
+    }
+
+    glm::vec3 ndcMin(FLT_MAX);
+    glm::vec3 ndcMax(-FLT_MAX);
+    for (u32 corner = 0; corner < 8; ++corner)
+    {
+        const glm::vec3 offset((corner & 1) ? extent.x : -extent.x, (corner & 2) ? extent.y : -extent.y, (corner & 4) ? extent.z : -extent.z);
+        const glm::vec4 clip = pyramid.viewProjection * glm::vec4(center + offset, 1.0f);
+        if (clip.w <= 0.0f)
+        {
+            return false;
+        }
+
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+
+    // Closest point of the box, in the same [0, 1] range as the depth buffer
+    const f32 nearestDepth = ndcMin.z * 0.5f + 0.5f;
+    if (nearestDepth <= 0.0f || ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+    {
+        return false;
+    }
+
+    const i32 width = (i32)pyramid.width;
+    const i32 height = (i32)pyramid.height;
+    const i32 x0 = glm::clamp((i32)((ndcMin.x * 0.5f + 0.5f) * width), 0, width - 1);
+    const i32 x1 = glm::clamp((i32)((ndcMax.x * 0.5f + 0.5f) * width), 0, width - 1);
+    const i32 y0 = glm::clamp((i32)((ndcMin.y * 0.5f + 0.5f) * height), 0, height - 1);
+    const i32 y1 = glm::clamp((i32)((ndcMax.y * 0.5f + 0.5f) * height), 0, height - 1);
+
+    // Every covered texel has to be in front of the box
+    for (i32 y = y0; y <= y1; ++y)
+    {
+        const f32* row = pyramid.depth.data() + y * width;
+        for (i32 x = x0; x <= x1; ++x)
+        {
+            if (row[x] >= nearestDepth)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<AABB> GenerateRandomAABBs(u32 count, u32 seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<f32> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<f32> size(0.1f, 2.0f);
+
+    std::vector<AABB> boxes(count);
+    for (auto& box : boxes)
+    {
+        const glm::vec3 center(position(generator), position(generator), position(generator));
+        const glm::vec3 extent(size(generator), size(generator), size(generator));
+        box = { center - extent, center + extent };
+    }
+    return boxes;
+}
+
+CullingBenchmarkResult RunCullingBenchmark(const Frustum& frustum, u32 count)
+{
+    CullingBounds bounds;
+    for (const auto& box : GenerateRandomAABBs(count, 1234))
+    {
+        PushCullingBounds(bounds, box);
+    }
+
+    std::vector<u8> visibility(count);
+
+    CullingBenchmarkResult result = {};
+    result.count = count;
+
+    auto scalarStart = std::chrono::high_resolution_clock::now();
+    result.visibleScalar = CullAABBsScalar(frustum, bounds, visibility.data());
+    auto scalarEnd = std::chrono::high_resolution_clock::now();
+    result.scalarTime = std::chrono::duration<f64, std::milli>(scalarEnd - scalarStart).count();
+
+    auto simdStart = std::chrono::high_resolution_clock::now();
+    result.visibleSIMD = CullAABBsSIMD(frustum, bounds, visibility.data());
+    auto simdEnd = std::chrono::high_resolution_clock::now();
+    result.simdTime = std::chrono::duration<f64, std::milli>(simdEnd - simdStart).count();
+
+    return result;
+}
@@ -0,0 +1,89 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "platform.h"
+
+#include <vector>
+
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center;
+    f32 radius;
+};
+
+// Planes stored as (normal, distance) with the normals pointing inwards:
+// a point p is inside a plane when dot(normal, p) + distance >= 0
+struct Frustum
+{
+    glm::vec4 planes[6]; // Left, right, bottom, top, near, far
+};
+
+// World space AABBs in center/extent form, one array per component
+// so they can be loaded straight into SIMD registers 4 or 8 at a time
+struct CullingBounds
+{
+    std::vector<f32> centerX;
+    std::vector<f32> centerY;
+    std::vector<f32> centerZ;
+    std::vector<f32> extentX;
+    std::vector<f32> extentY;
+    std::vector<f32> extentZ;
+};
+
+// One level of a max depth pyramid read back to the CPU, together with the
+// view projection of the frame whose depth it holds
+struct DepthPyramidReadback
+{
+    std::vector<f32> depth; // Row major, bottom row first as glGetTexImage returns it
+    u32 width;
+    u32 height;
+    glm::mat4 viewProjection;
+};
+
+struct CullingBenchmarkResult
+{
+    u32 count;
+    u32 visibleScalar;
+    u32 visibleSIMD;
+    f64 scalarTime; // ms
+    f64 simdTime;   // ms
+};
+
+// Positions are expected in the first three floats of every vertex
+AABB ComputeAABB(const f32* vertices, u32 floatCount, u32 floatStride);
+BoundingSphere ComputeBoundingSphere(const f32* vertices, u32 floatCount, u32 floatStride, const AABB& aabb);
+AABB MergeAABB(const AABB& a, const AABB& b);
+AABB TransformAABB(const AABB& aabb, const glm::mat4& transform);
+
+Frustum ExtractFrustumPlanes(const glm::mat4& viewProjection);
+
+void ClearCullingBounds(CullingBounds& bounds);
+void PushCullingBounds(CullingBounds& bounds, const AABB& aabb);
+
+// Both write 1 into visibility[i] when bounds i touches the frustum, 0 otherwise,
+// and return the visible count. The SIMD version tests 8 boxes per step with AVX
+// and 4 with SSE, the scalar one is kept as reference.
+u32 CullAABBsScalar(const Frustum& frustum, const CullingBounds& bounds, u8* visibility);
+u32 CullAABBsSIMD(const Frustum& frustum, const CullingBounds& bounds, u8* visibility);
+
+// Boxes per step of CullAABBsSIMD on this CPU. The build targets SSE2, the
+// AVX loop is picked at run time.
+u32 GetCullingSIMDWidth();
+
+// True when the box lies entirely behind the depth stored in the pyramid.
+// Boxes crossing the near plane or off the pyramid's screen never are.
+bool IsOccluded(const DepthPyramidReadback& pyramid, const glm::vec3& center, const glm::vec3& extent);
+
+// Deterministic random boxes for the benchmarks
+std::vector<AABB> GenerateRandomAABBs(u32 count, u32 seed);
+
+// Culls count random boxes with both versions and times them
+CullingBenchmarkResult RunCullingBenchmark(const Frustum& frustum, u32 count);
+
+#endif // CULLING_H
@@ -0,0 +1,114 @@
+#include "DynamicResolution.h"
+
+static f32 QuantizeScale(f32 scale)
+{
+    return glm::round(scale / DYNAMIC_RESOLUTION_SCALE_STEP) * DYNAMIC_RESOLUTION_SCALE_STEP;
+}
+
+// The next frame is the first one at the scale, the average starts over from it
+static void RestartMeasurement(DynamicResolution& resolution)
+{
+    resolution.frameScale = resolution.scale;
+    resolution.scaleFrame = resolution.queryFrame;
+    resolution.smoothedGpuTime = 0.0f;
+    resolution.framesSinceChange = 0;
+}
+
+void InitDynamicResolution(DynamicResolution& resolution)
+{
+    resolution.enabled = true;
+    resolution.targetGpuTime = 1000.0f / 60.0f;
+    resolution.minScale = 0.5f;
+    resolution.maxScale = 1.0f;
+    resolution.scale = 1.0f;
+
+    glGenQueries(DYNAMIC_RESOLUTION_QUERY_FRAMES * 2, &resolution.queries[0][0]);
+    resolution.queryFrame = 0;
+    RestartMeasurement(resolution);
+}
+
+void BeginGpuFrameTimer(DynamicResolution& resolution)
+{
+    glQueryCounter(resolution.queries[resolution.queryFrame % DYNAMIC_RESOLUTION_QUERY_FRAMES][0], GL_TIMESTAMP);
+}
+
+void EndGpuFrameTimer(DynamicResolution& resolution)
+{
+    glQueryCounter(resolution.queries[resolution.queryFrame % DYNAMIC_RESOLUTION_QUERY_FRAMES][1], GL_TIMESTAMP);
+    resolution.queryFrame++;
+}
+
+void UpdateDynamicResolution(DynamicResolution& resolution, bool active)
+{
+    // Set from the GUI
+    if (resolution.scale != resolution.frameScale)
+    {
+        RestartMeasurement(resolution);
+    }
+
+    // The pair about to be reissued, DYNAMIC_RESOLUTION_QUERY_FRAMES frames old
+    if (resolution.queryFrame < DYNAMIC_RESOLUTION_QUERY_FRAMES)
+    {
+        return;
+    }
+    GLuint* queries = resolution.queries[resolution.queryFrame % DYNAMIC_RESOLUTION_QUERY_FRAMES];
+
+    GLint available = 0;
+    glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+    {
+        // Normally done by now; it is simply not measured
+        return;
+    }
+
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+
+    resolution.gpuTime = (end - begin) / 1000000.0f;
+
+    resolution.gpuTimeHistory[resolution.historyOffset] = resolution.gpuTime;
+    resolution.scaleHistory[resolution.historyOffset] = resolution.scale;
+    resolution.historyOffset = (resolution.historyOffset + 1) % DYNAMIC_RESOLUTION_HISTORY;
+
+    // Frames from before the last change were rendered at the old scale and
+    // say nothing about the current one
+    const u32 measuredFrame = resolution.queryFrame - DYNAMIC_RESOLUTION_QUERY_FRAMES;
+    if (measuredFrame < resolution.scaleFrame)
+    {
+        return;
+    }
+
+    resolution.smoothedGpuTime = resolution.smoothedGpuTime > 0.0f ? glm::mix(resolution.smoothedGpuTime, resolution.gpuTime, 0.2f) : resolution.gpuTime;
+    resolution.framesSinceChange++;
+    if (!resolution.enabled || !active || resolution.framesSinceChange < DYNAMIC_RESOLUTION_SETTLE_FRAMES)
+    {
+        return;
+    }
+
+    // Shrink as soon as the budget is exceeded, grow only with some headroom,
+    // so the scale does not oscillate around it
+    const f32 budgetRatio = resolution.targetGpuTime / glm::max(resolution.smoothedGpuTime, 0.01f);
+    if (budgetRatio >= 1.0f && budgetRatio * DYNAMIC_RESOLUTION_HEADROOM < 1.0f)
+    {
+        return;
+    }
+
+    // The cost follows the pixel count, the square of the scale
+    f32 scale = resolution.scale * glm::sqrt(budgetRatio);
+    scale = glm::clamp(scale, resolution.scale - DYNAMIC_RESOLUTION_MAX_CHANGE, resolution.scale + DYNAMIC_RESOLUTION_MAX_CHANGE);
+    scale = glm::clamp(QuantizeScale(scale), resolution.minScale, resolution.maxScale);
+
+    if (scale != resolution.scale)
+    {
+        resolution.scale = scale;
+        RestartMeasurement(resolution);
+        resolution.scaleChanges++;
+    }
+}
+
+void DestroyDynamicResolution(DynamicResolution& resolution)
+{
+    glDeleteQueries(DYNAMIC_RESOLUTION_QUERY_FRAMES * 2, &resolution.queries[0][0]);
+}
@@ -0,0 +1,59 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "platform.h"
+
+#include <glad/glad.h>
+
+// Scales the resolution the scene is rendered at to keep the GPU frame time
+// under a budget. The GPU time comes from timestamp queries read a few
+// frames late, so reading them never stalls; the scale only moves again once
+// the frames measured were rendered at the current one.
+
+#define DYNAMIC_RESOLUTION_QUERY_FRAMES 4       // Timestamp pairs in flight
+#define DYNAMIC_RESOLUTION_SETTLE_FRAMES 8      // Frames after a change before the next one
+#define DYNAMIC_RESOLUTION_SCALE_STEP 0.05f     // Scales are multiples of it
+#define DYNAMIC_RESOLUTION_MAX_CHANGE 0.15f     // Largest scale change at once
+#define DYNAMIC_RESOLUTION_HEADROOM 0.85f       // Grows only under this fraction of the budget
+#define DYNAMIC_RESOLUTION_HISTORY 240          // Frames kept for the Info window
+
+struct DynamicResolution
+{
+    // Settings
+    bool enabled;               // Otherwise the scale stays where it is set
+    f32 targetGpuTime;          // ms
+    f32 minScale;
+    f32 maxScale;
+
+    // Per axis scale of the render size
+    f32 scale;
+
+    GLuint queries[DYNAMIC_RESOLUTION_QUERY_FRAMES][2];     // Begin and end timestamps
+    u32 queryFrame;
+    f32 frameScale;             // Scale the frames since scaleFrame are rendered at
+    u32 scaleFrame;             // First frame rendered at frameScale
+    u32 framesSinceChange;      // Measured at the current scale
+
+    f32 gpuTime;                // Last measured, ms
+    f32 smoothedGpuTime;
+
+    // Ring buffers, historyOffset is the oldest entry
+    f32 gpuTimeHistory[DYNAMIC_RESOLUTION_HISTORY];
+    f32 scaleHistory[DYNAMIC_RESOLUTION_HISTORY];
+    u32 historyOffset;
+    u32 scaleChanges;
+};
+
+void InitDynamicResolution(DynamicResolution& resolution);
+
+// Around the GPU work of the frame
+void BeginGpuFrameTimer(DynamicResolution& resolution);
+void EndGpuFrameTimer(DynamicResolution& resolution);
+
+// Reads the oldest timestamps and moves the scale toward the budget. Only
+// active frames (rendered at the scale) drive the controller.
+void UpdateDynamicResolution(DynamicResolution& resolution, bool active);
+
+void DestroyDynamicResolution(DynamicResolution& resolution);
+
+#endif // DYNAMIC_RESOLUTION_H
@@ -0,0 +1,526 @@
+#include "FrameGraph.h"
+#include "BufferManagement.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+static bool IsDepthFormat(GLenum format)
+{
+    return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8 || format == GL_DEPTH_COMPONENT16 ||
+           format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+}
+
+static bool HasStencil(GLenum format)
+{
+    return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+static RenderTargetDesc GetRenderTargetDesc(const FrameGraphTextureDesc& desc)
+{
+    return { desc.width, desc.height, desc.format, 1 };
+}
+
+static const char* GetAccessName(FrameGraphAccess access)
+{
+    switch (access)
+    {
+        case FrameGraphAccess_Attachment: return "attachment";
+        case FrameGraphAccess_Sampled: return "sampled";
+        case FrameGraphAccess_Image: return "image";
+        case FrameGraphAccess_Transfer: return "transfer";
+        default: return "?";
+    }
+}
+
+// Only image stores are incoherent in GL, rendering and transfers are ordered
+// with the commands after them. The bit depends on how the data is read next.
+static GLbitfield GetBarrierBits(FrameGraphAccess writeAccess, FrameGraphAccess readAccess)
+{
+    if (writeAccess != FrameGraphAccess_Image)
+    {
+        return 0;
+    }
+
+    switch (readAccess)
+    {
+        case FrameGraphAccess_Attachment: return GL_FRAMEBUFFER_BARRIER_BIT;
+        case FrameGraphAccess_Sampled: return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case FrameGraphAccess_Image: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case FrameGraphAccess_Transfer: return GL_TEXTURE_UPDATE_BARRIER_BIT;
+        default: return 0;
+    }
+}
+
+static FrameGraphResource AddVersion(FrameGraph& graph, u32 texture, u32 producer, FrameGraphAccess writeAccess)
+{
+    graph.versions.push_back({ texture, producer, writeAccess, FRAME_GRAPH_INVALID, 0 });
+    return graph.versions.size() - 1;
+}
+
+void BeginFrameGraph(FrameGraph& graph)
+{
+    graph.passes.clear();
+    graph.textures.clear();
+    graph.versions.clear();
+    graph.order.clear();
+    graph.stats = {};
+}
+
+FrameGraphResource CreateTexture(FrameGraph& graph, const char* name, const FrameGraphTextureDesc& desc)
+{
+    graph.textures.push_back({ name, desc, false, 0, FRAME_GRAPH_INVALID, FRAME_GRAPH_INVALID });
+    return AddVersion(graph, graph.textures.size() - 1, FRAME_GRAPH_INVALID, FrameGraphAccess_Attachment);
+}
+
+FrameGraphResource ImportTexture(FrameGraph& graph, const char* name, GLuint texture, const FrameGraphTextureDesc& desc)
+{
+    graph.textures.push_back({ name, desc, true, texture, FRAME_GRAPH_INVALID, FRAME_GRAPH_INVALID });
+    return AddVersion(graph, graph.textures.size() - 1, FRAME_GRAPH_INVALID, FrameGraphAccess_Attachment);
+}
+
+u32 AddPass(FrameGraph& graph, const char* name, FrameGraphExecute execute)
+{
+    FrameGraphPass pass = {};
+    pass.name = name;
+    pass.execute = std::move(execute);
+    graph.passes.push_back(std::move(pass));
+    return graph.passes.size() - 1;
+}
+
+void SetPassSideEffect(FrameGraph& graph, u32 pass)
+{
+    graph.passes[pass].sideEffect = true;
+}
+
+void ReadTexture(FrameGraph& graph, u32 pass, FrameGraphResource resource, FrameGraphAccess access)
+{
+    ASSERT(resource < graph.versions.size(), "Unknown frame graph resource");
+    graph.passes[pass].reads.push_back({ resource, access });
+}
+
+FrameGraphResource WriteTexture(FrameGraph& graph, u32 pass, FrameGraphResource resource, FrameGraphAccess access, bool keepContents)
+{
+    ASSERT(resource < graph.versions.size(), "Unknown frame graph resource");
+    ASSERT(graph.versions[resource].next == FRAME_GRAPH_INVALID, "Frame graph resource written twice from the same version");
+
+    // The initial contents of a transient are undefined, there is nothing to keep
+    const FrameGraphVersion& previous = graph.versions[resource];
+    if (keepContents && (previous.producer != FRAME_GRAPH_INVALID || graph.textures[previous.texture].imported))
+    {
+        graph.passes[pass].reads.push_back({ resource, access });
+    }
+
+    const FrameGraphResource version = AddVersion(graph, previous.texture, pass, access);
+    graph.versions[resource].next = version;
+    graph.passes[pass].writes.push_back({ version, access });
+    return version;
+}
+
+// Walks back from the unread versions, dropping the producers left with no reader
+static void CullPasses(FrameGraph& graph)
+{
+    for (auto& version : graph.versions)
+    {
+        version.refCount = 0;
+    }
+
+    for (auto& pass : graph.passes)
+    {
+        pass.culled = false;
+        pass.refCount = pass.writes.size();
+        for (const auto& read : pass.reads)
+        {
+            graph.versions[read.version].refCount++;
+        }
+        for (const auto& write : pass.writes)
+        {
+            if (graph.textures[graph.versions[write.version].texture].imported)
+            {
+                pass.sideEffect = true;
+            }
+        }
+        if (pass.sideEffect)
+        {
+            pass.refCount++;
+        }
+    }
+
+    std::vector<FrameGraphResource> unread;
+    for (u32 i = 0; i < graph.versions.size(); ++i)
+    {
+        if (graph.versions[i].refCount == 0 && graph.versions[i].producer != FRAME_GRAPH_INVALID)
+        {
+            unread.push_back(i);
+        }
+    }
+
+    while (!unread.empty())
+    {
+        const FrameGraphVersion& version = graph.versions[unread.back()];
+        unread.pop_back();
+
+        FrameGraphPass& producer = graph.passes[version.producer];
+        if (--producer.refCount > 0)
+        {
+            continue;
+        }
+
+        producer.culled = true;
+        for (const auto& read : producer.reads)
+        {
+            FrameGraphVersion& readVersion = graph.versions[read.version];
+            if (--readVersion.refCount == 0 && readVersion.producer != FRAME_GRAPH_INVALID)
+            {
+                unread.push_back(read.version);
+            }
+        }
+    }
+}
+
+// Kahn's algorithm over read-after-write and write-after-read edges, taking
+// the first declared of the passes ready every time
+static void SortPasses(FrameGraph& graph)
+{
+    const u32 passCount = graph.passes.size();
+    std::vector<std::vector<u32>> successors(passCount);
+    std::vector<u32> predecessorCount(passCount, 0);
+
+    auto addEdge = [&](u32 from, u32 to)
+    {
+        if (from == to || graph.passes[from].culled || graph.passes[to].culled)
+        {
+            return;
+        }
+        successors[from].push_back(to);
+        predecessorCount[to]++;
+    };
+
+    for (u32 i = 0; i < passCount; ++i)
+    {
+        for (const auto& read : graph.passes[i].reads)
+        {
+            const FrameGraphVersion& version = graph.versions[read.version];
+            if (version.producer != FRAME_GRAPH_INVALID)
+            {
+                addEdge(version.producer, i);
+            }
+            if (version.next != FRAME_GRAPH_INVALID)
+            {
+                addEdge(i, graph.versions[version.next].producer);
+            }
+        }
+    }
+
+    std::vector<bool> scheduled(passCount, false);
+    for (u32 i = 0; i < passCount; ++i)
+    {
+        scheduled[i] = graph.passes[i].culled;
+    }
+
+    for (;;)
+    {
+        u32 next = FRAME_GRAPH_INVALID;
+        for (u32 i = 0; i < passCount && next == FRAME_GRAPH_INVALID; ++i)
+        {
+            if (!scheduled[i] && predecessorCount[i] == 0)
+            {
+                next = i;
+            }
+        }
+        if (next == FRAME_GRAPH_INVALID)
+        {
+            break;
+        }
+
+        scheduled[next] = true;
+        graph.order.push_back(next);
+        for (u32 successor : successors[next])
+        {
+            predecessorCount[successor]--;
+        }
+    }
+
+    // Only possible when a pass reads an old version of a texture a pass it depends on rewrote
+    for (u32 i = 0; i < passCount; ++i)
+    {
+        if (!scheduled[i])
+        {
+            ELOG("Frame graph: pass %s is part of a dependency cycle, run in declaration order", graph.passes[i].name);
+            graph.order.push_back(i);
+        }
+    }
+}
+
+static void ComputeBarriers(FrameGraph& graph)
+{
+    for (u32 passIdx : graph.order)
+    {
+        FrameGraphPass& pass = graph.passes[passIdx];
+        pass.barriers = 0;
+        for (const auto& read : pass.reads)
+        {
+            pass.barriers |= GetBarrierBits(graph.versions[read.version].writeAccess, read.access);
+        }
+        if (pass.barriers != 0)
+        {
+            graph.stats.barrierCount++;
+        }
+    }
+}
+
+static void ComputeLifetimes(FrameGraph& graph)
+{
+    auto use = [&](FrameGraphResource resource, u32 position)
+    {
+        FrameGraphTextureNode& texture = graph.textures[graph.versions[resource].texture];
+        texture.firstUse = texture.firstUse == FRAME_GRAPH_INVALID ? position : glm::min(texture.firstUse, position);
+        texture.lastUse = texture.lastUse == FRAME_GRAPH_INVALID ? position : glm::max(texture.lastUse, position);
+    };
+
+    for (u32 position = 0; position < graph.order.size(); ++position)
+    {
+        const FrameGraphPass& pass = graph.passes[graph.order[position]];
+        for (const auto& read : pass.reads)
+        {
+            use(read.version, position);
+        }
+        for (const auto& write : pass.writes)
+        {
+            use(write.version, position);
+        }
+    }
+}
+
+static void DestroyFramebuffers(FrameGraph& graph)
+{
+    for (auto& framebuffer : graph.framebuffers)
+    {
+        glDeleteFramebuffers(1, &framebuffer.second);
+    }
+    graph.framebuffers.clear();
+}
+
+// Transients in order of first use, the ones whose last use is over going
+// back to the pool first. GL has no memory aliasing across formats, so only
+// identical descriptions share.
+static void AcquireRenderTargets(FrameGraph& graph, RenderTargetPool& pool)
+{
+    std::vector<u32> transients;
+    for (u32 i = 0; i < graph.textures.size(); ++i)
+    {
+        if (!graph.textures[i].imported && graph.textures[i].firstUse != FRAME_GRAPH_INVALID)
+        {
+            transients.push_back(i);
+        }
+    }
+    std::sort(transients.begin(), transients.end(), [&](u32 a, u32 b) { return graph.textures[a].firstUse < graph.textures[b].firstUse; });
+
+    std::vector<u32> live;
+    std::vector<GLuint> targets;
+    for (u32 textureIdx : transients)
+    {
+        FrameGraphTextureNode& texture = graph.textures[textureIdx];
+
+        for (u32 i = 0; i < live.size();)
+        {
+            if (graph.textures[live[i]].lastUse < texture.firstUse)
+            {
+                ReleaseRenderTarget(pool, graph.textures[live[i]].texture);
+                live.erase(live.begin() + i);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        const RenderTargetDesc desc = GetRenderTargetDesc(texture.desc);
+        texture.texture = AcquireRenderTarget(pool, desc);
+        live.push_back(textureIdx);
+
+        graph.stats.transientCount++;
+        graph.stats.transientBytes += GetRenderTargetBytes(desc);
+        if (std::find(targets.begin(), targets.end(), texture.texture) == targets.end())
+        {
+            targets.push_back(texture.texture);
+            graph.stats.targetCount++;
+            graph.stats.targetBytes += GetRenderTargetBytes(desc);
+        }
+    }
+
+    for (u32 textureIdx : live)
+    {
+        ReleaseRenderTarget(pool, graph.textures[textureIdx].texture);
+    }
+
+    // Handles of deleted textures get reused by the GL
+    if (graph.poolGeneration != pool.generation)
+    {
+        DestroyFramebuffers(graph);
+        graph.poolGeneration = pool.generation;
+    }
+}
+
+void CompileFrameGraph(FrameGraph& graph, RenderTargetPool& pool)
+{
+    CullPasses(graph);
+    SortPasses(graph);
+    ComputeBarriers(graph);
+    ComputeLifetimes(graph);
+    AcquireRenderTargets(graph, pool);
+
+    graph.stats.passCount = graph.passes.size();
+    graph.stats.culledPassCount = graph.passes.size() - graph.order.size();
+}
+
+void ExecuteFrameGraph(FrameGraph& graph)
+{
+    for (u32 passIdx : graph.order)
+    {
+        FrameGraphPass& pass = graph.passes[passIdx];
+        if (pass.barriers != 0)
+        {
+            glMemoryBarrier(pass.barriers);
+        }
+        pass.execute(graph);
+    }
+}
+
+GLuint GetTexture(const FrameGraph& graph, FrameGraphResource resource)
+{
+    return graph.textures[graph.versions[resource].texture].texture;
+}
+
+FrameGraphTextureDesc GetTextureDesc(const FrameGraph& graph, FrameGraphResource resource)
+{
+    return graph.textures[graph.versions[resource].texture].desc;
+}
+
+GLuint GetFramebuffer(FrameGraph& graph, const FrameGraphResource* attachments, u32 count)
+{
+    if (count == 1 && GetTexture(graph, attachments[0]) == 0)
+    {
+        return 0;
+    }
+
+    u64 key = 14695981039346656037ull;
+    for (u32 i = 0; i < count; ++i)
+    {
+        key = (key ^ GetTexture(graph, attachments[i])) * 1099511628211ull;
+    }
+
+    auto it = graph.framebuffers.find(key);
+    if (it != graph.framebuffers.end())
+    {
+        return it->second;
+    }
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    std::vector<GLenum> drawBuffers;
+    for (u32 i = 0; i < count; ++i)
+    {
+        const GLenum format = GetTextureDesc(graph, attachments[i]).format;
+        GLenum attachment = GL_COLOR_ATTACHMENT0 + drawBuffers.size();
+        if (IsDepthFormat(format))
+        {
+            attachment = HasStencil(format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        }
+        else
+        {
+            drawBuffers.push_back(attachment);
+        }
+        glFramebufferTexture(GL_FRAMEBUFFER, attachment, GetTexture(graph, attachments[i]), 0);
+    }
+
+    if (drawBuffers.empty())
+    {
+        glDrawBuffer(GL_NONE);
+    }
+    else
+    {
+        glDrawBuffers(drawBuffers.size(), drawBuffers.data());
+    }
+
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        ELOG("Frame graph: framebuffer incomplete (0x%x)", status);
+    }
+
+    graph.framebuffers[key] = framebuffer;
+    return framebuffer;
+}
+
+bool DumpFrameGraph(const FrameGraph& graph, const char* filepath)
+{
+    FILE* file = fopen(filepath, "w");
+    if (file == nullptr)
+    {
+        ELOG("fopen() failed writing frame graph %s", filepath);
+        return false;
+    }
+
+    fprintf(file, "digraph FrameGraph\n{\n    rankdir = LR;\n    node [fontname = \"Consolas\", fontsize = 10];\n\n");
+
+    for (u32 i = 0; i < graph.passes.size(); ++i)
+    {
+        const FrameGraphPass& pass = graph.passes[i];
+        u32 position = 0;
+        while (position < graph.order.size() && graph.order[position] != i)
+        {
+            position++;
+        }
+
+        if (pass.culled)
+        {
+            fprintf(file, "    pass%u [shape = box, style = dashed, label = \"%s\\nculled\"];\n", i, pass.name);
+        }
+        else
+        {
+            fprintf(file, "    pass%u [shape = box, style = filled, fillcolor = orange, label = \"%u: %s%s\"];\n", i, position, pass.name,
+                    pass.barriers != 0 ? "\\nbarrier" : "");
+        }
+    }
+    fprintf(file, "\n");
+
+    for (u32 i = 0; i < graph.versions.size(); ++i)
+    {
+        const FrameGraphVersion& version = graph.versions[i];
+        const FrameGraphTextureNode& texture = graph.textures[version.texture];
+        if (texture.imported)
+        {
+            fprintf(file, "    version%u [shape = ellipse, style = filled, fillcolor = lightblue, label = \"%s (imported)\"];\n", i, texture.name);
+        }
+        else
+        {
+            fprintf(file, "    version%u [shape = ellipse, style = filled, fillcolor = %s, label = \"%s\\n%ux%u 0x%x\\ntexture %u\"];\n", i,
+                    texture.firstUse == FRAME_GRAPH_INVALID ? "gray" : "palegreen", texture.name, texture.desc.width, texture.desc.height,
+                    texture.desc.format, texture.texture);
+        }
+    }
+    fprintf(file, "\n");
+
+    for (u32 i = 0; i < graph.passes.size(); ++i)
+    {
+        for (const auto& read : graph.passes[i].reads)
+        {
+            fprintf(file, "    version%u -> pass%u [label = \"%s\"];\n", read.version, i, GetAccessName(read.access));
+        }
+        for (const auto& write : graph.passes[i].writes)
+        {
+            fprintf(file, "    pass%u -> version%u [color = red, label = \"%s\"];\n", i, write.version, GetAccessName(write.access));
+        }
+    }
+
+    fprintf(file, "}\n");
+    fclose(file);
+    return true;
+}
+
+void DestroyFrameGraph(FrameGraph& graph)
+{
+    DestroyFramebuffers(graph);
+}
@@ -0,0 +1,144 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include "platform.h"
+#include "RenderTargetPool.h"
+
+#include <glad/glad.h>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Render passes of one frame and the textures they exchange. Passes declare
+// what they read and write, then CompileFrameGraph:
+//  - culls the passes whose outputs nobody reads,
+//  - orders the rest by their dependencies, declaration order breaking ties,
+//  - issues the glMemoryBarrier a pass needs before reading image stores,
+//  - acquires a render target for every transient from the pool, released
+//    again after its last use so the transients of the same description
+//    whose lifetimes do not overlap share it.
+//
+// Textures created outside the graph (the backbuffer, persistent ones) are
+// imported; passes writing them are never culled. The graph is rebuilt every
+// frame, the framebuffers over the pool textures live across frames.
+
+#define FRAME_GRAPH_INVALID 0xFFFFFFFFu
+
+// Version of a resource, a new one is made by every write
+typedef u32 FrameGraphResource;
+
+struct FrameGraphTextureDesc
+{
+    u32 width;
+    u32 height;
+    GLenum format;  // Sized internal format
+};
+
+enum FrameGraphAccess
+{
+    FrameGraphAccess_Attachment,    // Rendered to, depth/stencil tested or blitted from
+    FrameGraphAccess_Sampled,       // Through a sampler
+    FrameGraphAccess_Image,         // Image load/store
+    FrameGraphAccess_Transfer,      // glGetTexImage
+};
+
+struct FrameGraphTextureNode
+{
+    const char* name;
+    FrameGraphTextureDesc desc;
+    bool imported;
+    GLuint texture;     // Imported handle (0 is the backbuffer), or the pool texture once compiled
+    u32 firstUse;       // Positions in FrameGraph::order, FRAME_GRAPH_INVALID when unused
+    u32 lastUse;
+};
+
+struct FrameGraphVersion
+{
+    u32 texture;            // FrameGraphTextureNode
+    u32 producer;           // Pass writing it, FRAME_GRAPH_INVALID for the initial contents
+    FrameGraphAccess writeAccess;
+    u32 next;               // Version made by the next write
+    u32 refCount;           // Readers left after culling
+};
+
+struct FrameGraphAccessRecord
+{
+    FrameGraphResource version;
+    FrameGraphAccess access;
+};
+
+struct FrameGraph;
+typedef std::function<void(FrameGraph& graph)> FrameGraphExecute;
+
+struct FrameGraphPass
+{
+    const char* name;
+    FrameGraphExecute execute;
+    std::vector<FrameGraphAccessRecord> reads;     // Writes that keep the contents read the previous version too
+    std::vector<FrameGraphAccessRecord> writes;
+    bool sideEffect;        // Kept even when nothing reads its outputs
+    bool culled;
+    u32 refCount;
+    GLbitfield barriers;    // Issued right before it runs
+};
+
+struct FrameGraphStats
+{
+    u32 passCount;
+    u32 culledPassCount;
+    u32 barrierCount;
+    u32 transientCount;         // Transients used by the passes kept
+    u32 targetCount;            // Render targets they were placed in
+    u64 transientBytes;         // What they would take without aliasing
+    u64 targetBytes;            // What those render targets take
+};
+
+struct FrameGraph
+{
+    std::vector<FrameGraphPass> passes;
+    std::vector<FrameGraphTextureNode> textures;
+    std::vector<FrameGraphVersion> versions;
+    std::vector<u32> order;     // Passes kept, in execution order
+
+    // Across frames
+    std::unordered_map<u64, GLuint> framebuffers;   // Hash of the attachment handles -> FBO
+    u32 poolGeneration;     // RenderTargetPool::generation the framebuffers were made in
+
+    FrameGraphStats stats;
+};
+
+// Drops the passes and resources of the previous frame
+void BeginFrameGraph(FrameGraph& graph);
+
+FrameGraphResource CreateTexture(FrameGraph& graph, const char* name, const FrameGraphTextureDesc& desc);
+FrameGraphResource ImportTexture(FrameGraph& graph, const char* name, GLuint texture, const FrameGraphTextureDesc& desc);
+
+u32 AddPass(FrameGraph& graph, const char* name, FrameGraphExecute execute);
+void SetPassSideEffect(FrameGraph& graph, u32 pass);
+
+void ReadTexture(FrameGraph& graph, u32 pass, FrameGraphResource resource, FrameGraphAccess access);
+
+// Returns the new version of the texture. Unless the pass overwrites it
+// all (clears it), the previous contents are read as well.
+FrameGraphResource WriteTexture(FrameGraph& graph, u32 pass, FrameGraphResource resource, FrameGraphAccess access, bool keepContents = true);
+
+// The transients are back in the pool when it returns, they are only
+// reused by later frames, which the GL orders after this one
+void CompileFrameGraph(FrameGraph& graph, RenderTargetPool& pool);
+void ExecuteFrameGraph(FrameGraph& graph);
+
+// Valid from CompileFrameGraph on
+GLuint GetTexture(const FrameGraph& graph, FrameGraphResource resource);
+FrameGraphTextureDesc GetTextureDesc(const FrameGraph& graph, FrameGraphResource resource);
+
+// Framebuffer with the textures attached in order, depth formats to the
+// depth attachment. Created on first use, 0 for the backbuffer.
+GLuint GetFramebuffer(FrameGraph& graph, const FrameGraphResource* attachments, u32 count);
+
+// Graphviz description of the last compiled frame
+bool DumpFrameGraph(const FrameGraph& graph, const char* filepath);
+
+// Framebuffers, the textures belong to the pool
+void DestroyFrameGraph(FrameGraph& graph);
+
+#endif // FRAME_GRAPH_H
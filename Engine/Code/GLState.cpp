@@ -0,0 +1,179 @@
+#include "GLState.h"
+#include "BufferManagement.h"
+
+// Records the outcome of a setter, true when the call has to be issued
+static bool UpdateShadow(GLStateCache& state, GLuint& shadow, GLuint value)
+{
+    if (shadow == value)
+    {
+        state.stats.filtered++;
+        return false;
+    }
+
+    shadow = value;
+    state.stats.issued++;
+    return true;
+}
+
+static void SetCapability(GLStateCache& state, GLuint& shadow, GLenum capability, bool enabled)
+{
+    if (UpdateShadow(state, shadow, enabled ? 1 : 0))
+    {
+        if (enabled)
+        {
+            glEnable(capability);
+        }
+        else
+        {
+            glDisable(capability);
+        }
+    }
+}
+
+static bool UpdateBufferBinding(GLStateCache& state, GLBufferBinding& shadow, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    if (shadow.handle == buffer && shadow.offset == offset && shadow.size == size)
+    {
+        state.stats.filtered++;
+        return false;
+    }
+
+    shadow = { buffer, offset, size };
+    state.stats.issued++;
+    return true;
+}
+
+void InvalidateGLState(GLStateCache& state)
+{
+    state.program = GL_STATE_UNKNOWN;
+    state.vertexArray = GL_STATE_UNKNOWN;
+    state.activeTextureUnit = GL_STATE_UNKNOWN;
+    for (u32 i = 0; i < GL_STATE_TEXTURE_UNITS; ++i)
+    {
+        state.textures[i] = GL_STATE_UNKNOWN;
+    }
+    for (u32 i = 0; i < GL_STATE_BUFFER_BINDINGS; ++i)
+    {
+        state.uniformBuffers[i] = { GL_STATE_UNKNOWN, 0, 0 };
+        state.storageBuffers[i] = { GL_STATE_UNKNOWN, 0, 0 };
+    }
+
+    state.blend = GL_STATE_UNKNOWN;
+    state.blendSource = GL_STATE_UNKNOWN;
+    state.blendDestination = GL_STATE_UNKNOWN;
+    state.depthTest = GL_STATE_UNKNOWN;
+    state.depthWrite = GL_STATE_UNKNOWN;
+    state.depthFunc = GL_STATE_UNKNOWN;
+    state.cullFace = GL_STATE_UNKNOWN;
+    state.cullMode = GL_STATE_UNKNOWN;
+
+    state.stats = {};
+}
+
+void UseProgram(GLStateCache& state, GLuint program)
+{
+    if (UpdateShadow(state, state.program, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+void BindVertexArray(GLStateCache& state, GLuint vertexArray)
+{
+    if (UpdateShadow(state, state.vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+    }
+}
+
+void BindTexture(GLStateCache& state, u32 unit, GLuint texture)
+{
+    ASSERT(unit < GL_STATE_TEXTURE_UNITS, "Texture unit not tracked");
+
+    if (state.textures[unit] == texture)
+    {
+        state.stats.filtered++;
+        return;
+    }
+
+    if (UpdateShadow(state, state.activeTextureUnit, unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    state.textures[unit] = texture;
+    state.stats.issued++;
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void BindUniformBufferRange(GLStateCache& state, u32 index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    ASSERT(index < GL_STATE_BUFFER_BINDINGS, "Uniform buffer binding not tracked");
+
+    if (UpdateBufferBinding(state, state.uniformBuffers[index], buffer, offset, size))
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, offset, size);
+    }
+}
+
+void BindStorageBuffer(GLStateCache& state, u32 index, GLuint buffer)
+{
+    ASSERT(index < GL_STATE_BUFFER_BINDINGS, "Storage buffer binding not tracked");
+
+    if (UpdateBufferBinding(state, state.storageBuffers[index], buffer, 0, 0))
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, buffer);
+    }
+}
+
+void SetBlend(GLStateCache& state, bool enabled)
+{
+    SetCapability(state, state.blend, GL_BLEND, enabled);
+}
+
+void SetBlendFunc(GLStateCache& state, GLenum source, GLenum destination)
+{
+    if (state.blendSource == source && state.blendDestination == destination)
+    {
+        state.stats.filtered++;
+        return;
+    }
+
+    state.blendSource = source;
+    state.blendDestination = destination;
+    state.stats.issued++;
+    glBlendFunc(source, destination);
+}
+
+void SetDepthTest(GLStateCache& state, bool enabled)
+{
+    SetCapability(state, state.depthTest, GL_DEPTH_TEST, enabled);
+}
+
+void SetDepthWrite(GLStateCache& state, bool enabled)
+{
+    if (UpdateShadow(state, state.depthWrite, enabled ? 1 : 0))
+    {
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void SetDepthFunc(GLStateCache& state, GLenum func)
+{
+    if (UpdateShadow(state, state.depthFunc, func))
+    {
+        glDepthFunc(func);
+    }
+}
+
+void SetCullFace(GLStateCache& state, bool enabled)
+{
+    SetCapability(state, state.cullFace, GL_CULL_FACE, enabled);
+}
+
+void SetCullMode(GLStateCache& state, GLenum mode)
+{
+    if (UpdateShadow(state, state.cullMode, mode))
+    {
+        glCullFace(mode);
+    }
+}
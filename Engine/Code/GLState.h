@@ -0,0 +1,76 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "platform.h"
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the render passes change the most. Every
+// setter compares against the shadow first and only reaches the driver when
+// the value actually changes, so passes can set everything they rely on
+// without caring what the previous pass left bound, and never unbind.
+//
+// State changed behind its back (resource creation, ImGui) makes the shadow
+// stale: InvalidateGLState forgets everything, it runs at the start of every
+// frame. Within a frame the state below must only go through these setters.
+
+#define GL_STATE_TEXTURE_UNITS 16
+#define GL_STATE_BUFFER_BINDINGS 16     // Uniform and storage binding points tracked
+
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu    // Shadow value that never matches, forces the next call
+
+struct GLBufferBinding
+{
+    GLuint handle;
+    GLintptr offset;
+    GLsizeiptr size;    // 0 for whole buffer bindings
+};
+
+struct GLStateStats
+{
+    u32 issued;     // Calls that reached the driver
+    u32 filtered;   // Calls dropped because they would not change anything
+};
+
+struct GLStateCache
+{
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeTextureUnit;
+    GLuint textures[GL_STATE_TEXTURE_UNITS];    // GL_TEXTURE_2D binding of every unit
+    GLBufferBinding uniformBuffers[GL_STATE_BUFFER_BINDINGS];
+    GLBufferBinding storageBuffers[GL_STATE_BUFFER_BINDINGS];
+
+    GLuint blend;
+    GLenum blendSource;
+    GLenum blendDestination;
+    GLuint depthTest;
+    GLuint depthWrite;
+    GLenum depthFunc;
+    GLuint cullFace;
+    GLenum cullMode;
+
+    GLStateStats stats;     // Since the last InvalidateGLState
+};
+
+// Forgets the shadowed values and resets the stats
+void InvalidateGLState(GLStateCache& state);
+
+void UseProgram(GLStateCache& state, GLuint program);
+void BindVertexArray(GLStateCache& state, GLuint vertexArray);
+
+// Makes the unit active only when the binding has to change
+void BindTexture(GLStateCache& state, u32 unit, GLuint texture);
+
+void BindUniformBufferRange(GLStateCache& state, u32 index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void BindStorageBuffer(GLStateCache& state, u32 index, GLuint buffer);
+
+void SetBlend(GLStateCache& state, bool enabled);
+void SetBlendFunc(GLStateCache& state, GLenum source, GLenum destination);
+void SetDepthTest(GLStateCache& state, bool enabled);
+void SetDepthWrite(GLStateCache& state, bool enabled);
+void SetDepthFunc(GLStateCache& state, GLenum func);
+void SetCullFace(GLStateCache& state, bool enabled);
+void SetCullMode(GLStateCache& state, GLenum mode);
+
+#endif // GL_STATE_H
@@ -0,0 +1,162 @@
+#include "GeometryArena.h"
+#include "BufferManagement.h"
+
+#include <algorithm>
+
+void InitFreeList(FreeListAllocator& allocator, u32 capacity)
+{
+    allocator.capacity = capacity;
+    allocator.usedCount = 0;
+    allocator.rangeCount = 0;
+    allocator.freeBlocks.clear();
+    if (capacity > 0)
+    {
+        allocator.freeBlocks.push_back({ 0, capacity });
+    }
+}
+
+bool AllocateRange(FreeListAllocator& allocator, u32 count, ArenaRange& range)
+{
+    // Smallest block that fits, lowest offset on ties
+    u32 best = UINT32_MAX;
+    for (u32 i = 0; i < allocator.freeBlocks.size(); ++i)
+    {
+        const ArenaRange& block = allocator.freeBlocks[i];
+        if (block.count >= count && (best == UINT32_MAX || block.count < allocator.freeBlocks[best].count))
+        {
+            best = i;
+        }
+    }
+    if (best == UINT32_MAX)
+    {
+        return false;
+    }
+
+    ArenaRange& block = allocator.freeBlocks[best];
+    range = { block.offset, count };
+    block.offset += count;
+    block.count -= count;
+    if (block.count == 0)
+    {
+        allocator.freeBlocks.erase(allocator.freeBlocks.begin() + best);
+    }
+
+    allocator.usedCount += count;
+    allocator.rangeCount++;
+    return true;
+}
+
+void FreeRange(FreeListAllocator& allocator, const ArenaRange& range)
+{
+    if (range.count == 0)
+    {
+        return;
+    }
+
+    auto next = std::lower_bound(allocator.freeBlocks.begin(), allocator.freeBlocks.end(), range,
+                                 [](const ArenaRange& a, const ArenaRange& b) { return a.offset < b.offset; });
+    ASSERT(next == allocator.freeBlocks.end() || range.offset + range.count <= next->offset, "Freeing a range that overlaps a free block");
+
+    const bool mergesPrevious = next != allocator.freeBlocks.begin() && (next - 1)->offset + (next - 1)->count == range.offset;
+    const bool mergesNext = next != allocator.freeBlocks.end() && range.offset + range.count == next->offset;
+    if (mergesPrevious && mergesNext)
+    {
+        (next - 1)->count += range.count + next->count;
+        allocator.freeBlocks.erase(next);
+    }
+    else if (mergesPrevious)
+    {
+        (next - 1)->count += range.count;
+    }
+    else if (mergesNext)
+    {
+        next->offset = range.offset;
+        next->count += range.count;
+    }
+    else
+    {
+        allocator.freeBlocks.insert(next, range);
+    }
+
+    allocator.usedCount -= range.count;
+    allocator.rangeCount--;
+}
+
+GeometryArena CreateGeometryArena(u32 elementSize, u32 capacity)
+{
+    GeometryArena arena = {};
+    arena.elementSize = elementSize;
+    InitFreeList(arena.allocator, capacity);
+
+    // Bound as a copy target, binding GL_ELEMENT_ARRAY_BUFFER would change
+    // whatever VAO happens to be bound
+    glGenBuffers(1, &arena.handle);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.handle);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * elementSize, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return arena;
+}
+
+void DestroyGeometryArena(GeometryArena& arena)
+{
+    glDeleteBuffers(1, &arena.handle);
+    arena.handle = 0;
+    InitFreeList(arena.allocator, 0);
+}
+
+void UploadArenaRange(const GeometryArena& arena, const ArenaRange& range, u32 elementOffset, const void* data, u32 size)
+{
+    ASSERT((elementOffset * arena.elementSize) + size <= range.count * arena.elementSize, "Uploading past the end of the range");
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.handle);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)(range.offset + elementOffset) * arena.elementSize, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+u32 DefragmentGeometryArena(GeometryArena& arena, const std::vector<ArenaRange*>& ranges)
+{
+    std::vector<ArenaRange*> sorted = ranges;
+    std::sort(sorted.begin(), sorted.end(), [](const ArenaRange* a, const ArenaRange* b) { return a->offset < b->offset; });
+
+    glBindBuffer(GL_COPY_READ_BUFFER, arena.handle);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.handle);
+
+    u32 movedCount = 0;
+    u32 cursor = 0;
+    for (ArenaRange* range : sorted)
+    {
+        if (range->offset > cursor)
+        {
+            // Copies within a buffer may not overlap: move in steps no longer
+            // than the distance, front to back
+            const u32 distance = range->offset - cursor;
+            for (u32 copied = 0; copied < range->count; copied += distance)
+            {
+                const u32 count = glm::min(distance, range->count - copied);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                    (GLintptr)(range->offset + copied) * arena.elementSize,
+                                    (GLintptr)(cursor + copied) * arena.elementSize,
+                                    (GLsizeiptr)count * arena.elementSize);
+            }
+            range->offset = cursor;
+            movedCount += range->count;
+        }
+        cursor = range->offset + range->count;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    const u32 rangeCount = arena.allocator.rangeCount;
+    InitFreeList(arena.allocator, arena.allocator.capacity);
+    arena.allocator.usedCount = cursor;
+    arena.allocator.rangeCount = rangeCount;
+    arena.allocator.freeBlocks.clear();
+    if (cursor < arena.allocator.capacity)
+    {
+        arena.allocator.freeBlocks.push_back({ cursor, arena.allocator.capacity - cursor });
+    }
+
+    return movedCount;
+}
@@ -0,0 +1,58 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include "platform.h"
+
+#include <glad/glad.h>
+#include <vector>
+
+// Large GL buffers the static geometry of every mesh is sub-allocated from.
+// An arena holds a single kind of element (vertices of one layout, or indices
+// of one type) and hands out ranges counted in elements, so a range goes
+// straight into baseVertex or firstIndex and meshes sharing an arena are
+// drawn without rebinding buffers.
+
+// New arenas start at this many bytes, or at the size of the range that did
+// not fit anywhere else if it is larger
+#define GEOMETRY_ARENA_SIZE (16 * 1024 * 1024)
+
+struct ArenaRange
+{
+    u32 offset;     // In elements
+    u32 count;
+};
+
+// Best fit free list. The free blocks are kept sorted by offset and merged
+// with their neighbours on free, so fragmentation only comes from live
+// ranges sitting between the gaps.
+struct FreeListAllocator
+{
+    u32 capacity;
+    u32 usedCount;
+    u32 rangeCount;
+    std::vector<ArenaRange> freeBlocks;
+};
+
+void InitFreeList(FreeListAllocator& allocator, u32 capacity);
+bool AllocateRange(FreeListAllocator& allocator, u32 count, ArenaRange& range);
+void FreeRange(FreeListAllocator& allocator, const ArenaRange& range);
+
+struct GeometryArena
+{
+    GLuint handle;
+    u32 elementSize;    // Vertex stride or index size, in bytes
+    FreeListAllocator allocator;
+};
+
+GeometryArena CreateGeometryArena(u32 elementSize, u32 capacity);
+void DestroyGeometryArena(GeometryArena& arena);
+
+// elementOffset is relative to the start of the range
+void UploadArenaRange(const GeometryArena& arena, const ArenaRange& range, u32 elementOffset, const void* data, u32 size);
+
+// Slides the live ranges of the arena (all of them, in any order) down to
+// the lowest free offsets, updating them in place, so the free space ends
+// up as a single block at the end. Returns the elements moved.
+u32 DefragmentGeometryArena(GeometryArena& arena, const std::vector<ArenaRange*>& ranges);
+
+#endif // GEOMETRY_ARENA_H
@@ -0,0 +1,300 @@
+#include "MeshOptimizer.h"
+
+#include <string.h>
+#include <algorithm>
+
+// FIFO cache simulated with insertion timestamps: a vertex is a hit while
+// fewer than VERTEX_CACHE_SIZE vertices were inserted after it
+struct VertexCacheSimulation
+{
+    std::vector<u32> insertTime;
+    u32 time;
+
+    explicit VertexCacheSimulation(u32 vertexCount) : insertTime(vertexCount, 0), time(VERTEX_CACHE_SIZE + 1) {}
+
+    // Returns 1 on a miss
+    u32 Access(u32 vertex)
+    {
+        if (time - insertTime[vertex] > VERTEX_CACHE_SIZE)
+        {
+            insertTime[vertex] = time++;
+            return 1;
+        }
+        return 0;
+    }
+
+    void Flush()
+    {
+        time += VERTEX_CACHE_SIZE + 1;
+    }
+};
+
+static u32 GetMaxIndex(const u32* indices, u32 indexCount)
+{
+    u32 maxIndex = 0;
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        maxIndex = glm::max(maxIndex, indices[i]);
+    }
+    return maxIndex;
+}
+
+VertexCacheStats AnalyzeVertexCache(const u32* indices, u32 indexCount, u32 vertexCount)
+{
+    VertexCacheSimulation cache(vertexCount);
+    std::vector<u8> used(vertexCount, 0);
+
+    u32 misses = 0;
+    u32 usedCount = 0;
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        misses += cache.Access(indices[i]);
+        usedCount += used[indices[i]] ? 0 : 1;
+        used[indices[i]] = 1;
+    }
+
+    VertexCacheStats stats = {};
+    stats.acmr = indexCount > 0 ? misses / (indexCount / 3.0f) : 0.0f;
+    stats.atvr = usedCount > 0 ? misses / (f32)usedCount : 0.0f;
+    return stats;
+}
+
+void OptimizeVertexCache(u32* indices, u32 indexCount, u32 vertexCount)
+{
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+    vertexCount = glm::min(vertexCount, GetMaxIndex(indices, indexCount) + 1);
+
+    // Triangles around every vertex, and how many of them are still to emit
+    std::vector<u32> live(vertexCount, 0);
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        live[indices[i]]++;
+    }
+    std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + live[v];
+    }
+    std::vector<u32> adjacency(indexCount);
+    std::vector<u32> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        adjacency[adjacencyFill[indices[i]]++] = i / 3;
+    }
+
+    VertexCacheSimulation cache(vertexCount);
+    std::vector<u8> emitted(triangleCount, 0);
+    std::vector<u32> deadEnds;
+    std::vector<u32> candidates;
+    std::vector<u32> output;
+    output.reserve(indexCount);
+    u32 cursor = 0;
+
+    // Next fanning vertex when none of the candidates is worth it: the last
+    // emitted vertex with triangles left, or the next one in vertex order
+    auto skipDeadEnd = [&]() -> u32
+    {
+        while (!deadEnds.empty())
+        {
+            const u32 vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[vertex] > 0)
+            {
+                return vertex;
+            }
+        }
+        for (; cursor < vertexCount; ++cursor)
+        {
+            if (live[cursor] > 0)
+            {
+                return cursor;
+            }
+        }
+        return UINT32_MAX;
+    };
+
+    u32 fanning = skipDeadEnd();
+    while (fanning != UINT32_MAX)
+    {
+        candidates.clear();
+        for (u32 a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a)
+        {
+            const u32 t = adjacency[a];
+            if (emitted[t])
+            {
+                continue;
+            }
+            emitted[t] = 1;
+
+            for (u32 i = 0; i < 3; ++i)
+            {
+                const u32 vertex = indices[t * 3 + i];
+                output.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+                cache.Access(vertex);
+            }
+        }
+
+        // The candidate that entered the cache first among those whose
+        // remaining fan would still fit before they are evicted
+        u32 next = UINT32_MAX;
+        u32 bestAge = 0;
+        for (u32 vertex : candidates)
+        {
+            if (live[vertex] == 0)
+            {
+                continue;
+            }
+            const u32 age = cache.time - cache.insertTime[vertex];
+            if (age + 2 * live[vertex] <= VERTEX_CACHE_SIZE && age > bestAge)
+            {
+                bestAge = age;
+                next = vertex;
+            }
+        }
+        fanning = next != UINT32_MAX ? next : skipDeadEnd();
+    }
+
+    memcpy(indices, output.data(), indexCount * sizeof(u32));
+}
+
+void OptimizeOverdraw(u32* indices, u32 indexCount, const f32* vertices, u32 floatStride, f32 threshold)
+{
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+    const u32 vertexCount = GetMaxIndex(indices, indexCount) + 1;
+
+    std::vector<u32> triangleMisses(triangleCount);
+    {
+        VertexCacheSimulation cache(vertexCount);
+        for (u32 t = 0; t < triangleCount; ++t)
+        {
+            triangleMisses[t] = cache.Access(indices[t * 3 + 0]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+        }
+    }
+
+    // Hard boundaries: the cache optimisation started over, nothing is lost
+    // by cutting there
+    std::vector<u32> hardClusters;
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        if (t == 0 || triangleMisses[t] == 3)
+        {
+            hardClusters.push_back(t);
+        }
+    }
+    hardClusters.push_back(triangleCount);
+
+    // Soft boundaries: cut again as soon as the cluster so far is cheap
+    // enough that starting over with a cold cache stays under the threshold
+    std::vector<u32> clusters;
+    VertexCacheSimulation cache(vertexCount);
+    for (u32 c = 0; c + 1 < hardClusters.size(); ++c)
+    {
+        const u32 start = hardClusters[c];
+        const u32 end = hardClusters[c + 1];
+
+        u32 clusterMisses = 0;
+        for (u32 t = start; t < end; ++t)
+        {
+            clusterMisses += triangleMisses[t];
+        }
+        const f32 clusterThreshold = threshold * clusterMisses / (f32)(end - start);
+
+        clusters.push_back(start);
+        cache.Flush();
+        u32 runningStart = start;
+        u32 runningMisses = 0;
+        for (u32 t = start; t < end; ++t)
+        {
+            runningMisses += cache.Access(indices[t * 3 + 0]) + cache.Access(indices[t * 3 + 1]) + cache.Access(indices[t * 3 + 2]);
+            if (t + 1 < end && runningMisses <= clusterThreshold * (t + 1 - runningStart))
+            {
+                clusters.push_back(t + 1);
+                cache.Flush();
+                runningStart = t + 1;
+                runningMisses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Sort key: how much the cluster faces away from the mesh centroid
+    auto getPosition = [&](u32 vertex)
+    {
+        const f32* position = vertices + vertex * floatStride;
+        return glm::vec3(position[0], position[1], position[2]);
+    };
+
+    std::vector<glm::vec3> clusterCentroids(clusters.size() - 1, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(clusters.size() - 1, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    f32 meshArea = 0.0f;
+    for (u32 c = 0; c + 1 < clusters.size(); ++c)
+    {
+        f32 clusterArea = 0.0f;
+        for (u32 t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const glm::vec3 p0 = getPosition(indices[t * 3 + 0]);
+            const glm::vec3 p1 = getPosition(indices[t * 3 + 1]);
+            const glm::vec3 p2 = getPosition(indices[t * 3 + 2]);
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const f32 area = glm::length(normal);
+
+            clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+            clusterNormals[c] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += clusterCentroids[c];
+        meshArea += clusterArea;
+        clusterCentroids[c] = clusterArea > 0.0f ? clusterCentroids[c] / clusterArea : getPosition(indices[clusters[c] * 3]);
+    }
+    meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+    std::vector<f32> clusterKeys(clusters.size() - 1);
+    std::vector<u32> clusterOrder(clusters.size() - 1);
+    for (u32 c = 0; c + 1 < clusters.size(); ++c)
+    {
+        const f32 normalLength = glm::length(clusterNormals[c]);
+        clusterKeys[c] = normalLength > 0.0f ? glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength) : 0.0f;
+        clusterOrder[c] = c;
+    }
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](u32 a, u32 b) { return clusterKeys[a] > clusterKeys[b]; });
+
+    std::vector<u32> output;
+    output.reserve(indexCount);
+    for (u32 c : clusterOrder)
+    {
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+    memcpy(indices, output.data(), indexCount * sizeof(u32));
+}
+
+void OptimizeVertexFetch(std::vector<f32>& vertices, u32 floatStride, std::vector<u32>& indices)
+{
+    std::vector<u32> remap(vertices.size() / floatStride, UINT32_MAX);
+    std::vector<f32> reordered;
+    reordered.reserve(vertices.size());
+
+    u32 nextVertex = 0;
+    for (u32& index : indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = nextVertex++;
+            reordered.insert(reordered.end(), vertices.begin() + index * floatStride, vertices.begin() + (index + 1) * floatStride);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
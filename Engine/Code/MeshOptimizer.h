@@ -0,0 +1,39 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "platform.h"
+
+#include <vector>
+
+// Triangle and vertex orderings for the post-transform vertex cache, for
+// overdraw and for vertex fetch. All of them keep the triangle set as is.
+
+// FIFO entries assumed for the post-transform cache, by the optimisation
+// and the statistics alike
+#define VERTEX_CACHE_SIZE 16
+
+struct VertexCacheStats
+{
+    f32 acmr;   // Average cache miss ratio: transformed vertices per triangle, 0.5 at best
+    f32 atvr;   // Average transformed vertex ratio: transformed vertices per vertex, 1 at best
+};
+
+VertexCacheStats AnalyzeVertexCache(const u32* indices, u32 indexCount, u32 vertexCount);
+
+// Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw"): fans around the vertices still in the
+// cache, linear in the triangle count. Reorders the triangles in place.
+void OptimizeVertexCache(u32* indices, u32 indexCount, u32 vertexCount);
+
+// Splits the cache optimised order into clusters wherever restarting costs
+// less than threshold times the ACMR of the cluster (1.05 keeps the ACMR
+// within 5%), then draws the clusters facing away from the mesh center
+// first, as they tend to occlude the rest. Positions are expected in the
+// first three floats of every vertex.
+void OptimizeOverdraw(u32* indices, u32 indexCount, const f32* vertices, u32 floatStride, f32 threshold);
+
+// Renumbers the vertices in the order the indices first use them, so the
+// fetches walk the vertex buffer forward. Unreferenced vertices are dropped.
+void OptimizeVertexFetch(std::vector<f32>& vertices, u32 floatStride, std::vector<u32>& indices);
+
+#endif // MESH_OPTIMIZER_H
@@ -0,0 +1,347 @@
+#include "MeshSimplifier.h"
+
+#include <float.h>
+#include <string.h>
+#include <queue>
+#include <unordered_map>
+
+// Symmetric 4x4 matrix of the summed plane equations, plus the summed
+// plane weights so errors come out as squared distances
+struct Quadric
+{
+    f64 a00, a11, a22;
+    f64 a01, a02, a12;
+    f64 b0, b1, b2;
+    f64 c;
+    f64 weight;
+};
+
+struct Collapse
+{
+    f32 cost;           // Squared distance
+    u32 from;
+    u32 to;
+    u32 fromVersion;    // Quadric versions the cost was computed with
+    u32 toVersion;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+static void AddPlane(Quadric& q, const glm::dvec3& normal, f64 distance, f64 weight)
+{
+    q.a00 += weight * normal.x * normal.x;
+    q.a11 += weight * normal.y * normal.y;
+    q.a22 += weight * normal.z * normal.z;
+    q.a01 += weight * normal.x * normal.y;
+    q.a02 += weight * normal.x * normal.z;
+    q.a12 += weight * normal.y * normal.z;
+    q.b0 += weight * normal.x * distance;
+    q.b1 += weight * normal.y * distance;
+    q.b2 += weight * normal.z * distance;
+    q.c += weight * distance * distance;
+    q.weight += weight;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+    q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+    q.a01 += other.a01; q.a02 += other.a02; q.a12 += other.a12;
+    q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// Unnormalized p^T A p + 2 b.p + c
+static f64 EvaluateQuadric(const Quadric& q, const glm::vec3& p)
+{
+    const f64 x = p.x, y = p.y, z = p.z;
+    return q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+           2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+           2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+           q.c;
+}
+
+static f32 CollapseCost(const Quadric& from, const Quadric& to, const glm::vec3& position)
+{
+    const f64 weight = from.weight + to.weight;
+    const f64 error = (EvaluateQuadric(from, position) + EvaluateQuadric(to, position)) / (weight > 0.0 ? weight : 1.0);
+    return (f32)glm::max(error, 0.0);
+}
+
+static u64 MakeEdgeKey(u32 a, u32 b)
+{
+    return a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+}
+
+std::vector<u32> SimplifyMesh(const f32* vertices, u32 vertexCount, u32 floatStride, const std::vector<u32>& indices,
+                              u32 targetIndexCount, f32 maxError, f32& error)
+{
+    error = 0.0f;
+
+    std::vector<glm::vec3> positions(vertexCount);
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        const f32* vertex = vertices + v * floatStride;
+        positions[v] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+    }
+
+    std::vector<u32> triangles = indices;
+    const u32 triangleCount = (u32)triangles.size() / 3;
+
+    // --- Welded positions --- //
+    // Collapses work on positions; the vertices sharing one (its wedges,
+    // split by UV or normal seams) all move together
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3& p) const
+        {
+            // + 0.0f folds -0 into 0, which compares equal
+            u32 bits[3];
+            const glm::vec3 q = p + glm::vec3(0.0f);
+            memcpy(bits, &q, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+    std::unordered_map<glm::vec3, u32, PositionHash> positionLookup;
+    std::vector<u32> vertexPosition(vertexCount);
+    std::vector<std::vector<u32>> wedges;
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        auto it = positionLookup.emplace(positions[v], (u32)wedges.size());
+        if (it.second)
+        {
+            wedges.push_back({});
+        }
+        vertexPosition[v] = it.first->second;
+        wedges[it.first->second].push_back(v);
+    }
+    const u32 positionCount = (u32)wedges.size();
+
+    // Open borders of the welded mesh never move
+    std::vector<u8> locked(positionCount, 0);
+    std::unordered_map<u64, u32> edgeUseCount;
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        for (u32 e = 0; e < 3; ++e)
+        {
+            edgeUseCount[MakeEdgeKey(vertexPosition[triangles[t * 3 + e]], vertexPosition[triangles[t * 3 + (e + 1) % 3]])]++;
+        }
+    }
+    for (const auto& edge : edgeUseCount)
+    {
+        if (edge.second == 1)
+        {
+            locked[edge.first >> 32] = 1;
+            locked[edge.first & 0xFFFFFFFF] = 1;
+        }
+    }
+
+    // --- Quadrics and adjacency --- //
+    std::vector<Quadric> quadrics(positionCount, Quadric{});
+    std::vector<std::vector<u32>> vertexTriangles(vertexCount);
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        const u32* tri = &triangles[t * 3];
+        const glm::dvec3 p0 = positions[tri[0]];
+        const glm::dvec3 p1 = positions[tri[1]];
+        const glm::dvec3 p2 = positions[tri[2]];
+
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const f64 doubleArea = glm::length(normal);
+        if (doubleArea > 0.0)
+        {
+            normal /= doubleArea;
+            for (u32 i = 0; i < 3; ++i)
+            {
+                AddPlane(quadrics[vertexPosition[tri[i]]], normal, -glm::dot(normal, p0), doubleArea * 0.5);
+            }
+        }
+
+        for (u32 i = 0; i < 3; ++i)
+        {
+            vertexTriangles[tri[i]].push_back(t);
+        }
+    }
+
+    std::vector<u8> triangleRemoved(triangleCount, 0);
+    std::vector<u32> versions(positionCount, 0);
+    std::vector<u8> collapsed(positionCount, 0);
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+    auto pushCollapse = [&](u32 from, u32 to)
+    {
+        if (!locked[from] && from != to)
+        {
+            queue.push({ CollapseCost(quadrics[from], quadrics[to], positions[wedges[to][0]]), from, to, versions[from], versions[to] });
+        }
+    };
+
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        for (u32 e = 0; e < 3; ++e)
+        {
+            const u32 a = vertexPosition[triangles[t * 3 + e]];
+            const u32 b = vertexPosition[triangles[t * 3 + (e + 1) % 3]];
+            pushCollapse(a, b);
+            pushCollapse(b, a);
+        }
+    }
+
+    auto touchesPosition = [&](u32 t, u32 position)
+    {
+        const u32* tri = &triangles[t * 3];
+        return vertexPosition[tri[0]] == position || vertexPosition[tri[1]] == position || vertexPosition[tri[2]] == position;
+    };
+
+    // --- Collapses, cheapest first --- //
+    const f32 maxErrorSq = maxError < FLT_MAX ? maxError * maxError : FLT_MAX;
+    u32 remainingTriangles = triangleCount;
+    std::vector<u32> wedgeTargets;
+
+    while (!queue.empty() && remainingTriangles * 3 > targetIndexCount)
+    {
+        const Collapse collapse = queue.top();
+        queue.pop();
+
+        const u32 from = collapse.from;
+        const u32 to = collapse.to;
+        if (collapsed[from] || collapsed[to] || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion)
+        {
+            continue; // Stale, a newer entry exists if the collapse is still possible
+        }
+        if (collapse.cost > maxErrorSq)
+        {
+            break;
+        }
+
+        // Every wedge of from has to land on the one wedge of to it shares an
+        // edge with, and seams may only slide along themselves: two wedges
+        // of from ending up on the same vertex would stretch the attributes
+        bool valid = true;
+        wedgeTargets.clear();
+        for (u32 wedge : wedges[from])
+        {
+            u32 target = UINT32_MAX;
+            for (u32 t : vertexTriangles[wedge])
+            {
+                for (u32 i = 0; i < 3 && !triangleRemoved[t]; ++i)
+                {
+                    const u32 corner = triangles[t * 3 + i];
+                    if (vertexPosition[corner] == to)
+                    {
+                        valid = valid && (target == UINT32_MAX || target == corner);
+                        target = corner;
+                    }
+                }
+            }
+
+            for (u32 other : wedgeTargets)
+            {
+                valid = valid && other != target;
+            }
+            valid = valid && target != UINT32_MAX;
+            wedgeTargets.push_back(target);
+        }
+
+        // Moving from onto to must not flip any of the triangles that survive
+        const glm::vec3 target = positions[wedges[to][0]];
+        for (u32 wedge : wedges[from])
+        {
+            for (u32 t : vertexTriangles[wedge])
+            {
+                if (!valid || triangleRemoved[t] || touchesPosition(t, to))
+                {
+                    continue;
+                }
+
+                const u32* tri = &triangles[t * 3];
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    before[i] = positions[tri[i]];
+                    after[i] = tri[i] == wedge ? target : positions[tri[i]];
+                }
+
+                const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                valid = glm::dot(normalBefore, normalAfter) > 0.0f;
+            }
+        }
+        if (!valid)
+        {
+            continue;
+        }
+
+        AddQuadric(quadrics[to], quadrics[from]);
+        versions[to]++;
+        collapsed[from] = 1;
+        error = glm::max(error, collapse.cost);
+
+        for (u32 w = 0; w < wedges[from].size(); ++w)
+        {
+            const u32 wedge = wedges[from][w];
+            const u32 wedgeTarget = wedgeTargets[w];
+
+            for (u32 t : vertexTriangles[wedge])
+            {
+                if (triangleRemoved[t])
+                {
+                    continue;
+                }
+                if (touchesPosition(t, to))
+                {
+                    triangleRemoved[t] = 1;
+                    remainingTriangles--;
+                    continue;
+                }
+
+                u32* tri = &triangles[t * 3];
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    tri[i] = tri[i] == wedge ? wedgeTarget : tri[i];
+                }
+                vertexTriangles[wedgeTarget].push_back(t);
+            }
+            vertexTriangles[wedge].clear();
+        }
+
+        // Drop the triangles that just went away and queue the new neighbourhood
+        for (u32 wedge : wedges[to])
+        {
+            std::vector<u32>& wedgeTriangles = vertexTriangles[wedge];
+            u32 kept = 0;
+            for (u32 t : wedgeTriangles)
+            {
+                if (!triangleRemoved[t])
+                {
+                    wedgeTriangles[kept++] = t;
+                }
+            }
+            wedgeTriangles.resize(kept);
+
+            for (u32 t : wedgeTriangles)
+            {
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    const u32 neighbour = vertexPosition[triangles[t * 3 + i]];
+                    pushCollapse(to, neighbour);
+                    pushCollapse(neighbour, to);
+                }
+            }
+        }
+    }
+
+    error = glm::sqrt(error);
+
+    std::vector<u32> result;
+    result.reserve(remainingTriangles * 3);
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        if (!triangleRemoved[t])
+        {
+            result.insert(result.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,25 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "platform.h"
+
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert) by half-edge
+// collapses: a vertex is only ever merged into one of its neighbours, so
+// the simplified indices still point into the original vertex buffer and
+// every LOD of a mesh can share it.
+//
+// Vertices on open borders never move. Vertices sharing their position
+// with another one (UV and normal seams) move together and only slide
+// along the seam, which keeps the LODs free of cracks; meshes split at
+// every face, like flat shaded ones, can't be simplified at all.
+
+// Positions are expected in the first three floats of every vertex.
+// Stops at targetIndexCount indices or when the next collapse would move
+// the surface by more than maxError. error receives the largest distance
+// any accepted collapse may have moved the surface by, in object space.
+std::vector<u32> SimplifyMesh(const f32* vertices, u32 vertexCount, u32 floatStride, const std::vector<u32>& indices,
+                              u32 targetIndexCount, f32 maxError, f32& error);
+
+#endif // MESH_SIMPLIFIER_H
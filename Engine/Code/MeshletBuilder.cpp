@@ -0,0 +1,262 @@
+#include "MeshletBuilder.h"
+
+#include <float.h>
+#include <string.h>
+#include <unordered_map>
+
+static glm::vec3 GetPosition(const f32* vertices, u32 floatStride, u32 vertex)
+{
+    const f32* position = vertices + vertex * floatStride;
+    return glm::vec3(position[0], position[1], position[2]);
+}
+
+// Bounding sphere and normal cone of count triangles
+static void ComputeMeshletBounds(const f32* vertices, u32 floatStride, const u32* triangles, u32 count, Meshlet& meshlet)
+{
+    AABB aabb = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    for (u32 i = 0; i < count * 3; ++i)
+    {
+        const glm::vec3 position = GetPosition(vertices, floatStride, triangles[i]);
+        aabb.min = glm::min(aabb.min, position);
+        aabb.max = glm::max(aabb.max, position);
+    }
+
+    meshlet.boundingSphere = { (aabb.min + aabb.max) * 0.5f, 0.0f };
+    for (u32 i = 0; i < count * 3; ++i)
+    {
+        const glm::vec3 position = GetPosition(vertices, floatStride, triangles[i]);
+        meshlet.boundingSphere.radius = glm::max(meshlet.boundingSphere.radius, glm::length(position - meshlet.boundingSphere.center));
+    }
+
+    // Axis: average face normal. The cone only culls when every normal is
+    // within ~84 degrees of it, wider cones almost never cull anything.
+    std::vector<glm::vec3> normals(count, glm::vec3(0.0f));
+    glm::vec3 axis(0.0f);
+    for (u32 t = 0; t < count; ++t)
+    {
+        const glm::vec3 p0 = GetPosition(vertices, floatStride, triangles[t * 3 + 0]);
+        const glm::vec3 p1 = GetPosition(vertices, floatStride, triangles[t * 3 + 1]);
+        const glm::vec3 p2 = GetPosition(vertices, floatStride, triangles[t * 3 + 2]);
+        const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const f32 length = glm::length(normal);
+        if (length > 0.0f)
+        {
+            normals[t] = normal / length;
+            axis += normals[t];
+        }
+    }
+
+    meshlet.coneApex = meshlet.boundingSphere.center;
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+
+    const f32 axisLength = glm::length(axis);
+    if (axisLength <= 0.0f)
+    {
+        return;
+    }
+    axis /= axisLength;
+
+    f32 minDot = 1.0f;
+    for (u32 t = 0; t < count; ++t)
+    {
+        if (normals[t] != glm::vec3(0.0f))
+        {
+            minDot = glm::min(minDot, glm::dot(axis, normals[t]));
+        }
+    }
+    if (minDot <= 0.1f)
+    {
+        return;
+    }
+
+    // Move the apex back along the axis until it lies behind every triangle
+    // plane, so the test holds for viewers close to the meshlet as well
+    f32 maxT = 0.0f;
+    for (u32 t = 0; t < count; ++t)
+    {
+        if (normals[t] != glm::vec3(0.0f))
+        {
+            const glm::vec3 p0 = GetPosition(vertices, floatStride, triangles[t * 3 + 0]);
+            const f32 distance = glm::dot(meshlet.boundingSphere.center - p0, normals[t]);
+            maxT = glm::max(maxT, distance / glm::dot(axis, normals[t]));
+        }
+    }
+
+    meshlet.coneApex = meshlet.boundingSphere.center - axis * maxT;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = glm::sqrt(1.0f - minDot * minDot);
+}
+
+void BuildMeshlets(const f32* vertices, u32 vertexCount, u32 floatStride, u32* indices, u32 indexCount,
+                   u32 firstIndex, std::vector<Meshlet>& meshlets)
+{
+    const u32 triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // --- Adjacency through welded positions --- //
+    // UV and normal seams split vertices, growing across them keeps
+    // meshlets compact on meshes that are split everywhere
+    struct PositionHash
+    {
+        size_t operator()(const glm::vec3& p) const
+        {
+            // + 0.0f folds -0 into 0, which compares equal
+            u32 bits[3];
+            const glm::vec3 q = p + glm::vec3(0.0f);
+            memcpy(bits, &q, sizeof(bits));
+            return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        }
+    };
+    std::unordered_map<glm::vec3, u32, PositionHash> positionLookup;
+    std::vector<u32> vertexPosition(vertexCount, UINT32_MAX);
+    for (u32 i = 0; i < indexCount; ++i)
+    {
+        const u32 vertex = indices[i];
+        if (vertexPosition[vertex] == UINT32_MAX)
+        {
+            vertexPosition[vertex] = positionLookup.emplace(GetPosition(vertices, floatStride, vertex), (u32)positionLookup.size()).first->second;
+        }
+    }
+
+    std::vector<std::vector<u32>> positionTriangles(positionLookup.size());
+    std::vector<glm::vec3> triangleCenters(triangleCount);
+    for (u32 t = 0; t < triangleCount; ++t)
+    {
+        triangleCenters[t] = glm::vec3(0.0f);
+        for (u32 i = 0; i < 3; ++i)
+        {
+            const u32 vertex = indices[t * 3 + i];
+            std::vector<u32>& adjacent = positionTriangles[vertexPosition[vertex]];
+            if (adjacent.empty() || adjacent.back() != t)
+            {
+                adjacent.push_back(t);
+            }
+            triangleCenters[t] += GetPosition(vertices, floatStride, vertex) / 3.0f;
+        }
+    }
+
+    // --- Greedy growth --- //
+    // Each meshlet starts from a triangle and keeps adding the neighbour that
+    // brings the fewest new vertices, the closest one to the meshlet center
+    // on ties, until a limit is hit or it runs out of neighbours. Small
+    // disconnected pieces end up as small meshlets of their own.
+    std::vector<u32> ordered;
+    ordered.reserve(indexCount);
+    std::vector<u8> emitted(triangleCount, 0);
+    std::vector<u32> vertexMeshlet(vertexCount, UINT32_MAX);
+    std::vector<u32> positionMeshlet(positionLookup.size(), UINT32_MAX);
+
+    std::vector<u32> meshletPositions;
+    u32 meshletVertexCount = 0;
+    u32 meshletTriangleCount = 0;
+    u32 meshletId = 0;
+    glm::vec3 centerSum(0.0f);
+
+    auto addTriangle = [&](u32 t)
+    {
+        emitted[t] = 1;
+        for (u32 i = 0; i < 3; ++i)
+        {
+            const u32 vertex = indices[t * 3 + i];
+            if (vertexMeshlet[vertex] != meshletId)
+            {
+                vertexMeshlet[vertex] = meshletId;
+                meshletVertexCount++;
+            }
+            if (positionMeshlet[vertexPosition[vertex]] != meshletId)
+            {
+                positionMeshlet[vertexPosition[vertex]] = meshletId;
+                meshletPositions.push_back(vertexPosition[vertex]);
+            }
+            ordered.push_back(vertex);
+        }
+        centerSum += triangleCenters[t];
+        meshletTriangleCount++;
+    };
+
+    auto finishMeshlet = [&]()
+    {
+        Meshlet meshlet = {};
+        meshlet.firstIndex = firstIndex + (u32)ordered.size() - meshletTriangleCount * 3;
+        meshlet.indexCount = meshletTriangleCount * 3;
+        ComputeMeshletBounds(vertices, floatStride, ordered.data() + ordered.size() - meshletTriangleCount * 3, meshletTriangleCount, meshlet);
+        meshlets.push_back(meshlet);
+
+        meshletPositions.clear();
+        meshletVertexCount = 0;
+        meshletTriangleCount = 0;
+        centerSum = glm::vec3(0.0f);
+        meshletId++;
+    };
+
+    u32 remaining = triangleCount;
+    u32 seedCursor = 0;
+    while (remaining > 0)
+    {
+        const glm::vec3 center = meshletTriangleCount > 0 ? centerSum / (f32)meshletTriangleCount : glm::vec3(0.0f);
+
+        u32 best = UINT32_MAX;
+        u32 bestNewVertices = UINT32_MAX;
+        f32 bestDistance = FLT_MAX;
+        for (u32 position : meshletPositions)
+        {
+            for (u32 t : positionTriangles[position])
+            {
+                if (emitted[t])
+                {
+                    continue;
+                }
+
+                u32 newVertices = 0;
+                for (u32 i = 0; i < 3; ++i)
+                {
+                    newVertices += vertexMeshlet[indices[t * 3 + i]] != meshletId ? 1 : 0;
+                }
+                if (meshletVertexCount + newVertices > MESHLET_MAX_VERTICES)
+                {
+                    continue;
+                }
+
+                const f32 distance = glm::length(triangleCenters[t] - center);
+                if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance))
+                {
+                    best = t;
+                    bestNewVertices = newVertices;
+                    bestDistance = distance;
+                }
+            }
+        }
+
+        if (best == UINT32_MAX)
+        {
+            // Full, or out of neighbours: pulling in a disconnected piece
+            // would only make the bounds loose
+            if (meshletTriangleCount > 0)
+            {
+                finishMeshlet();
+                continue;
+            }
+
+            // Seed from the first triangle left, so the meshlets follow the
+            // incoming order (overdraw clusters, see OptimizeOverdraw)
+            while (emitted[seedCursor])
+            {
+                seedCursor++;
+            }
+            best = seedCursor;
+        }
+
+        addTriangle(best);
+        remaining--;
+        if (meshletTriangleCount == MESHLET_MAX_TRIANGLES || remaining == 0)
+        {
+            finishMeshlet();
+        }
+    }
+
+    memcpy(indices, ordered.data(), indexCount * sizeof(u32));
+}
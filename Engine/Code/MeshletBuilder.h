@@ -0,0 +1,39 @@
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include "platform.h"
+#include "Culling.h"
+
+#include <vector>
+
+// Small clusters of neighbouring triangles that are culled on their own,
+// which gives big single meshes a finer culling granularity than the
+// entity. There are no mesh shaders to feed, so a meshlet is just a
+// contiguous range of the index buffer drawn with one indirect command.
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct Meshlet
+{
+    BoundingSphere boundingSphere;  // Object space
+
+    // Normal cone: seen from any point p with
+    // dot(normalize(coneApex - p), coneAxis) >= coneCutoff
+    // every triangle of the meshlet faces away
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    f32 coneCutoff;     // 1 when the normals spread too much to ever cull
+
+    u32 firstIndex;     // Relative to the first index of the submesh
+    u32 indexCount;
+};
+
+// Splits the triangles of indices into meshlets, reordering them in place so
+// every meshlet is a contiguous range. firstIndex is added to the ranges of
+// the meshlets appended to meshlets. Positions are expected in the first
+// three floats of every vertex.
+void BuildMeshlets(const f32* vertices, u32 vertexCount, u32 floatStride, u32* indices, u32 indexCount,
+                   u32 firstIndex, std::vector<Meshlet>& meshlets);
+
+#endif // MESHLET_BUILDER_H
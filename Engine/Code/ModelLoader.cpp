@@ -1,5 +1,10 @@
 #include "ModelLoader.h"
+#include "MeshSimplifier.h"
 #include "engine.h"
+
+#include <float.h>
+#include <string.h>
+#include <glm/gtc/packing.hpp>
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -86,6 +91,11 @@ void ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Mesh* myMesh, u32 bas
     // add the submesh into the mesh
     Submesh submesh = {};
     submesh.vertexBufferLayout = vertexBufferLayout;
+
+    const u32 floatStride = vertexBufferLayout.stride / sizeof(float);
+    submesh.aabb = ComputeAABB(vertices.data(), vertices.size(), floatStride);
+    submesh.boundingSphere = ComputeBoundingSphere(vertices.data(), vertices.size(), floatStride, submesh.aabb);
+
     submesh.vertices.swap(vertices);
     submesh.indices.swap(indices);
     myMesh->submeshes.push_back(submesh);
@@ -207,43 +217,524 @@ u32 LoadModel(App* app, const char* filename)
 
     aiReleaseImport(scene);
 
-    u32 vertexBufferSize = 0;
-    u32 indexBufferSize = 0;
+    const VertexCacheStats importedStats = AnalyzeMeshVertexCache(mesh);
+    OptimizeMesh(mesh);
 
-    for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+    if (!LoadLodCache(mesh, filename))
     {
-        vertexBufferSize += mesh.submeshes[i].vertices.size() * sizeof(float);
-        indexBufferSize += mesh.submeshes[i].indices.size() * sizeof(u32);
+        GenerateMeshLods(mesh);
+        SaveLodCache(mesh, filename);
     }
+    GenerateMeshlets(mesh);
 
-    glGenBuffers(1, &mesh.vertexBufferHandle);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize, NULL, GL_STATIC_DRAW);
+    // Indices are relative to their submesh, whose first vertex is baked into the VAO
+    u32 maxVertexCount = 0;
+    for (const auto& submesh : mesh.submeshes)
+    {
+        maxVertexCount = glm::max(maxVertexCount, (u32)(submesh.vertices.size() / (submesh.vertexBufferLayout.stride / sizeof(float))));
+    }
+    mesh.indexType = maxVertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    mesh.indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(u16) : sizeof(u32);
 
-    glGenBuffers(1, &mesh.indexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, NULL, GL_STATIC_DRAW);
+    const VertexCacheStats optimizedStats = AnalyzeMeshVertexCache(mesh);
+    ILOG("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %u bit indices", filename, importedStats.acmr, optimizedStats.acmr,
+         importedStats.atvr, optimizedStats.atvr, mesh.indexSize * 8);
 
-    u32 indicesOffset = 0;
-    u32 verticesOffset = 0;
+    AABB meshAABB = mesh.submeshes.empty() ? AABB{} : mesh.submeshes[0].aabb;
+    for (u32 i = 1; i < mesh.submeshes.size(); ++i)
+    {
+        meshAABB = MergeAABB(meshAABB, mesh.submeshes[i].aabb);
+    }
+    mesh.boundingSphere = { (meshAABB.min + meshAABB.max) * 0.5f, glm::length(meshAABB.max - meshAABB.min) * 0.5f };
+
+    for (u32 lod = 0; lod < MESH_LOD_COUNT; ++lod)
+    {
+        mesh.lodErrors[lod] = 0.0f;
+        for (const auto& submesh : mesh.submeshes)
+        {
+            mesh.lodErrors[lod] = glm::max(mesh.lodErrors[lod], submesh.lods[lod].error);
+        }
+    }
+
+    // Vertex data as it goes to the GPU and the dequantization constants
+    // of every submesh
+    std::vector<std::vector<u8>> gpuVertices(mesh.submeshes.size());
+    std::vector<VertexDequantization> dequantizations(mesh.submeshes.size());
 
     for (u32 i = 0; i < mesh.submeshes.size(); ++i)
     {
-        const void* verticesData = mesh.submeshes[i].vertices.data();
-        const u32   verticesSize = mesh.submeshes[i].vertices.size() * sizeof(float);
-        glBufferSubData(GL_ARRAY_BUFFER, verticesOffset, verticesSize, verticesData);
-        mesh.submeshes[i].vertexOffset = verticesOffset;
-        verticesOffset += verticesSize;
+        Submesh& submesh = mesh.submeshes[i];
+        if (app->compressVertices)
+        {
+            gpuVertices[i] = PackVertices(submesh, submesh.gpuVertexLayout, dequantizations[i]);
+        }
+        else
+        {
+            const u8* floatData = (const u8*)submesh.vertices.data();
+            gpuVertices[i].assign(floatData, floatData + submesh.vertices.size() * sizeof(float));
+            submesh.gpuVertexLayout = submesh.vertexBufferLayout;
+            dequantizations[i] = { glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) };
+        }
 
-        const void* indicesData = mesh.submeshes[i].indices.data();
-        const u32   indicesSize = mesh.submeshes[i].indices.size() * sizeof(u32);
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indicesOffset, indicesSize, indicesData);
-        mesh.submeshes[i].indexOffset = indicesOffset;
-        indicesOffset += indicesSize;
-    }
+        app->vertexMemoryFloat += submesh.vertices.size() * sizeof(float);
+        app->vertexMemory += gpuVertices[i].size();
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+        UploadSubmeshGeometry(app->geometryArenas, submesh, mesh.indexType, mesh.indexSize, gpuVertices[i], dequantizations[i]);
+    }
 
     return modelIdx;
 }
+
+void GenerateMeshLods(Mesh& mesh)
+{
+    for (auto& submesh : mesh.submeshes)
+    {
+        const u32 floatStride = submesh.vertexBufferLayout.stride / sizeof(float);
+        const u32 vertexCount = submesh.vertices.size() / floatStride;
+
+        submesh.lodIndices.clear();
+        submesh.lods[0] = { 0, (u32)submesh.indices.size(), 0.0f };
+
+        // Every level starts from the previous one, so errors add up
+        std::vector<u32> previous = submesh.indices;
+        for (u32 lod = 1; lod < MESH_LOD_COUNT; ++lod)
+        {
+            f32 lodError = 0.0f;
+            std::vector<u32> simplified = SimplifyMesh(submesh.vertices.data(), vertexCount, floatStride, previous, previous.size() / 2, FLT_MAX, lodError);
+
+            if (simplified.size() >= previous.size())
+            {
+                submesh.lods[lod] = submesh.lods[lod - 1];
+                continue;
+            }
+
+            submesh.lods[lod].firstIndex = submesh.indices.size() + submesh.lodIndices.size();
+            submesh.lods[lod].indexCount = simplified.size();
+            submesh.lods[lod].error = submesh.lods[lod - 1].error + lodError;
+            submesh.lodIndices.insert(submesh.lodIndices.end(), simplified.begin(), simplified.end());
+            previous.swap(simplified);
+        }
+    }
+}
+
+void OptimizeMesh(Mesh& mesh)
+{
+    for (auto& submesh : mesh.submeshes)
+    {
+        const u32 floatStride = submesh.vertexBufferLayout.stride / sizeof(float);
+        const u32 vertexCount = submesh.vertices.size() / floatStride;
+
+        OptimizeVertexCache(submesh.indices.data(), submesh.indices.size(), vertexCount);
+        OptimizeOverdraw(submesh.indices.data(), submesh.indices.size(), submesh.vertices.data(), floatStride, 1.05f);
+        OptimizeVertexFetch(submesh.vertices, floatStride, submesh.indices);
+    }
+}
+
+// Full detail indices of every submesh, weighted by triangles and vertices
+VertexCacheStats AnalyzeMeshVertexCache(const Mesh& mesh)
+{
+    VertexCacheStats total = {};
+    u32 triangleCount = 0;
+    u32 vertexCount = 0;
+    for (const auto& submesh : mesh.submeshes)
+    {
+        const u32 submeshVertexCount = submesh.vertices.size() / (submesh.vertexBufferLayout.stride / sizeof(float));
+        const u32 submeshTriangleCount = submesh.indices.size() / 3;
+        const VertexCacheStats stats = AnalyzeVertexCache(submesh.indices.data(), submesh.indices.size(), submeshVertexCount);
+
+        total.acmr += stats.acmr * submeshTriangleCount;
+        total.atvr += stats.atvr * submeshVertexCount;
+        triangleCount += submeshTriangleCount;
+        vertexCount += submeshVertexCount;
+    }
+    total.acmr = triangleCount > 0 ? total.acmr / triangleCount : 0.0f;
+    total.atvr = vertexCount > 0 ? total.atvr / vertexCount : 0.0f;
+    return total;
+}
+
+void GenerateMeshlets(Mesh& mesh)
+{
+    for (auto& submesh : mesh.submeshes)
+    {
+        const u32 floatStride = submesh.vertexBufferLayout.stride / sizeof(float);
+        const u32 vertexCount = submesh.vertices.size() / floatStride;
+
+        submesh.meshlets.clear();
+        for (u32 lod = 0; lod < MESH_LOD_COUNT; ++lod)
+        {
+            const SubmeshLod& submeshLod = submesh.lods[lod];
+            if (lod > 0 && submeshLod.firstIndex == submesh.lods[lod - 1].firstIndex)
+            {
+                submesh.lodFirstMeshlet[lod] = submesh.lodFirstMeshlet[lod - 1];
+                submesh.lodMeshletCount[lod] = submesh.lodMeshletCount[lod - 1];
+                continue;
+            }
+
+            // LOD 0 is the submesh indices, the rest follow them in lodIndices
+            u32* indices = lod == 0 ? submesh.indices.data() : submesh.lodIndices.data() + (submeshLod.firstIndex - submesh.indices.size());
+
+            submesh.lodFirstMeshlet[lod] = submesh.meshlets.size();
+            BuildMeshlets(submesh.vertices.data(), vertexCount, floatStride, indices, submeshLod.indexCount, submeshLod.firstIndex, submesh.meshlets);
+            submesh.lodMeshletCount[lod] = submesh.meshlets.size() - submesh.lodFirstMeshlet[lod];
+
+            // Growing the meshlets scrambled the cache order, restore it inside each one
+            for (u32 m = submesh.lodFirstMeshlet[lod]; m < submesh.meshlets.size(); ++m)
+            {
+                const Meshlet& meshlet = submesh.meshlets[m];
+                OptimizeVertexCache(indices + (meshlet.firstIndex - submeshLod.firstIndex), meshlet.indexCount, vertexCount);
+            }
+        }
+    }
+}
+
+std::vector<u8> PackVertices(const Submesh& submesh, VertexBufferLayout& packedLayout, VertexDequantization& dequantization)
+{
+    const VertexBufferLayout& layout = submesh.vertexBufferLayout;
+    const u32 floatStride = layout.stride / sizeof(float);
+    const u32 vertexCount = submesh.vertices.size() / floatStride;
+
+    // Float offset of every source attribute, -1 when missing
+    i32 sourceOffsets[5] = { -1, -1, -1, -1, -1 };
+    for (const auto& attribute : layout.attributes)
+    {
+        if (attribute.location < ARRAY_COUNT(sourceOffsets))
+        {
+            sourceOffsets[attribute.location] = attribute.offset / sizeof(float);
+        }
+    }
+
+    packedLayout = {};
+    packedLayout.attributes.push_back({ 0, 3, 0, GL_SHORT, GL_TRUE });
+    packedLayout.attributes.push_back({ 1, 4, 8, GL_INT_2_10_10_10_REV, GL_TRUE });
+    packedLayout.stride = 12;
+    if (sourceOffsets[2] >= 0)
+    {
+        packedLayout.attributes.push_back({ 2, 2, packedLayout.stride, GL_UNSIGNED_SHORT, GL_TRUE });
+        packedLayout.stride += 4;
+    }
+    if (sourceOffsets[3] >= 0 && sourceOffsets[4] >= 0)
+    {
+        packedLayout.attributes.push_back({ 3, 4, packedLayout.stride, GL_INT_2_10_10_10_REV, GL_TRUE });
+        packedLayout.stride += 4;
+    }
+
+    // A uniform scale keeps the positions isotropic, 16 bits over the
+    // largest extent are still far below a pixel at any sensible distance
+    const glm::vec3 center = (submesh.aabb.min + submesh.aabb.max) * 0.5f;
+    const glm::vec3 halfExtent = (submesh.aabb.max - submesh.aabb.min) * 0.5f;
+    const f32 positionScale = glm::max(glm::max(halfExtent.x, halfExtent.y), glm::max(halfExtent.z, FLT_MIN));
+
+    // UVs may tile past [0, 1], so they are stored relative to their own range
+    glm::vec2 uvMin(0.0f);
+    glm::vec2 uvMax(1.0f);
+    if (sourceOffsets[2] >= 0 && vertexCount > 0)
+    {
+        uvMin = glm::vec2(FLT_MAX);
+        uvMax = glm::vec2(-FLT_MAX);
+        for (u32 v = 0; v < vertexCount; ++v)
+        {
+            const glm::vec2 uv = glm::make_vec2(&submesh.vertices[v * floatStride + sourceOffsets[2]]);
+            uvMin = glm::min(uvMin, uv);
+            uvMax = glm::max(uvMax, uv);
+        }
+    }
+    const glm::vec2 uvScale = glm::max(uvMax - uvMin, glm::vec2(FLT_MIN));
+
+    dequantization.position = glm::vec4(center, positionScale);
+    dequantization.texCoord = glm::vec4(uvMin, uvScale);
+
+    std::vector<u8> packed(vertexCount * packedLayout.stride);
+    for (u32 v = 0; v < vertexCount; ++v)
+    {
+        const f32* source = &submesh.vertices[v * floatStride];
+        u8* destination = &packed[v * packedLayout.stride];
+
+        const glm::vec3 position = glm::make_vec3(source + sourceOffsets[0]);
+        const u64 packedPosition = glm::packSnorm4x16(glm::vec4((position - center) / positionScale, 0.0f));
+        memcpy(destination, &packedPosition, sizeof(packedPosition));
+
+        const glm::vec3 normal = glm::make_vec3(source + sourceOffsets[1]);
+        const u32 packedNormal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+        memcpy(destination + 8, &packedNormal, sizeof(packedNormal));
+
+        u32 offset = 12;
+        if (sourceOffsets[2] >= 0)
+        {
+            const glm::vec2 uv = glm::make_vec2(source + sourceOffsets[2]);
+            const u32 packedUV = glm::packUnorm2x16((uv - uvMin) / uvScale);
+            memcpy(destination + offset, &packedUV, sizeof(packedUV));
+            offset += 4;
+        }
+        if (sourceOffsets[3] >= 0 && sourceOffsets[4] >= 0)
+        {
+            const glm::vec3 tangent = glm::make_vec3(source + sourceOffsets[3]);
+            const glm::vec3 bitangent = glm::make_vec3(source + sourceOffsets[4]);
+            const f32 handedness = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+            const u32 packedTangent = glm::packSnorm3x10_1x2(glm::vec4(tangent, handedness));
+            memcpy(destination + offset, &packedTangent, sizeof(packedTangent));
+        }
+    }
+    return packed;
+}
+
+// --- Geometry arenas --- //
+
+static bool SameVertexLayout(const VertexBufferLayout& a, const VertexBufferLayout& b)
+{
+    if (a.stride != b.stride || a.attributes.size() != b.attributes.size())
+    {
+        return false;
+    }
+    for (u32 i = 0; i < a.attributes.size(); ++i)
+    {
+        const VertexBufferAttribute& attributeA = a.attributes[i];
+        const VertexBufferAttribute& attributeB = b.attributes[i];
+        if (attributeA.location != attributeB.location || attributeA.componentCount != attributeB.componentCount ||
+            attributeA.offset != attributeB.offset || attributeA.type != attributeB.type || attributeA.normalized != attributeB.normalized)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whole vertices, so the first vertex after them is still an element index
+static u32 GetVertexConstantsCount(u32 stride)
+{
+    return (sizeof(VertexDequantization) + stride - 1) / stride;
+}
+
+static void UpdateSubmeshGeometryOffsets(const GeometryArenas& arenas, Submesh& submesh)
+{
+    const GeometryArena& vertexArena = arenas.vertexArenas[submesh.vertexArena];
+    submesh.baseVertex = submesh.vertexRange.offset + GetVertexConstantsCount(vertexArena.elementSize);
+    submesh.firstIndex = submesh.indexRange.offset;
+}
+
+void UploadSubmeshGeometry(GeometryArenas& arenas, Submesh& submesh, GLenum indexType, u32 indexSize,
+                           const std::vector<u8>& gpuVertices, const VertexDequantization& dequantization)
+{
+    const u32 stride = submesh.gpuVertexLayout.stride;
+    const u32 constantsCount = GetVertexConstantsCount(stride);
+    const u32 vertexCount = constantsCount + gpuVertices.size() / stride;
+
+    // Simplified LODs right behind the full index set
+    std::vector<u32> indices = submesh.indices;
+    indices.insert(indices.end(), submesh.lodIndices.begin(), submesh.lodIndices.end());
+
+    submesh.vertexFormat = UINT32_MAX;
+    for (u32 i = 0; i < arenas.vertexFormats.size() && submesh.vertexFormat == UINT32_MAX; ++i)
+    {
+        if (SameVertexLayout(arenas.vertexFormats[i], submesh.gpuVertexLayout))
+        {
+            submesh.vertexFormat = i;
+        }
+    }
+    if (submesh.vertexFormat == UINT32_MAX)
+    {
+        arenas.vertexFormats.push_back(submesh.gpuVertexLayout);
+        submesh.vertexFormat = arenas.vertexFormats.size() - 1;
+    }
+    submesh.vertexConstants = dequantization;
+
+    submesh.vertexArena = UINT32_MAX;
+    for (u32 i = 0; i < arenas.vertexArenas.size() && submesh.vertexArena == UINT32_MAX; ++i)
+    {
+        if (arenas.vertexArenaFormats[i] == submesh.vertexFormat &&
+            AllocateRange(arenas.vertexArenas[i].allocator, vertexCount, submesh.vertexRange))
+        {
+            submesh.vertexArena = i;
+        }
+    }
+    if (submesh.vertexArena == UINT32_MAX)
+    {
+        arenas.vertexArenas.push_back(CreateGeometryArena(stride, glm::max((u32)GEOMETRY_ARENA_SIZE / stride, vertexCount)));
+        arenas.vertexArenaFormats.push_back(submesh.vertexFormat);
+        submesh.vertexArena = arenas.vertexArenas.size() - 1;
+        AllocateRange(arenas.vertexArenas.back().allocator, vertexCount, submesh.vertexRange);
+    }
+
+    submesh.indexArena = UINT32_MAX;
+    for (u32 i = 0; i < arenas.indexArenas.size() && submesh.indexArena == UINT32_MAX; ++i)
+    {
+        if (arenas.indexArenaTypes[i] == indexType && AllocateRange(arenas.indexArenas[i].allocator, indices.size(), submesh.indexRange))
+        {
+            submesh.indexArena = i;
+        }
+    }
+    if (submesh.indexArena == UINT32_MAX)
+    {
+        arenas.indexArenas.push_back(CreateGeometryArena(indexSize, glm::max((u32)GEOMETRY_ARENA_SIZE / indexSize, (u32)indices.size())));
+        arenas.indexArenaTypes.push_back(indexType);
+        submesh.indexArena = arenas.indexArenas.size() - 1;
+        AllocateRange(arenas.indexArenas.back().allocator, indices.size(), submesh.indexRange);
+    }
+
+    const GeometryArena& vertexArena = arenas.vertexArenas[submesh.vertexArena];
+    UploadArenaRange(vertexArena, submesh.vertexRange, 0, &dequantization, sizeof(dequantization));
+    UploadArenaRange(vertexArena, submesh.vertexRange, constantsCount, gpuVertices.data(), gpuVertices.size());
+
+    const GeometryArena& indexArena = arenas.indexArenas[submesh.indexArena];
+    if (indexType == GL_UNSIGNED_SHORT)
+    {
+        std::vector<u16> shortIndices(indices.begin(), indices.end());
+        UploadArenaRange(indexArena, submesh.indexRange, 0, shortIndices.data(), shortIndices.size() * sizeof(u16));
+    }
+    else
+    {
+        UploadArenaRange(indexArena, submesh.indexRange, 0, indices.data(), indices.size() * sizeof(u32));
+    }
+
+    UpdateSubmeshGeometryOffsets(arenas, submesh);
+}
+
+void UnloadMeshGeometry(GeometryArenas& arenas, Mesh& mesh)
+{
+    for (auto& submesh : mesh.submeshes)
+    {
+        // Empty ranges mark the submesh as unloaded, freeing them is a no-op
+        FreeRange(arenas.vertexArenas[submesh.vertexArena].allocator, submesh.vertexRange);
+        FreeRange(arenas.indexArenas[submesh.indexArena].allocator, submesh.indexRange);
+        submesh.vertexRange = {};
+        submesh.indexRange = {};
+    }
+}
+
+u32 DefragmentGeometry(GeometryArenas& arenas, std::vector<Mesh>& meshes)
+{
+    std::vector<std::vector<ArenaRange*>> vertexRanges(arenas.vertexArenas.size());
+    std::vector<std::vector<ArenaRange*>> indexRanges(arenas.indexArenas.size());
+    for (auto& mesh : meshes)
+    {
+        for (auto& submesh : mesh.submeshes)
+        {
+            if (submesh.vertexRange.count > 0)
+            {
+                vertexRanges[submesh.vertexArena].push_back(&submesh.vertexRange);
+                indexRanges[submesh.indexArena].push_back(&submesh.indexRange);
+            }
+        }
+    }
+
+    for (u32 i = 0; i < arenas.vertexArenas.size(); ++i)
+    {
+        DefragmentGeometryArena(arenas.vertexArenas[i], vertexRanges[i]);
+    }
+    for (u32 i = 0; i < arenas.indexArenas.size(); ++i)
+    {
+        DefragmentGeometryArena(arenas.indexArenas[i], indexRanges[i]);
+    }
+
+    // The buffers stay the same, so the VAOs are still valid
+    u32 movedCount = 0;
+    for (auto& mesh : meshes)
+    {
+        for (auto& submesh : mesh.submeshes)
+        {
+            if (submesh.vertexRange.count == 0)
+            {
+                continue;
+            }
+
+            const u32 baseVertex = submesh.baseVertex;
+            const u32 firstIndex = submesh.firstIndex;
+            UpdateSubmeshGeometryOffsets(arenas, submesh);
+            if (submesh.baseVertex != baseVertex || submesh.firstIndex != firstIndex)
+            {
+                movedCount++;
+            }
+        }
+    }
+
+    return movedCount;
+}
+
+// --- LOD cache --- //
+// Header, then per submesh: vertex float count and index count to check the
+// import still matches, the LOD table and the simplified indices
+
+#define LOD_CACHE_MAGIC 0x53444F4C // "LODS"
+#define LOD_CACHE_VERSION 2 // 2: vertices reordered by OptimizeVertexFetch before the simplification
+
+struct LodCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u64 sourceTimestamp;
+    u32 submeshCount;
+    u32 lodCount;
+};
+
+static std::string MakeLodCachePath(const char* filename)
+{
+    return std::string(filename) + ".lods";
+}
+
+bool LoadLodCache(Mesh& mesh, const char* filename)
+{
+    const std::string cachePath = MakeLodCachePath(filename);
+    FILE* file = fopen(cachePath.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    LodCacheHeader header = {};
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                 header.magic == LOD_CACHE_MAGIC &&
+                 header.version == LOD_CACHE_VERSION &&
+                 header.sourceTimestamp == GetFileLastWriteTimestamp(filename) &&
+                 header.submeshCount == mesh.submeshes.size() &&
+                 header.lodCount == MESH_LOD_COUNT;
+
+    for (u32 i = 0; i < mesh.submeshes.size() && valid; ++i)
+    {
+        Submesh& submesh = mesh.submeshes[i];
+
+        u32 counts[3] = {};
+        valid = fread(counts, sizeof(counts), 1, file) == 1 &&
+                counts[0] == submesh.vertices.size() &&
+                counts[1] == submesh.indices.size();
+        if (valid)
+        {
+            submesh.lodIndices.resize(counts[2]);
+            valid = fread(submesh.lods, sizeof(submesh.lods), 1, file) == 1 &&
+                    fread(submesh.lodIndices.data(), sizeof(u32), counts[2], file) == counts[2];
+        }
+    }
+    fclose(file);
+
+    if (!valid)
+    {
+        ELOG("LOD cache %s is out of date, regenerating", cachePath.c_str());
+    }
+    return valid;
+}
+
+void SaveLodCache(const Mesh& mesh, const char* filename)
+{
+    const std::string cachePath = MakeLodCachePath(filename);
+    FILE* file = fopen(cachePath.c_str(), "wb");
+    if (!file)
+    {
+        ELOG("fopen() failed writing LOD cache %s", cachePath.c_str());
+        return;
+    }
+
+    LodCacheHeader header = {};
+    header.magic = LOD_CACHE_MAGIC;
+    header.version = LOD_CACHE_VERSION;
+    header.sourceTimestamp = GetFileLastWriteTimestamp(filename);
+    header.submeshCount = mesh.submeshes.size();
+    header.lodCount = MESH_LOD_COUNT;
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (const auto& submesh : mesh.submeshes)
+    {
+        const u32 counts[3] = { (u32)submesh.vertices.size(), (u32)submesh.indices.size(), (u32)submesh.lodIndices.size() };
+        fwrite(counts, sizeof(counts), 1, file);
+        fwrite(submesh.lods, sizeof(submesh.lods), 1, file);
+        fwrite(submesh.lodIndices.data(), sizeof(u32), submesh.lodIndices.size(), file);
+    }
+    fclose(file);
+}
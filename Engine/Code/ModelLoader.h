@@ -2,6 +2,10 @@
 #define MODEL_LOADER_H
 
 #include "platform.h"
+#include "Culling.h"
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "GeometryArena.h"
 
 #include <glad/glad.h>
 
@@ -17,6 +21,8 @@ struct VertexBufferAttribute {
     u8 location;
     u8 componentCount;
     u8 offset;
+    GLenum type = GL_FLOAT;
+    GLboolean normalized = GL_FALSE;
 };
 
 struct VertexBufferLayout {
@@ -24,10 +30,31 @@ struct VertexBufferLayout {
     u8 stride;
 };
 
-struct Vao
+// Per submesh constants every vertex of it reads, so one set of shaders
+// serves float and packed vertices:
+//   position = aPositionDequantize.xyz + aPosition * aPositionDequantize.w
+//   texCoord = aTexCoordDequantize.xy + aTexCoord * aTexCoordDequantize.zw
+// Meshes kept as floats get the identity. Single draws set them as generic
+// attribute values (see SetVertexConstants). They are also stored at the
+// start of the vertex range of the submesh, right before its first vertex,
+// where the multi-draw shaders find them through the base vertex.
+#define VERTEX_POSITION_DEQUANTIZE_LOCATION 5
+#define VERTEX_TEXCOORD_DEQUANTIZE_LOCATION 6
+
+struct VertexDequantization
+{
+    glm::vec4 position;     // Offset, uniform scale
+    glm::vec4 texCoord;     // Offset, scale
+};
+
+// Full detail plus three simplified levels, each about half of the one before
+#define MESH_LOD_COUNT 4
+
+struct SubmeshLod
 {
-    GLuint handle;
-    GLuint programHandle;
+    u32 firstIndex;     // Relative to the first index of the submesh
+    u32 indexCount;
+    f32 error;          // Object space distance the surface may have moved by
 };
 
 struct Model
@@ -37,19 +64,61 @@ struct Model
 };
 
 struct Submesh {
+    // Full precision vertices, the bounds, LODs and meshlets are built from them
     VertexBufferLayout vertexBufferLayout;
     std::vector<float> vertices;
     std::vector<u32> indices;
-    u32 vertexOffset;
-    u32 indexOffset;
 
-    std::vector<Vao> vaos;
+    // What the vertex arena holds: the float layout above or the one of
+    // PackVertices, interned in GeometryArenas::vertexFormats
+    VertexBufferLayout gpuVertexLayout;
+    u32 vertexFormat;
+    VertexDequantization vertexConstants;
+
+    // Ranges of the geometry arenas, see GeometryArenas. The vertex range
+    // starts with the VertexDequantization, the vertices follow it.
+    u32 vertexArena;
+    u32 indexArena;
+    ArenaRange vertexRange;
+    ArenaRange indexRange;
+    u32 baseVertex;                 // First vertex in the vertex arena
+    u32 firstIndex;                 // First index in the index arena, the LODs are relative to it
+
+    // Object space bounds, computed at load time
+    AABB aabb;
+    BoundingSphere boundingSphere;
+
+    // LOD chain, lods[0] is the full index set. The simplified sets live in
+    // lodIndices and follow the full one in the index range. A level
+    // that could not be simplified any further repeats the previous one.
+    std::vector<u32> lodIndices;
+    SubmeshLod lods[MESH_LOD_COUNT];
+
+    // Meshlets of every LOD, each LOD's triangles reordered so its meshlets
+    // are contiguous ranges. Levels sharing indices share meshlets too.
+    std::vector<Meshlet> meshlets;
+    u32 lodFirstMeshlet[MESH_LOD_COUNT];
+    u32 lodMeshletCount[MESH_LOD_COUNT];
 };
 
 struct Mesh {
     std::vector<Submesh> submeshes;
-    GLuint vertexBufferHandle;
-    GLuint indexBufferHandle;
+    BoundingSphere boundingSphere;      // Whole mesh, object space
+    f32 lodErrors[MESH_LOD_COUNT];      // Largest submesh error of every LOD
+    GLenum indexType;                   // GL_UNSIGNED_SHORT when every submesh has at most 65536 vertices
+    u32 indexSize;                      // Bytes per index
+};
+
+// Static geometry of every mesh. Vertices go to an arena of their exact
+// layout and indices to one of their type, a new arena is only opened when
+// none of the matching ones has a free block large enough.
+struct GeometryArenas
+{
+    std::vector<VertexBufferLayout> vertexFormats;          // Every distinct GPU vertex layout
+    std::vector<GeometryArena> vertexArenas;
+    std::vector<u32> vertexArenaFormats;                    // Of every vertex arena
+    std::vector<GeometryArena> indexArenas;
+    std::vector<GLenum> indexArenaTypes;                    // Of every index arena
 };
 
 struct Material {
@@ -70,6 +139,42 @@ void ProcessAssimpMaterial(App* app, aiMaterial* material, Material& myMaterial,
 void ProcessAssimpNode(const aiScene* scene, aiNode* node, Mesh* myMesh, u32 baseMeshMaterialIndex, std::vector<u32>& submeshMaterialIndices);
 u32 LoadModel(App* app, const char* filename);
 
+// Cache, overdraw and fetch ordering of the full detail submeshes. Runs
+// before the LODs and meshlets are built, which keep the vertex order and
+// re-optimise the triangles within every meshlet.
+void OptimizeMesh(Mesh& mesh);
+VertexCacheStats AnalyzeMeshVertexCache(const Mesh& mesh);
+
+// Simplified LODs of every submesh, read from <filename>.lods when that cache
+// is up to date with the model file and regenerated (and saved) otherwise
+void GenerateMeshLods(Mesh& mesh);
+bool LoadLodCache(Mesh& mesh, const char* filename);
+void SaveLodCache(const Mesh& mesh, const char* filename);
+
+// Rebuilt on every load, it is cheap next to the simplification
+void GenerateMeshlets(Mesh& mesh);
+
+// Compressed copy of the submesh vertices for the GPU:
+//   position   4x snorm16, relative to the submesh bounds (8 bytes)
+//   normal     snorm 10:10:10:2 (4 bytes)
+//   texCoord   2x unorm16, relative to the submesh UV range (4 bytes)
+//   tangent    snorm 10:10:10:2, bitangent sign in w (4 bytes);
+//              bitangent = cross(normal, tangent.xyz) * tangent.w
+std::vector<u8> PackVertices(const Submesh& submesh, VertexBufferLayout& packedLayout, VertexDequantization& dequantization);
+
+// Sub-allocates the submesh ranges and uploads the vertices (with their
+// dequantization constants) and the indices followed by the LOD indices
+void UploadSubmeshGeometry(GeometryArenas& arenas, Submesh& submesh, GLenum indexType, u32 indexSize,
+                           const std::vector<u8>& gpuVertices, const VertexDequantization& dequantization);
+
+// Returns the ranges of the mesh to the arenas
+void UnloadMeshGeometry(GeometryArenas& arenas, Mesh& mesh);
+
+// Closes the gaps left by unloaded meshes. Moved submeshes get their offsets
+// updated, anything that cached baseVertex or firstIndex has to be rebuilt.
+// Returns the submeshes moved.
+u32 DefragmentGeometry(GeometryArenas& arenas, std::vector<Mesh>& meshes);
+
 // Funciones auxiliares
 String MakeString(const char* str);
 String GetDirectoryPart(String path);
@@ -0,0 +1,114 @@
+#include "RenderQueue.h"
+
+#define SORT_KEY_MASK(bits) ((1ull << (bits)) - 1ull)
+
+// Asserts are compiled out of release builds: there an out of range field is
+// clamped, so it can't spill into the fields above, and logged once
+static u64 ClampSortKeyField(u32 value, u32 bits, const char* field)
+{
+    const u64 mask = SORT_KEY_MASK(bits);
+    if (value <= mask)
+    {
+        return value;
+    }
+
+    ASSERT(false, "Sort key field overflow");
+    static bool overflowLogged = false;
+    if (!overflowLogged)
+    {
+        ELOG("%s %u does not fit in the %u bits of the sort key, draws will bind the wrong state\n", field, value, bits);
+        overflowLogged = true;
+    }
+    return mask;
+}
+
+u64 MakeSortKey(u32 programIdx, u32 vao, u32 textureIdx, f32 depth)
+{
+    const u64 programField = ClampSortKeyField(programIdx, SORT_KEY_PROGRAM_BITS, "Program index");
+    const u64 vaoField = ClampSortKeyField(vao, SORT_KEY_VAO_BITS, "VAO");
+    const u64 textureField = ClampSortKeyField(textureIdx, SORT_KEY_TEXTURE_BITS, "Texture index");
+
+    const f32 clampedDepth = glm::clamp(depth, 0.0f, 1.0f);
+    const u64 quantizedDepth = (u64)(clampedDepth * (f32)SORT_KEY_MASK(SORT_KEY_DEPTH_BITS));
+
+    return (programField << SORT_KEY_PROGRAM_SHIFT) |
+           (vaoField << SORT_KEY_VAO_SHIFT) |
+           (textureField << SORT_KEY_TEXTURE_SHIFT) |
+           (quantizedDepth << SORT_KEY_DEPTH_SHIFT);
+}
+
+u32 GetSortKeyProgram(u64 key)
+{
+    return (u32)((key >> SORT_KEY_PROGRAM_SHIFT) & SORT_KEY_MASK(SORT_KEY_PROGRAM_BITS));
+}
+
+u32 GetSortKeyVao(u64 key)
+{
+    return (u32)((key >> SORT_KEY_VAO_SHIFT) & SORT_KEY_MASK(SORT_KEY_VAO_BITS));
+}
+
+u32 GetSortKeyTexture(u64 key)
+{
+    return (u32)((key >> SORT_KEY_TEXTURE_SHIFT) & SORT_KEY_MASK(SORT_KEY_TEXTURE_BITS));
+}
+
+void ClearRenderQueue(RenderQueue& queue)
+{
+    queue.items.clear();
+}
+
+void PushRenderItem(RenderQueue& queue, u64 key, u32 entityIdx, u32 submeshIdx)
+{
+    queue.items.push_back({ key, entityIdx, submeshIdx });
+}
+
+void SortRenderQueue(RenderQueue& queue)
+{
+    const u32 count = (u32)queue.items.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    queue.scratch.resize(count);
+
+    RenderQueueItem* src = queue.items.data();
+    RenderQueueItem* dst = queue.scratch.data();
+
+    for (u32 shift = 0; shift < 64; shift += 8)
+    {
+        u32 histogram[256] = {};
+        for (u32 i = 0; i < count; ++i)
+        {
+            histogram[(src[i].key >> shift) & 0xFF]++;
+        }
+
+        // Every key has the same byte, this pass would not move anything
+        if (histogram[(src[0].key >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        u32 offset = 0;
+        for (u32 bucket = 0; bucket < 256; ++bucket)
+        {
+            const u32 bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+
+        RenderQueueItem* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != queue.items.data())
+    {
+        queue.items.swap(queue.scratch);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "platform.h"
+
+#include <vector>
+
+// Sort key layout, from most to least significant bits:
+// | program (8) | vao (16) | texture (16) | depth (24) |
+// Sorting the keys groups draws by state first, then front to back.
+#define SORT_KEY_DEPTH_BITS   24
+#define SORT_KEY_TEXTURE_BITS 16
+#define SORT_KEY_VAO_BITS     16
+#define SORT_KEY_PROGRAM_BITS 8
+
+#define SORT_KEY_DEPTH_SHIFT   0
+#define SORT_KEY_TEXTURE_SHIFT (SORT_KEY_DEPTH_SHIFT + SORT_KEY_DEPTH_BITS)
+#define SORT_KEY_VAO_SHIFT     (SORT_KEY_TEXTURE_SHIFT + SORT_KEY_TEXTURE_BITS)
+#define SORT_KEY_PROGRAM_SHIFT (SORT_KEY_VAO_SHIFT + SORT_KEY_VAO_BITS)
+
+struct RenderQueueItem
+{
+    u64 key;
+    u32 entityIdx;
+    u32 submeshIdx;
+};
+
+struct RenderQueueStats
+{
+    u32 draws;
+    u32 programBinds;
+    u32 vaoBinds;
+    u32 textureBinds;
+    u32 skippedBinds;
+};
+
+struct RenderQueue
+{
+    std::vector<RenderQueueItem> items;
+    std::vector<RenderQueueItem> scratch; // Radix sort ping-pong storage
+    RenderQueueStats stats;
+};
+
+// Depth is expected normalized to [0, 1], 0 being the closest to the camera
+u64 MakeSortKey(u32 programIdx, u32 vao, u32 textureIdx, f32 depth);
+u32 GetSortKeyProgram(u64 key);
+u32 GetSortKeyVao(u64 key);
+u32 GetSortKeyTexture(u64 key);
+
+void ClearRenderQueue(RenderQueue& queue);
+void PushRenderItem(RenderQueue& queue, u64 key, u32 entityIdx, u32 submeshIdx);
+
+// LSD radix sort by key, 8 bits per pass. Passes where every key
+// shares the same byte are skipped.
+void SortRenderQueue(RenderQueue& queue);
+
+#endif // RENDER_QUEUE_H
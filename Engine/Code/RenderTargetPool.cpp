@@ -0,0 +1,118 @@
+#include "RenderTargetPool.h"
+#include "BufferManagement.h"
+
+static bool SameDesc(const RenderTargetDesc& a, const RenderTargetDesc& b)
+{
+    return a.width == b.width && a.height == b.height && a.format == b.format && a.levels == b.levels;
+}
+
+static u32 GetFormatBytes(GLenum format)
+{
+    switch (format)
+    {
+        case GL_RGBA32F: return 16;
+        case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+        case GL_R16F: case GL_RG8: case GL_DEPTH_COMPONENT16: return 2;
+        case GL_R8: return 1;
+        default: return 4;
+    }
+}
+
+void BeginRenderTargetFrame(RenderTargetPool& pool)
+{
+    pool.frame++;
+    pool.stats.allocations = 0;
+    pool.stats.reuses = 0;
+    pool.stats.evictions = 0;
+
+    for (u32 i = 0; i < pool.targets.size();)
+    {
+        const RenderTarget& target = pool.targets[i];
+        if (!target.inUse && pool.frame - target.lastUsedFrame > RENDER_TARGET_IDLE_FRAMES)
+        {
+            glDeleteTextures(1, &target.handle);
+            pool.targets.erase(pool.targets.begin() + i);
+            pool.generation++;
+            pool.stats.evictions++;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+GLuint AcquireRenderTarget(RenderTargetPool& pool, const RenderTargetDesc& desc)
+{
+    for (auto& target : pool.targets)
+    {
+        if (!target.inUse && SameDesc(target.desc, desc))
+        {
+            target.inUse = true;
+            target.lastUsedFrame = pool.frame;
+            pool.stats.reuses++;
+            return target.handle;
+        }
+    }
+
+    RenderTarget target = {};
+    target.desc = desc;
+    target.inUse = true;
+    target.lastUsedFrame = pool.frame;
+
+    glGenTextures(1, &target.handle);
+    glBindTexture(GL_TEXTURE_2D, target.handle);
+    glTexStorage2D(GL_TEXTURE_2D, desc.levels, desc.format, desc.width, desc.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.levels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    pool.targets.push_back(target);
+    pool.stats.allocations++;
+    pool.stats.totalAllocations++;
+    return target.handle;
+}
+
+void ReleaseRenderTarget(RenderTargetPool& pool, GLuint handle)
+{
+    for (auto& target : pool.targets)
+    {
+        if (target.handle == handle)
+        {
+            ASSERT(target.inUse, "Render target released twice");
+            target.inUse = false;
+            target.lastUsedFrame = pool.frame;
+            return;
+        }
+    }
+    ASSERT(false, "Render target not from this pool");
+}
+
+u64 GetRenderTargetBytes(const RenderTargetDesc& desc)
+{
+    // A full mip chain adds a third
+    const u64 baseBytes = (u64)desc.width * desc.height * GetFormatBytes(desc.format);
+    return desc.levels > 1 ? baseBytes * 4 / 3 : baseBytes;
+}
+
+u64 GetRenderTargetPoolBytes(const RenderTargetPool& pool)
+{
+    u64 bytes = 0;
+    for (const auto& target : pool.targets)
+    {
+        bytes += GetRenderTargetBytes(target.desc);
+    }
+    return bytes;
+}
+
+void DestroyRenderTargetPool(RenderTargetPool& pool)
+{
+    for (auto& target : pool.targets)
+    {
+        glDeleteTextures(1, &target.handle);
+    }
+    pool.targets.clear();
+    pool.generation++;
+}
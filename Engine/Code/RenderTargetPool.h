@@ -0,0 +1,61 @@
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include "platform.h"
+
+#include <glad/glad.h>
+#include <vector>
+
+// Textures rendered to, shared out by description. A released target stays
+// allocated for a few frames, so a size or format that comes back (a mode
+// switched back, a window dragged back and forth) gets it again instead of
+// a new allocation; targets idle for longer are deleted.
+
+// Frames a released target is kept for
+#define RENDER_TARGET_IDLE_FRAMES 4
+
+struct RenderTargetDesc
+{
+    u32 width;
+    u32 height;
+    GLenum format;  // Sized internal format
+    u32 levels;     // Mip levels, 1 for plain targets
+};
+
+struct RenderTarget
+{
+    RenderTargetDesc desc;
+    GLuint handle;
+    bool inUse;
+    u64 lastUsedFrame;
+};
+
+struct RenderTargetPoolStats
+{
+    u32 allocations;    // This frame
+    u32 reuses;
+    u32 evictions;
+    u64 totalAllocations;
+};
+
+struct RenderTargetPool
+{
+    std::vector<RenderTarget> targets;
+    u64 frame;
+    u32 generation;     // Bumped whenever a texture is deleted, for the framebuffers built on top
+    RenderTargetPoolStats stats;
+};
+
+// Deletes the targets idle for too long and resets the frame stats
+void BeginRenderTargetFrame(RenderTargetPool& pool);
+
+// A free target of the description, allocated when there is none
+GLuint AcquireRenderTarget(RenderTargetPool& pool, const RenderTargetDesc& desc);
+void ReleaseRenderTarget(RenderTargetPool& pool, GLuint handle);
+
+u64 GetRenderTargetBytes(const RenderTargetDesc& desc);
+u64 GetRenderTargetPoolBytes(const RenderTargetPool& pool);
+
+void DestroyRenderTargetPool(RenderTargetPool& pool);
+
+#endif // RENDER_TARGET_POOL_H
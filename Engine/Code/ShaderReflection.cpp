@@ -0,0 +1,104 @@
+#include "ShaderReflection.h"
+
+#include <string.h>
+
+static bool IsSamplerType(GLenum type)
+{
+    switch (type)
+    {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_CUBE_SHADOW: case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_IMAGE_1D: case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_CUBE: case GL_IMAGE_2D_ARRAY:
+        case GL_INT_IMAGE_2D: case GL_UNSIGNED_INT_IMAGE_2D:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Array uniforms and blocks are reported as "name[0]", they are looked up by the plain name
+static u32 HashResourceName(const char* name)
+{
+    u32 length = strlen(name);
+    const char* bracket = strchr(name, '[');
+    if (bracket != nullptr)
+    {
+        length = bracket - name;
+    }
+    return HashShaderName(name, length);
+}
+
+static void AddResource(ShaderReflection& reflection, const char* name, const ShaderResource& resource, const char* programName)
+{
+    if (!reflection.resources.emplace(HashResourceName(name), resource).second)
+    {
+        ELOG("Shader reflection: %s of program %s collides with another name, rename one of them", name, programName);
+    }
+}
+
+void ReflectProgram(GLuint program, ShaderReflection& reflection, const char* programName)
+{
+    reflection.resources.clear();
+
+    char name[256];
+
+    // --- Default block uniforms and samplers --- //
+    GLint uniformCount = 0;
+    glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+    for (GLint i = 0; i < uniformCount; ++i)
+    {
+        const GLenum properties[] = { GL_BLOCK_INDEX, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+        GLint values[ARRAY_COUNT(properties)] = {};
+        glGetProgramResourceiv(program, GL_UNIFORM, i, ARRAY_COUNT(properties), properties, ARRAY_COUNT(values), NULL, values);
+
+        // Members of uniform blocks have no location
+        if (values[0] != -1)
+        {
+            continue;
+        }
+
+        glGetProgramResourceName(program, GL_UNIFORM, i, sizeof(name), NULL, name);
+        const GLenum type = (GLenum)values[2];
+        AddResource(reflection, name, { IsSamplerType(type) ? ShaderResource_Sampler : ShaderResource_Uniform, values[1], type, values[3] }, programName);
+    }
+
+    // --- Uniform and storage blocks --- //
+    const GLenum blockInterfaces[] = { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK };
+    for (GLenum blockInterface : blockInterfaces)
+    {
+        GLint blockCount = 0;
+        glGetProgramInterfaceiv(program, blockInterface, GL_ACTIVE_RESOURCES, &blockCount);
+        for (GLint i = 0; i < blockCount; ++i)
+        {
+            const GLenum property = GL_BUFFER_BINDING;
+            GLint binding = -1;
+            glGetProgramResourceiv(program, blockInterface, i, 1, &property, 1, NULL, &binding);
+
+            glGetProgramResourceName(program, blockInterface, i, sizeof(name), NULL, name);
+            const ShaderResourceKind kind = blockInterface == GL_UNIFORM_BLOCK ? ShaderResource_UniformBlock : ShaderResource_StorageBlock;
+            AddResource(reflection, name, { kind, binding, GL_NONE, 1 }, programName);
+        }
+    }
+}
+
+GLint GetUniformLocation(const ShaderReflection& reflection, u32 id)
+{
+    auto it = reflection.resources.find(id);
+    if (it == reflection.resources.end() || it->second.kind == ShaderResource_UniformBlock || it->second.kind == ShaderResource_StorageBlock)
+    {
+        return -1;
+    }
+    return it->second.location;
+}
+
+GLint GetBlockBinding(const ShaderReflection& reflection, u32 id)
+{
+    auto it = reflection.resources.find(id);
+    if (it == reflection.resources.end() || (it->second.kind != ShaderResource_UniformBlock && it->second.kind != ShaderResource_StorageBlock))
+    {
+        return -1;
+    }
+    return it->second.location;
+}
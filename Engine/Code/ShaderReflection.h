@@ -0,0 +1,60 @@
+#ifndef SHADER_REFLECTION_H
+#define SHADER_REFLECTION_H
+
+#include "platform.h"
+
+#include <glad/glad.h>
+#include <unordered_map>
+
+// Active uniforms, samplers, uniform blocks and storage blocks of a linked
+// program, queried once at link time. Lookups go through the FNV-1a hash of
+// the GLSL name, computed at compile time with ShaderId, so no string ever
+// reaches the driver while rendering.
+
+constexpr u32 HashShaderName(const char* name, u32 length)
+{
+    u32 hash = 2166136261u;
+    for (u32 i = 0; i < length; ++i)
+    {
+        hash = (hash ^ (u8)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+template <u32 N>
+consteval u32 ShaderId(const char (&name)[N])
+{
+    return HashShaderName(name, N - 1);
+}
+
+enum ShaderResourceKind
+{
+    ShaderResource_Uniform,
+    ShaderResource_Sampler,         // Samplers and images, their value is a unit
+    ShaderResource_UniformBlock,
+    ShaderResource_StorageBlock
+};
+
+struct ShaderResource
+{
+    ShaderResourceKind kind;
+    GLint location;     // Uniform location, or binding point of a block
+    GLenum type;        // GL_NONE for blocks
+    GLint arraySize;    // Elements of an array uniform, 1 otherwise
+};
+
+struct ShaderReflection
+{
+    std::unordered_map<u32, ShaderResource> resources;
+};
+
+// Replaces the contents of the reflection with the resources of the program
+void ReflectProgram(GLuint program, ShaderReflection& reflection, const char* programName);
+
+// -1 when the program has no such active uniform, which glUniform* ignores
+GLint GetUniformLocation(const ShaderReflection& reflection, u32 id);
+
+// -1 when the program has no such active block
+GLint GetBlockBinding(const ShaderReflection& reflection, u32 id);
+
+#endif // SHADER_REFLECTION_H
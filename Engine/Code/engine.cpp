@@ -11,20 +11,41 @@
 #include <stb_image_write.h>
 #include "OpenGLErrorGuard.h"
 #include <format>
+#include <chrono>
+#include <float.h>
+#include <algorithm>
+#include <unordered_map>
 #include <imgui_impl_opengl3.h>
 
-void CreateEntity(App* app, u32 modelIndex, u32 textureIndex, glm::vec3 pos, glm::mat4 VP)
+void CreateEntity(App* app, u32 modelIndex, u32 textureIndex, glm::vec3 pos)
 {
-    AlignHead(app->entityUBO, app->uniformBlockAlignment);
-    Entity entity;
-    entity.entityBufferOffset = app->entityUBO.head;
+    // The world matrix reaches the GPU on the next UpdateEntityTransforms
+    Entity entity = {};
     entity.worldMatrix = glm::translate(pos);
     entity.modelIndex = modelIndex;
     entity.textureIndex = textureIndex;
-    PushMat4(app->entityUBO, entity.worldMatrix);
-    PushMat4(app->entityUBO, VP * entity.worldMatrix);
-    entity.entityBufferSize = app->entityUBO.head - entity.entityBufferOffset;
     app->entities.push_back(entity);
+    app->entitiesDirty = true;
+}
+
+void RemoveEntity(App* app, u32 entityIdx)
+{
+    const u32 modelIndex = app->entities[entityIdx].modelIndex;
+    app->entities.erase(app->entities.begin() + entityIdx);
+    app->entitiesDirty = true;
+    app->pickedEntity = -1;
+
+    // The geometry goes with the last entity of the model. The cube and the
+    // sphere stay loaded, the stress test and the light volumes use them.
+    const bool modelInUse = modelIndex == app->cubeIdx || modelIndex == app->sphereIdx ||
+        std::any_of(app->entities.begin(), app->entities.end(), [modelIndex](const Entity& entity) { return entity.modelIndex == modelIndex; });
+    if (!modelInUse)
+    {
+        // Its arena ranges are left as gaps until the next defragmentation
+        UnloadMeshGeometry(app->geometryArenas, app->meshes[app->models[modelIndex].meshIdx]);
+        app->gpuDrawsDirty = true;
+        ILOG("Model %u unloaded", modelIndex);
+    }
 }
 
 void CreateEntities(App* app) 
@@ -38,63 +59,68 @@ void CreateEntities(App* app)
     app->greenTexIdx = LoadTexture2D(app, "Textures/color_green.png");
     app->skyBlueTexIdx = LoadTexture2D(app, "Textures/color_skyblue.png");
 
-    Program& ModelProgram = app->programs[app->texturedMeshProgramIdx];
-
     //app->UpdateLights(app);
 
-    app->textureUniform = glGetUniformLocation(ModelProgram.handle, "uTexture");
-
-      // --- Entities UBO --- //
-    app->entityUBO = CreateConstantBuffer(app->maxUniformBufferSize);
-    MapBuffer(app->entityUBO, GL_WRITE_ONLY);
-    glm::mat4 VP = app->camera.GetProjectionMatrix() * app->camera.GetViewMatrix();
-
     // --- Floor Model --- //
     app->floorIdx = LoadModel(app, "Models/Plane.obj");
-    CreateEntity(app, app->floorIdx, app->whiteTexIdx, glm::vec3(0, 0, 0), VP);
+    CreateEntity(app, app->floorIdx, app->whiteTexIdx, glm::vec3(0, 0, 0));
 
     // --- Cube Model --- //
     app->cubeIdx = LoadModel(app, "Models/Cube.obj");
-    CreateEntity(app, app->cubeIdx, app->normalTexIdx, glm::vec3(-7, 1, 0), VP);
+    CreateEntity(app, app->cubeIdx, app->normalTexIdx, glm::vec3(-7, 1, 0));
 
     // --- Sphere Model --- //
     app->sphereIdx = LoadModel(app, "Models/Sphere.obj");
-    CreateEntity(app, app->sphereIdx, app->greenTexIdx, glm::vec3(-3, 0, 7), VP);
+    CreateEntity(app, app->sphereIdx, app->greenTexIdx, glm::vec3(-3, 0, 7));
 
     // --- Cone Model --- //
     app->coneIdx = LoadModel(app, "Models/Cone.obj");
-    CreateEntity(app, app->coneIdx, app->magentaTexIdx, glm::vec3(7, 0, 0), VP);
+    CreateEntity(app, app->coneIdx, app->magentaTexIdx, glm::vec3(7, 0, 0));
 
     // --- Torus Model --- //
     app->torusIdx = LoadModel(app, "Models/Torus.obj");
-    CreateEntity(app, app->torusIdx, app->skyBlueTexIdx, glm::vec3(0, 0, -10), VP);
+    CreateEntity(app, app->torusIdx, app->skyBlueTexIdx, glm::vec3(0, 0, -10));
 
     // --- Patrick Model --- //
     app->patrickIdx = LoadModel(app, "Patrick/Patrick.obj");
 
-    AlignHead(app->entityUBO, app->uniformBlockAlignment);
-    Entity patrick;
-    patrick.entityBufferOffset = app->entityUBO.head;
-    patrick.worldMatrix = glm::translate(glm::vec3(0, 0, 0));
-    patrick.modelIndex = app->patrickIdx;
-    PushMat4(app->entityUBO, patrick.worldMatrix);
-    PushMat4(app->entityUBO, VP * patrick.worldMatrix);
-    patrick.entityBufferSize = app->entityUBO.head - patrick.entityBufferOffset;
-    app->entities.push_back(patrick);
+    CreateEntity(app, app->patrickIdx, app->whiteTexIdx, glm::vec3(0, 0, 0)); // Patrick submeshes carry their own albedo
 
 
     // --- Repo Model --- //
     glm::vec3 repoPos = glm::vec3(3, 0, 7);
     app->repoBodyIdx = LoadModel(app, "Models/RepoBody.obj");
-    CreateEntity(app, app->repoBodyIdx, app->magentaTexIdx, repoPos, VP);
+    CreateEntity(app, app->repoBodyIdx, app->magentaTexIdx, repoPos);
 
     app->repoEyesIdx = LoadModel(app, "Models/RepoEyes.obj");
-    CreateEntity(app, app->repoEyesIdx, app->whiteTexIdx, repoPos, VP);
+    CreateEntity(app, app->repoEyesIdx, app->whiteTexIdx, repoPos);
 
     app->repoPupilsIdx = LoadModel(app, "Models/RepoPupils.obj");
-    CreateEntity(app, app->repoPupilsIdx, app->blackTexIdx, repoPos, VP);
+    CreateEntity(app, app->repoPupilsIdx, app->blackTexIdx, repoPos);
+}
+
+void CreateEntityStressTest(App* app)
+{
+    // Adds a grid of cubes and spheres on top of the current scene
+    int gridSize = 100;
+    float spacing = 2.5f;
+    float halfSpan = spacing * (gridSize - 1) / 2.0f;
+
+    for (int i = 0; i < gridSize; i++) {
+        for (int j = 0; j < gridSize; j++) {
+            float x = -halfSpan + i * spacing;
+            float z = -halfSpan + j * spacing;
 
-    UnmapBuffer(app->entityUBO);
+            if ((i + j) % 2 == 0)
+            {
+                CreateEntity(app, app->cubeIdx, app->normalTexIdx, glm::vec3(x, 1.0f, z));
+            }
+            else
+            {
+                CreateEntity(app, app->sphereIdx, app->greenTexIdx, glm::vec3(x, 1.0f, z));
+            }
+        }
+    }
 }
 
 void CreateDirectionalLight(App* app, std::string name, vec3 color, vec3 direction, float intensity)
@@ -138,7 +164,7 @@ void CreateDefaultLights(App* app)
     CreatePointLight(app, "Cone Point", vec3(1.0f, 1.0f, 1.0f), vec3(7.0f, 5.0f, 0.0f), 70.0f, 9.0f);
     CreatePointLight(app, "Torus Point", vec3(1.0f, 1.0f, 1.0f), vec3(0.0f, 5.0f, -10.0f), 70.0f, 9.0f);
 
-    app->UpdateLights(app);
+    app->lightsDirty = true;
 }
 
 void CreateLightStressTest(App* app)
@@ -148,7 +174,7 @@ void CreateLightStressTest(App* app)
     CreateDirectionalLight(app, "Directional 1", vec3(0.9f, 0.85f, 0.7f), vec3(-0.5f, 1.0f, 0.2f), 1.2f);
     CreateDirectionalLight(app, "Directional 2", vec3(0.9f, 0.85f, 0.7f), vec3(-0.5f, 1.0f, 0.2f), 1.2f);
 
-    int gridSize = 20;
+    int gridSize = (int)glm::ceil(glm::sqrt((float)app->stressLightCount));
     float totalSpan = 30.0f;          
     float spacing = totalSpan / (gridSize - 1);
     float halfSpan = totalSpan / 2.0f;
@@ -169,8 +195,8 @@ void CreateLightStressTest(App* app)
             );
         }
     }
-    
-    app->UpdateLights(app);
+
+    app->lightsDirty = true;
 }
 
 GLuint CreateProgramFromSource(String programSource, const char* shaderName)
@@ -252,37 +278,233 @@ GLuint CreateProgramFromSource(String programSource, const char* shaderName)
     return programHandle;
 }
 
-u32 LoadProgram(App* app, const char* filepath, const char* programName)
+GLuint CreateComputeProgramFromSource(String programSource, const char* shaderName)
+{
+    GLchar  infoLogBuffer[1024] = {};
+    GLsizei infoLogBufferSize = sizeof(infoLogBuffer);
+    GLsizei infoLogSize;
+    GLint   success;
+
+    char versionString[] = "#version 430\n";
+    char shaderNameDefine[128];
+    sprintf(shaderNameDefine, "#define %s\n", shaderName);
+    char computeShaderDefine[] = "#define COMPUTE\n";
+
+    const GLchar* computeShaderSource[] = {
+        versionString,
+        shaderNameDefine,
+        computeShaderDefine,
+        programSource.str
+    };
+    const GLint computeShaderLengths[] = {
+        (GLint) strlen(versionString),
+        (GLint) strlen(shaderNameDefine),
+        (GLint) strlen(computeShaderDefine),
+        (GLint) programSource.len
+    };
+
+    GLuint cshader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(cshader, ARRAY_COUNT(computeShaderSource), computeShaderSource, computeShaderLengths);
+    glCompileShader(cshader);
+    glGetShaderiv(cshader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(cshader, infoLogBufferSize, &infoLogSize, infoLogBuffer);
+        ELOG("glCompileShader() failed with compute shader %s\nReported message:\n%s\n", shaderName, infoLogBuffer);
+    }
+
+    GLuint programHandle = glCreateProgram();
+    glAttachShader(programHandle, cshader);
+    glLinkProgram(programHandle);
+    glGetProgramiv(programHandle, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(programHandle, infoLogBufferSize, &infoLogSize, infoLogBuffer);
+        ELOG("glLinkProgram() failed with program %s\nReported message:\n%s\n", shaderName, infoLogBuffer);
+    }
+
+    glUseProgram(0);
+
+    glDetachShader(programHandle, cshader);
+    glDeleteShader(cshader);
+
+    return programHandle;
+}
+
+// Vertex inputs of the program, interned so programs with the same inputs share their VAOs
+static void ReflectVertexInputs(App* app, Program& program)
 {
-    String programSource = ReadTextFile(filepath);
+    program.vertexInputLayout.attributes.clear();
 
+    GLint AttributeCount = 0UL;
+    glGetProgramiv(program.handle, GL_ACTIVE_ATTRIBUTES, &AttributeCount);
+
+    for (size_t i = 0; i < AttributeCount; ++i) 
+    {
+        char Name[248];
+        GLsizei realNameSize = 0UL;
+        GLsizei attribSize = 0UL;
+        GLenum attribType;
+
+        glGetActiveAttrib(program.handle, i, ARRAY_COUNT(Name), &realNameSize, &attribSize, &attribType, Name);
+        GLuint attribLocation = glGetAttribLocation(program.handle, Name);
+        program.vertexInputLayout.attributes.push_back({ static_cast <u8>(attribLocation),static_cast <u8>(attribSize) });
+    }
+
+    std::sort(program.vertexInputLayout.attributes.begin(), program.vertexInputLayout.attributes.end(),
+              [](const VertexShaderAttribute& a, const VertexShaderAttribute& b) { return a.location < b.location; });
+
+    VaoCache& vaoCache = app->vaoCache;
+    program.inputLayout = UINT32_MAX;
+    for (u32 i = 0; i < vaoCache.inputLayouts.size() && program.inputLayout == UINT32_MAX; ++i)
+    {
+        const std::vector<VertexShaderAttribute>& attributes = vaoCache.inputLayouts[i].attributes;
+        if (attributes.size() == program.vertexInputLayout.attributes.size() &&
+            std::equal(attributes.begin(), attributes.end(), program.vertexInputLayout.attributes.begin(),
+                       [](const VertexShaderAttribute& a, const VertexShaderAttribute& b) { return a.location == b.location && a.componentCount == b.componentCount; }))
+        {
+            program.inputLayout = i;
+        }
+    }
+    if (program.inputLayout == UINT32_MAX)
+    {
+        vaoCache.inputLayouts.push_back(program.vertexInputLayout);
+        program.inputLayout = vaoCache.inputLayouts.size() - 1;
+    }
+}
+
+// The file with its #include "file" lines replaced by the files they name,
+// looked up next to the including one. GLSL has no includes of its own, so
+// shared functions live in their own file spliced in here; the included
+// paths are collected so editing them reloads the program too.
+std::string ReadShaderSource(const char* filepath, std::vector<std::string>& includes)
+{
+    const String fileText = ReadTextFile(filepath);
+    std::string source(fileText.str ? fileText.str : "", fileText.len);
+
+    const std::string path = filepath;
+    const size_t separator = path.find_last_of("/\\");
+    const std::string directory = separator == std::string::npos ? "" : path.substr(0, separator + 1);
+
+    const char includeDirective[] = "#include \"";
+    size_t position = source.find(includeDirective);
+    while (position != std::string::npos)
+    {
+        const size_t nameStart = position + strlen(includeDirective);
+        const size_t nameEnd = source.find('"', nameStart);
+        const size_t lineEnd = source.find('\n', position);
+        if (nameEnd == std::string::npos || nameEnd > lineEnd)
+        {
+            ELOG("Malformed #include in %s\n", filepath);
+            break;
+        }
+
+        const std::string includePath = directory + source.substr(nameStart, nameEnd - nameStart);
+        std::string includeSource;
+        if (std::find(includes.begin(), includes.end(), includePath) == includes.end())
+        {
+            includes.push_back(includePath);
+            includeSource = ReadShaderSource(includePath.c_str(), includes);
+        }
+
+        source.replace(position, nameEnd + 1 - position, includeSource);
+        position = source.find(includeDirective, position + includeSource.size());
+    }
+
+    return source;
+}
+
+// Newest write time of the program file and of the files it includes
+u64 GetProgramSourceTimestamp(const Program& program)
+{
+    u64 timestamp = GetFileLastWriteTimestamp(program.filepath.c_str());
+    for (const auto& include : program.includes)
+    {
+        timestamp = glm::max(timestamp, GetFileLastWriteTimestamp(include.c_str()));
+    }
+    return timestamp;
+}
+
+u32 LoadComputeProgram(App* app, const char* filepath, const char* programName)
+{
+    Program program = {};
+    const std::string source = ReadShaderSource(filepath, program.includes);
+    const String programSource = { (char*)source.c_str(), (u32)source.size() };
+
+    program.handle = CreateComputeProgramFromSource(programSource, programName);
+    program.filepath = filepath;
+    program.programName = programName;
+    program.lastWriteTimestamp = GetProgramSourceTimestamp(program);
+    program.compute = true;
+    ReflectProgram(program.handle, program.reflection, programName);
+
+    app->programs.push_back(program);
+
+    return app->programs.size() - 1;
+}
+
+u32 LoadProgram(App* app, const char* filepath, const char* programName)
+{
     Program program = {};
+    const std::string source = ReadShaderSource(filepath, program.includes);
+    const String programSource = { (char*)source.c_str(), (u32)source.size() };
+
     program.handle = CreateProgramFromSource(programSource, programName);
     program.filepath = filepath;
     program.programName = programName;
-    program.lastWriteTimestamp = GetFileLastWriteTimestamp(filepath);
+    program.lastWriteTimestamp = GetProgramSourceTimestamp(program);
+    program.compute = false;
 
     if (program.handle != 0) 
     {
-        GLint AttributeCount = 0UL;
-        glGetProgramiv(program.handle, GL_ACTIVE_ATTRIBUTES, &AttributeCount);
+        ReflectVertexInputs(app, program);
+        ReflectProgram(program.handle, program.reflection, programName);
+    }
+
+    app->programs.push_back(program);
+
+    return app->programs.size() - 1;
+}
 
-        for (size_t i = 0; i < AttributeCount; ++i) 
+// Relinks the programs whose source changed on disk. A program that fails to
+// link keeps running the old binary until its source is fixed.
+void ReloadChangedPrograms(App* app)
+{
+    for (Program& program : app->programs)
+    {
+        const u64 timestamp = GetProgramSourceTimestamp(program);
+        if (timestamp <= program.lastWriteTimestamp)
         {
-            char Name[248];
-            GLsizei realNameSize = 0UL;
-            GLsizei attribSize = 0UL;
-            GLenum attribType;
+            continue;
+        }
+        program.lastWriteTimestamp = timestamp;
+
+        program.includes.clear();
+        const std::string source = ReadShaderSource(program.filepath.c_str(), program.includes);
+        const String programSource = { (char*)source.c_str(), (u32)source.size() };
+        const GLuint handle = program.compute ? CreateComputeProgramFromSource(programSource, program.programName.c_str())
+                                              : CreateProgramFromSource(programSource, program.programName.c_str());
 
-            glGetActiveAttrib(program.handle, i, ARRAY_COUNT(Name), &realNameSize, &attribSize, &attribType, Name);
-            GLuint attribLocation = glGetAttribLocation(program.handle, Name);
-            program.vertexInputLayout.attributes.push_back({ static_cast <u8>(attribLocation),static_cast <u8>(attribSize) });
+        GLint linked = GL_FALSE;
+        glGetProgramiv(handle, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            glDeleteProgram(handle);
+            continue;
         }
-    }
 
-    app->programs.push_back(program);
+        glDeleteProgram(program.handle);
+        program.handle = handle;
+        if (!program.compute)
+        {
+            ReflectVertexInputs(app, program);
+        }
+        ReflectProgram(program.handle, program.reflection, program.programName.c_str());
+        ILOG("Reloaded program %s", program.programName.c_str());
 
-    return app->programs.size() - 1;
+        // The GPU driven batches hold VAOs picked by the input layout
+        app->gpuDrawsDirty = true;
+    }
 }
 
 Image LoadImage(const char* filename)
@@ -360,6 +582,21 @@ u32 LoadTexture2D(App* app, const char* filepath)
     }
 }
 
+// Fits the sphere model used for point light volumes to a unit range
+void ComputeLightVolumeBounds(App* app)
+{
+    Model& model = app->models[app->sphereIdx];
+    const AABB& aabb = app->meshes[model.meshIdx].submeshes[0].aabb;
+
+    app->lightVolumeCenter = (aabb.min + aabb.max) * 0.5f;
+    const vec3 extent = aabb.max - aabb.min;
+    const f32 radius = glm::max(glm::max(extent.x, glm::max(extent.y, extent.z)) * 0.5f, 0.0001f);
+
+    // The tessellated faces sit inside the true sphere, grow the volume so it fully contains the range
+    const f32 tessellationMargin = 1.1f;
+    app->lightVolumeScale = tessellationMargin / radius;
+}
+
 void UpdateGBuffer(App* app)
 {
     Program& programTexturedGeometry = app->programs[app->texturedGeometryProgramIdx];
@@ -367,14 +604,14 @@ void UpdateGBuffer(App* app)
 
     if (app->currentGBufferItem == 3)
     {
-        GLfloat nearPlaneProgramLoc = glGetUniformLocation(programTexturedGeometry.handle, "uNear");
+        GLint nearPlaneProgramLoc = GetUniformLocation(programTexturedGeometry.reflection, ShaderId("uNear"));
         glUniform1f(nearPlaneProgramLoc, app->camera.GetNearPlane());
 
-        GLfloat farPlaneProgramLoc = glGetUniformLocation(programTexturedGeometry.handle, "uFar");
+        GLint farPlaneProgramLoc = GetUniformLocation(programTexturedGeometry.reflection, ShaderId("uFar"));
         glUniform1f(farPlaneProgramLoc, app->camera.GetFarPlane());
     }
 
-    GLint gBufferProgramLoc = glGetUniformLocation(programTexturedGeometry.handle, "uGBuffer");
+    GLint gBufferProgramLoc = GetUniformLocation(programTexturedGeometry.reflection, ShaderId("uGBuffer"));
     glUniform1i(gBufferProgramLoc, app->currentGBufferItem);
 
     glUseProgram(0);
@@ -382,251 +619,1840 @@ void UpdateGBuffer(App* app)
 
 void App::UpdateLights(App* app)
 {
-    MapBuffer(app->globalUBO, GL_WRITE_ONLY);
-    PushVec3(app->globalUBO, app->camera.GetPosition());
+    // Reserving always orphans the old storage, so mapping here never waits on the GPU
+    ReserveBuffer(app->lightSSBO, glm::max<u32>(app->lights.size(), 1) * sizeof(GPULight), GL_DYNAMIC_DRAW);
 
-    PushUInt(app->globalUBO, app->lights.size());
-    for (u32 i = 0; i < app->lights.size(); ++i)
+    // Directional lights go first so the passes that only want them can stop early
+    app->directionalLightCount = 0;
+    for (const auto& light : app->lights)
     {
-        AlignHead(app->globalUBO, sizeof(vec4));
+        if (light.type == LightType_Directional)
+        {
+            app->directionalLightCount++;
+        }
+    }
 
-        Light& light = app->lights[i];
-        PushUInt(app->globalUBO, light.type);
-        PushVec3(app->globalUBO, light.color);
-        PushVec3(app->globalUBO, light.direction);
-        PushVec3(app->globalUBO, light.position);
-        PushUInt(app->globalUBO, light.intensity);
-        PushUInt(app->globalUBO, light.range);
+    u32 directionalSlot = 0;
+    u32 pointSlot = app->directionalLightCount;
+
+    MapBuffer(app->lightSSBO, GL_WRITE_ONLY);
+    for (const auto& light : app->lights)
+    {
+        GPULight gpuLight = {};
+        gpuLight.color = light.color;
+        gpuLight.intensity = light.intensity;
+        gpuLight.direction = light.direction;
+        gpuLight.range = light.range;
+        gpuLight.position = light.position;
+        gpuLight.type = light.type;
+
+        const u32 slot = (light.type == LightType_Directional) ? directionalSlot++ : pointSlot++;
+        memcpy(app->lightSSBO.data + slot * sizeof(GPULight), &gpuLight, sizeof(gpuLight));
     }
-    UnmapBuffer(app->globalUBO);
+    UnmapBuffer(app->lightSSBO);
 }
 
 void App::UpdateCameraUniforms(App* app)
 {
-    UpdateLights(app);
-
-    MapBuffer(app->entityUBO, GL_WRITE_ONLY);
     glm::mat4 VP = app->camera.GetProjectionMatrix() * app->camera.GetViewMatrix();
 
-    for (int i = 0; i < app->entities.size(); ++i) 
-    {
-        Entity& entity = app->entities[i];
-
-        glm::mat4 mvp = VP * entity.worldMatrix;
-
-        u32 mvpOffset = entity.entityBufferOffset + sizeof(glm::mat4);
-        WriteData(app->entityUBO, mvpOffset, mvp);
-    }
-    UnmapBuffer(app->entityUBO);
+    PushMat4(app->globalUBO, VP);
+    PushVec3(app->globalUBO, app->camera.GetPosition());
+    PushUInt(app->globalUBO, app->lights.size());
+    PushUInt(app->globalUBO, app->directionalLightCount);
+    PushUInt(app->globalUBO, app->gBufferLayout == GBufferLayout_Compact ? 1 : 0);
+    PushMat4(app->globalUBO, glm::inverse(VP));
+    PushIVec2(app->globalUBO, app->renderSize);
 }
 
-void App::OnResizeWindow(int width, int height)
+void BuildInstanceGroups(App* app)
 {
-    displaySize = vec2 (width, height);
-    //Hacer esto para arreglar aspect ratio
-    camera.SetAspectRatio(this, static_cast<float>(displaySize.x) / static_cast<float>(displaySize.y));
-    primaryFBO.Clean();
-    primaryFBO.CreateFBO(4, displaySize.x, displaySize.y);
-}
+    app->instanceGroups.clear();
 
-void RenderScreenFillQuad(App* app, const FrameBuffer& aFBO)
-{
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glClearColor(0.f, 0.f, 0.f, 0.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Group entities by model, material and LOD, keeping the order in which each group first appears
+    std::unordered_map<u64, u32> groupLookup;
+    std::vector<u32> entityGroup(app->entities.size());
 
-    glViewport(0, 0, app->displaySize.x, app->displaySize.y);
+    for (u32 entityIdx = 0; entityIdx < app->entities.size(); ++entityIdx)
+    {
+        if (app->entityVisibility[entityIdx] != EntityVisibility_Visible)
+        {
+            continue;
+        }
 
-    Program& programTexturedGeometry = app->programs[app->texturedGeometryProgramIdx];
-    glUseProgram(programTexturedGeometry.handle);
+        const Entity& entity = app->entities[entityIdx];
+        const u32 lod = app->entityLods[entityIdx];
+        const u64 groupKey = ((u64)entity.modelIndex << 40) | ((u64)lod << 32) | entity.textureIndex;
 
-    glBindVertexArray(app->vao);
+        auto it = groupLookup.find(groupKey);
+        if (it == groupLookup.end())
+        {
+            it = groupLookup.emplace(groupKey, (u32)app->instanceGroups.size()).first;
+            app->instanceGroups.push_back({ entity.modelIndex, entity.textureIndex, lod, 0, 0 });
+        }
 
-    int iteration = 0;
-    const char* uniformNames[] = { "uColor", "uNormals", "uPosition", "uViewDir" };
+        entityGroup[entityIdx] = it->second;
+        app->instanceGroups[it->second].instanceCount++;
+    }
 
-    for(const auto& texture: aFBO.attachments)
+    u32 firstInstance = 0;
+    for (auto& group : app->instanceGroups)
     {
-        GLuint uniformPosition = glGetUniformLocation(programTexturedGeometry.handle, uniformNames[iteration]);
+        group.firstInstance = firstInstance;
+        firstInstance += group.instanceCount;
+        group.instanceCount = 0;
+    }
 
-        glActiveTexture(GL_TEXTURE0 + iteration);
-        glBindTexture(GL_TEXTURE_2D, texture.second);
-        glUniform1i(uniformPosition, iteration);
+    // Instances only store the index of their entity, transforms come from the entity SSBO
+    std::vector<u32> instanceEntities(firstInstance);
+    for (u32 entityIdx = 0; entityIdx < app->entities.size(); ++entityIdx)
+    {
+        if (app->entityVisibility[entityIdx] != EntityVisibility_Visible)
+        {
+            continue;
+        }
 
-        ++iteration;
+        InstanceGroup& group = app->instanceGroups[entityGroup[entityIdx]];
+        instanceEntities[group.firstInstance + group.instanceCount++] = entityIdx;
     }
-    GLuint uniformPosition = glGetUniformLocation(programTexturedGeometry.handle, "uDepth");
-    glActiveTexture(GL_TEXTURE0 + iteration);
-    glBindTexture(GL_TEXTURE_2D, aFBO.depthHandle);
-    glUniform1i(uniformPosition, iteration);
-
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
 
-    glBindVertexArray(0);
-    glUseProgram(0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->instanceBufferHandle);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instanceEntities.size() * sizeof(u32), instanceEntities.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 }
 
-void Init(App* app)
+void UpdateEntityTransforms(App* app)
 {
-    app->glInfo = GetOpenGLInfo(app->glInfo);
-
-    app->GBufferItems = { "Final Render", "Albedo", "Normals", "Depth", "Position", "View Direction" };
-    app->currentGBufferItem = 0;
-
-    glEnable(GL_DEPTH_TEST);
-
-    // VBO (Vertex)
-    glGenBuffers(1, &app->embeddedVertices);
-    glBindBuffer(GL_ARRAY_BUFFER, app->embeddedVertices);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    // EBO (indices)
-    glGenBuffers(1, &app->embeddedElements);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, app->embeddedElements);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-    // VAO
-    glGenVertexArrays(1, &app->vao);
-    glBindVertexArray(app->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, app->embeddedVertices);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexV3U2), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(VertexV3U2), (void*)12);
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, app->embeddedElements);
-    glBindVertexArray(0);
+    // World matrices are tightly packed and indexed by entity in the shaders.
+    // Reserving always orphans the old storage, so mapping here never waits on the GPU.
+    ReserveBuffer(app->entitySSBO, app->entities.size() * sizeof(glm::mat4), GL_DYNAMIC_DRAW);
 
-    // --------- Programs --------- //
-    app->texturedMeshProgramIdx = LoadProgram(app, "shaders/RENDER_GEOMETRY.glsl", "RENDER_GEOMETRY");   // Render Geometry
-    app->texturedGeometryProgramIdx = LoadProgram(app, "shaders/RENDER_QUAD.glsl", "TEXTURED_GEOMETRY"); // Textured Quad
+    MapBuffer(app->entitySSBO, GL_WRITE_ONLY);
+    for (const auto& entity : app->entities)
+    {
+        PushMat4(app->entitySSBO, entity.worldMatrix);
+    }
+    UnmapBuffer(app->entitySSBO);
+}
 
-    // --- Create Uniforms --- //
-    glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &app->maxUniformBufferSize);
-    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &app->uniformBlockAlignment);
+void UpdateEntityBounds(App* app)
+{
+    // Appended entities get new leaves, a removal shifts the indices and starts the tree over
+    if (app->entityProxies.size() > app->entities.size())
+    {
+        ClearTree(app->entityTree);
+        app->entityProxies.clear();
+    }
 
-    // --- Global (Lights) UBO --- //
-    app->globalUBO = CreateConstantBuffer(app->maxUniformBufferSize);
-    CreateDefaultLights(app);
-    //app->UpdateLights(app);
+    ClearCullingBounds(app->entityBounds);
+    for (u32 entityIdx = 0; entityIdx < app->entities.size(); ++entityIdx)
+    {
+        const Entity& entity = app->entities[entityIdx];
+        Model& model = app->models[entity.modelIndex];
+        Mesh& mesh = app->meshes[model.meshIdx];
 
-    // --- Entities UBO --- //
-    CreateEntities(app);
+        AABB modelAABB = mesh.submeshes[0].aabb;
+        for (u32 i = 1; i < mesh.submeshes.size(); ++i)
+        {
+            modelAABB = MergeAABB(modelAABB, mesh.submeshes[i].aabb);
+        }
 
-    app->mode = Mode_Forward_Geometry;
+        const AABB worldAABB = TransformAABB(modelAABB, entity.worldMatrix);
+        PushCullingBounds(app->entityBounds, worldAABB);
 
-    //app->primaryFBO.CreateFBO(4, app->displaySize.x, app->displaySize.y);
-    app->OnResizeWindow(app->displaySize.x, app->displaySize.y);
+        // Leaves are fattened, so entities that barely moved leave the tree untouched
+        if (entityIdx < app->entityProxies.size())
+        {
+            MoveProxy(app->entityTree, app->entityProxies[entityIdx], worldAABB);
+        }
+        else
+        {
+            app->entityProxies.push_back(CreateProxy(app->entityTree, worldAABB, entityIdx));
+        }
+    }
 }
 
-void Gui(App* app)
+bool GPUDrivenSubmissionActive(App* app)
 {
-    ImGui::DockSpaceOverViewport(NULL, ImGuiDockNodeFlags_PassthruCentralNode);
-
-    InfoWindow(app);
+    return (app->submissionMode == SubmissionMode_GPUDriven || app->submissionMode == SubmissionMode_GPUMeshlets) &&
+           app->mode == Mode_Forward_Geometry && app->supportsDrawParameters;
 }
 
-void Update(App* app)
+bool OcclusionCullingActive(App* app)
 {
-    app->camera.Update(app);
+    // The pyramid is built from the G-buffer depth and the second phase draws indirectly
+    return app->occlusionCulling && app->mode == Mode_Forward_Geometry && app->supportsDrawParameters &&
+           !GPUDrivenSubmissionActive(app);
 }
 
-void Render(App* app)
+void ConsumeDepthPyramidReadback(App* app)
 {
-    switch (app->mode)
+    if (app->hiZReadbackFence == 0)
     {
-        case Mode_TexturedQuad:
-        {
-            glClearColor(0.f, 0.f, 0.f, 0.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return;
+    }
 
-            glViewport(0, 0, app->displaySize.x, app->displaySize.y);
+    // Never wait on the GPU, an older readback is still good enough to test against
+    const GLenum status = glClientWaitSync(app->hiZReadbackFence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+        return;
+    }
+    glDeleteSync(app->hiZReadbackFence);
+    app->hiZReadbackFence = 0;
+
+    DepthPyramidReadback& readback = app->hiZReadback;
+    readback.width = app->hiZPendingWidth;
+    readback.height = app->hiZPendingHeight;
+    readback.viewProjection = app->hiZPendingViewProjection;
+    readback.depth.resize(readback.width * readback.height);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, app->hiZReadbackBuffer);
+    glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, readback.depth.size() * sizeof(f32), readback.depth.data());
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
 
-            Program& programTexturedGeometry = app->programs[app->texturedGeometryProgramIdx];
-            glUseProgram(programTexturedGeometry.handle);
-            glBindVertexArray(app->vao);
+void CullEntities(App* app)
+{
+    // Visibility is decided by the culling shader, nothing to do per entity here
+    if (GPUDrivenSubmissionActive(app))
+    {
+        app->visibleEntityCount = 0;
+        app->occludedEntityCount = 0;
+        app->cullingTime = 0.0;
+        return;
+    }
 
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    auto cullStart = std::chrono::high_resolution_clock::now();
 
-            glUniform1i(app->programUniformTexture, 0);
-            glActiveTexture(GL_TEXTURE0);
-            GLuint textureHandle = app->textures[app->diceTexIdx].handle;
-            glBindTexture(GL_TEXTURE_2D, textureHandle);
+    app->entityVisibility.resize(app->entities.size());
+    if (app->frustumCulling)
+    {
+        const glm::mat4 viewProjection = app->camera.GetProjectionMatrix() * app->camera.GetViewMatrix();
+        app->visibleEntityCount = CullAABBsSIMD(ExtractFrustumPlanes(viewProjection), app->entityBounds, app->entityVisibility.data());
+    }
+    else
+    {
+        std::fill(app->entityVisibility.begin(), app->entityVisibility.end(), EntityVisibility_Visible);
+        app->visibleEntityCount = app->entities.size();
+    }
 
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+    // First occlusion phase: whatever was hidden last frame is left out of the
+    // geometry pass and re-tested on the GPU once this frame's depth exists
+    app->occludedEntityCount = 0;
+    if (OcclusionCullingActive(app))
+    {
+        ConsumeDepthPyramidReadback(app);
 
-            glBindVertexArray(0);
-            glUseProgram(0);
-        }
-        break;
-        case Mode_Forward_Geometry:
+        const CullingBounds& bounds = app->entityBounds;
+        for (u32 entityIdx = 0; entityIdx < app->entities.size(); ++entityIdx)
         {
-            glClearColor(0.f, 0.f, 0.f, 0.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (app->entityVisibility[entityIdx] != EntityVisibility_Visible)
+            {
+                continue;
+            }
+
+            const glm::vec3 center(bounds.centerX[entityIdx], bounds.centerY[entityIdx], bounds.centerZ[entityIdx]);
+            const glm::vec3 extent(bounds.extentX[entityIdx], bounds.extentY[entityIdx], bounds.extentZ[entityIdx]);
+            if (IsOccluded(app->hiZReadback, center, extent))
+            {
+                app->entityVisibility[entityIdx] = EntityVisibility_Occluded;
+                app->occludedEntityCount++;
+            }
+        }
+    }
+    else
+    {
+        // The pyramid is not rebuilt while occlusion culling is off, so what was read back goes stale
+        app->hiZReadback.depth.clear();
+    }
+
+    auto cullEnd = std::chrono::high_resolution_clock::now();
+    app->cullingTime = std::chrono::duration<f64, std::milli>(cullEnd - cullStart).count();
+}
+
+// Pixels covered by one world unit at distance one
+f32 GetLodProjectionScale(App* app)
+{
+    return app->camera.GetProjectionMatrix()[1][1] * 0.5f * app->renderSize.y;
+}
+
+// Coarsest LOD whose simplification error stays under the pixel threshold,
+// measured at the point of the mesh bounding sphere closest to the camera
+void SelectEntityLods(App* app)
+{
+    app->entityLods.resize(app->entities.size());
+    std::fill(std::begin(app->lodHistogram), std::end(app->lodHistogram), 0);
+
+    const glm::vec3 cameraPosition = app->camera.GetPosition();
+    const f32 nearPlane = app->camera.GetNearPlane();
+    const f32 projectionScale = GetLodProjectionScale(app);
+
+    for (u32 entityIdx = 0; entityIdx < app->entities.size(); ++entityIdx)
+    {
+        u8 lod = 0;
+        if (app->lodSelection && app->entityVisibility[entityIdx] != EntityVisibility_Culled)
+        {
+            const Entity& entity = app->entities[entityIdx];
+            const Mesh& mesh = app->meshes[app->models[entity.modelIndex].meshIdx];
+
+            const f32 worldScale = glm::max(glm::length(glm::vec3(entity.worldMatrix[0])), glm::max(glm::length(glm::vec3(entity.worldMatrix[1])), glm::length(glm::vec3(entity.worldMatrix[2]))));
+            const glm::vec3 center = glm::vec3(entity.worldMatrix * glm::vec4(mesh.boundingSphere.center, 1.0f));
+            const f32 distance = glm::max(glm::length(center - cameraPosition) - mesh.boundingSphere.radius * worldScale, nearPlane);
+            const f32 pixelsPerUnit = projectionScale * worldScale / distance;
+
+            while (lod + 1 < MESH_LOD_COUNT && mesh.lodErrors[lod + 1] * pixelsPerUnit <= app->lodErrorThreshold)
+            {
+                lod++;
+            }
+        }
+
+        app->entityLods[entityIdx] = lod;
+        if (app->entityVisibility[entityIdx] != EntityVisibility_Culled)
+        {
+            app->lodHistogram[lod]++;
+        }
+    }
+}
+
+void BeginFrameUniforms(App* app)
+{
+    if (app->entitiesDirty)
+    {
+        UpdateEntityTransforms(app);
+        UpdateEntityBounds(app);
+        app->instanceGroupsDirty = true;
+        app->gpuDrawsDirty = true;
+        app->entitiesDirty = false;
+    }
+
+    if (app->lightsDirty)
+    {
+        app->UpdateLights(app);
+        app->lightsDirty = false;
+    }
+
+    // Each frame writes into its own region of the ring buffer, so the CPU
+    // never touches memory the GPU may still be reading from a previous frame.
+    MapRingBufferRegion(app->globalUBO);
+    app->UpdateCameraUniforms(app);
+    UnmapRingBufferRegion(app->globalUBO);
+
+    app->uniformStallTime = app->globalUBO.stallTime;
+}
+
+void EndFrameUniforms(App* app)
+{
+    FenceRingBufferRegion(app->globalUBO);
+}
+
+// Color attachments of the G-buffer, in fragment output order
+std::vector<GLenum> GetGBufferFormats(GBufferLayout layout)
+{
+    if (layout == GBufferLayout_Compact)
+    {
+        return { GL_RGBA8, GL_RG16 };
+    }
+    return { GL_RGBA16F, GL_RGBA16F, GL_RGBA16F, GL_RGBA16F };
+}
+
+// Written by the geometry pass and read by the lighting, depth/stencil included
+u32 GetGBufferBytesPerPixel(GBufferLayout layout)
+{
+    u32 bytes = 4; // GL_DEPTH24_STENCIL8
+    for (GLenum format : GetGBufferFormats(layout))
+    {
+        bytes += format == GL_RGBA16F ? 8 : 4;
+    }
+    return bytes;
+}
+
+void App::OnResizeWindow(int width, int height)
+{
+    pendingDisplaySize = ivec2(width, height);
+    resizePending = true;
+    resizeRequestCount++;
+}
+
+// A window drag fires the resize callback many times per frame: only the last
+// size is applied, at the start of the frame. With oversizeWhileResizing the
+// transients keep a rounded up size that only grows while the size changes,
+// so the passes just move their viewport, and are fitted once it settles.
+void ApplyPendingResize(App* app)
+{
+    app->framesSinceResize++;
+
+    // A minimized window reports 0x0, keep the targets
+    if (app->resizePending && app->pendingDisplaySize.x > 0 && app->pendingDisplaySize.y > 0)
+    {
+        app->resizePending = false;
+        app->coalescedResizeCount = app->resizeRequestCount;
+        app->resizeRequestCount = 0;
+
+        if (app->pendingDisplaySize != app->displaySize || app->hiZTexture == 0)
+        {
+            // The first resize comes from Init, nothing is changing yet
+            if (app->hiZTexture != 0)
+            {
+                app->framesSinceResize = 0;
+            }
+
+            app->displaySize = app->pendingDisplaySize;
+            //Hacer esto para arreglar aspect ratio
+            app->camera.SetAspectRatio(app, static_cast<float>(app->displaySize.x) / static_cast<float>(app->displaySize.y));
+        }
+    }
+
+    // Running max over the drag, a shrinking window keeps the targets it has
+    if (app->oversizeWhileResizing && app->framesSinceResize < RESIZE_SETTLE_FRAMES)
+    {
+        const ivec2 roundedSize = ((app->displaySize + RESIZE_TARGET_GRANULARITY - 1) / RESIZE_TARGET_GRANULARITY) * RESIZE_TARGET_GRANULARITY;
+        app->renderTargetSize = glm::max(app->renderTargetSize, roundedSize);
+    }
+    else
+    {
+        app->renderTargetSize = app->displaySize;
+    }
+}
+
+// The deferred mode renders at the dynamic resolution scale, the others at
+// the display size. The Hi-Z pyramid follows the render size: the occlusion
+// test maps its UVs over the whole texture.
+void UpdateRenderSize(App* app)
+{
+    const bool scaled = app->mode == Mode_Forward_Geometry;
+    UpdateDynamicResolution(app->dynamicResolution, scaled);
+
+    app->renderSize = app->displaySize;
+    if (scaled)
+    {
+        const ivec2 scaledSize = ivec2(vec2(app->displaySize) * app->dynamicResolution.scale + 0.5f);
+        app->renderSize = glm::clamp(scaledSize, ivec2(1), app->displaySize);
+    }
+
+    if (app->hiZTexture == 0 || app->hiZSize != app->renderSize)
+    {
+        // Down to 1x1. Readbacks already in flight keep their own size.
+        app->hiZSize = app->renderSize;
+        app->hiZLevelCount = (u32)glm::floor(glm::log2((f32)glm::max(app->hiZSize.x, app->hiZSize.y))) + 1;
+        if (app->hiZTexture != 0)
+        {
+            ReleaseRenderTarget(app->renderTargets, app->hiZTexture);
+        }
+        app->hiZTexture = AcquireRenderTarget(app->renderTargets, { (u32)app->hiZSize.x, (u32)app->hiZSize.y, GL_R32F, app->hiZLevelCount });
+    }
+}
+
+// The depth is passed apart: it can't be sampled while it is attached to the
+// target framebuffer, those passes bind a copy of it or nothing at all
+void BindGBufferTextures(App* app, const Program& aProgram, const FrameGraph& aGraph, const GBufferResources& aGBuffer, GLuint aDepthTexture)
+{
+    int iteration = 0;
+    const u32 uniformIds[] = { ShaderId("uColor"), ShaderId("uNormals"), ShaderId("uPosition"), ShaderId("uViewDir") };
+
+    for (u32 i = 0; i < aGBuffer.attachmentCount; ++i)
+    {
+        GLint uniformPosition = GetUniformLocation(aProgram.reflection, uniformIds[iteration]);
+
+        BindTexture(app->glState, iteration, GetTexture(aGraph, aGBuffer.attachments[i]));
+        glUniform1i(uniformPosition, iteration);
+
+        ++iteration;
+    }
+
+    GLint uniformPosition = GetUniformLocation(aProgram.reflection, ShaderId("uDepth"));
+    BindTexture(app->glState, iteration, aDepthTexture);
+    glUniform1i(uniformPosition, iteration);
+}
+
+void RenderScreenFillQuad(App* app, const FrameGraph& aGraph, const GBufferResources& aGBuffer, GLuint aFramebuffer)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, aFramebuffer);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glViewport(0, 0, app->renderSize.x, app->renderSize.y);
+
+    Program& programTexturedGeometry = app->programs[app->texturedGeometryProgramIdx];
+    UseProgram(app->glState, programTexturedGeometry.handle);
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+    BindStorageBuffer(app->glState, 2, app->lightSSBO.handle);
+
+    BindVertexArray(app->glState, app->vao);
+
+    BindGBufferTextures(app, programTexturedGeometry, aGraph, aGBuffer, GetTexture(aGraph, aGBuffer.depth));
+    glUniform1i(GetUniformLocation(programTexturedGeometry.reflection, ShaderId("uDirectionalOnly")), 0);
+
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+}
+
+// Copies the lighting output image to the backbuffer, stretched with
+// bilinear filtering when the frame was rendered below the display size
+void PresentLightingTexture(App* app, FrameGraph& aGraph, FrameGraphResource aLighting)
+{
+    if (app->renderSize == app->displaySize)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, GetFramebuffer(aGraph, &aLighting, 1));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, app->displaySize.x, app->displaySize.y, 0, 0, app->displaySize.x, app->displaySize.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, app->displaySize.x, app->displaySize.y);
+    SetDepthTest(app->glState, false);
+
+    Program& programUpscale = app->programs[app->upscaleProgramIdx];
+    UseProgram(app->glState, programUpscale.handle);
+    BindVertexArray(app->glState, app->vao);
+
+    // The pool targets filter with GL_NEAREST, the sampler overrides it
+    const FrameGraphTextureDesc desc = GetTextureDesc(aGraph, aLighting);
+    BindTexture(app->glState, 0, GetTexture(aGraph, aLighting));
+    glBindSampler(0, app->linearSampler);
+    glUniform1i(GetUniformLocation(programUpscale.reflection, ShaderId("uSource")), 0);
+    glUniform2f(GetUniformLocation(programUpscale.reflection, ShaderId("uSourceScale")), (f32)app->renderSize.x / desc.width, (f32)app->renderSize.y / desc.height);
+
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+
+    glBindSampler(0, 0);
+    SetDepthTest(app->glState, true);
+}
+
+void RenderTiledLighting(App* app, const FrameGraph& aGraph, const GBufferResources& aGBuffer, GLuint aOutput)
+{
+    Program& programTiledLighting = app->programs[app->tiledLightingProgramIdx];
+    UseProgram(app->glState, programTiledLighting.handle);
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+    BindStorageBuffer(app->glState, 2, app->lightSSBO.handle);
+
+    BindGBufferTextures(app, programTiledLighting, aGraph, aGBuffer, GetTexture(aGraph, aGBuffer.depth));
+
+    glm::mat4 inverseProjection = glm::inverse(app->camera.GetProjectionMatrix());
+    glUniformMatrix4fv(GetUniformLocation(programTiledLighting.reflection, ShaderId("uView")), 1, GL_FALSE, glm::value_ptr(app->camera.GetViewMatrix()));
+    glUniformMatrix4fv(GetUniformLocation(programTiledLighting.reflection, ShaderId("uInverseProjection")), 1, GL_FALSE, glm::value_ptr(inverseProjection));
+    glUniform1f(GetUniformLocation(programTiledLighting.reflection, ShaderId("uNear")), app->camera.GetNearPlane());
+    glUniform1f(GetUniformLocation(programTiledLighting.reflection, ShaderId("uFar")), app->camera.GetFarPlane());
+
+    glBindImageTexture(0, aOutput, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+    const u32 tileSize = 16; // Must match TILE_SIZE in the shader
+    glDispatchCompute((app->renderSize.x + tileSize - 1) / tileSize, (app->renderSize.y + tileSize - 1) / tileSize, 1);
+}
+
+// Level 0 of the Hi-Z texture: the G-buffer depth as R32F. Also the copy
+// the light volumes read, see RenderLightVolumes.
+void CopySceneDepth(App* app, GLuint aDepthTexture)
+{
+    const u32 groupSize = 8; // Must match local_size_x/y in the shader
+
+    Program& copyProgram = app->programs[app->hiZCopyProgramIdx];
+    UseProgram(app->glState, copyProgram.handle);
+
+    BindTexture(app->glState, 0, aDepthTexture);
+    glUniform1i(GetUniformLocation(copyProgram.reflection, ShaderId("uDepth")), 0);
+    glBindImageTexture(0, app->hiZTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+    glDispatchCompute((app->hiZSize.x + groupSize - 1) / groupSize, (app->hiZSize.y + groupSize - 1) / groupSize, 1);
+}
+
+// The framebuffer holds the lighting output and the G-buffer depth/stencil,
+// so the volumes are depth and stencil tested against the scene. The depth
+// copy is only needed by the compact layout, see AddLightingPasses.
+void RenderLightVolumes(App* app, const FrameGraph& aGraph, const GBufferResources& aGBuffer, GLuint aFramebuffer, GLuint aDepthCopy)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, aFramebuffer);
+    glViewport(0, 0, app->renderSize.x, app->renderSize.y);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClearStencil(0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+    BindStorageBuffer(app->glState, 2, app->lightSSBO.handle);
+
+    // --- Directional lights, full screen --- //
+    SetDepthTest(app->glState, false);
+    SetDepthWrite(app->glState, false);
+
+    Program& programTexturedGeometry = app->programs[app->texturedGeometryProgramIdx];
+    UseProgram(app->glState, programTexturedGeometry.handle);
+    BindGBufferTextures(app, programTexturedGeometry, aGraph, aGBuffer, aDepthCopy);
+    glUniform1i(GetUniformLocation(programTexturedGeometry.reflection, ShaderId("uDirectionalOnly")), 1);
+
+    BindVertexArray(app->glState, app->vao);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+
+    // --- Point lights, one sphere each --- //
+    const u32 pointLightCount = app->lights.size() - app->directionalLightCount;
+    if (pointLightCount > 0)
+    {
+        Program& programLightVolume = app->programs[app->lightVolumeProgramIdx];
+        UseProgram(app->glState, programLightVolume.handle);
+        BindGBufferTextures(app, programLightVolume, aGraph, aGBuffer, aDepthCopy);
+        glUniform3fv(GetUniformLocation(programLightVolume.reflection, ShaderId("uVolumeCenter")), 1, glm::value_ptr(app->lightVolumeCenter));
+        glUniform1f(GetUniformLocation(programLightVolume.reflection, ShaderId("uVolumeScale")), app->lightVolumeScale);
+
+        Model& model = app->models[app->sphereIdx];
+        Mesh& mesh = app->meshes[model.meshIdx];
+        Submesh& submesh = mesh.submeshes[0];
+        const u32 vaoIdx = FindVAO(app, submesh, programLightVolume);
+        BindVertexArray(app->glState, app->vaoCache.entries[vaoIdx].handle);
+        BindVAOArenas(app, vaoIdx, submesh.vertexArena, submesh.indexArena);
+        SetVertexConstants(submesh);
+
+        SetDepthTest(app->glState, true);
+        glEnable(GL_STENCIL_TEST);
+        SetBlendFunc(app->glState, GL_ONE, GL_ONE);
+
+        // One light at a time, so a light only shades the pixels inside its own
+        // volume. Its lighting pass zeroes the marks it leaves behind.
+        const GLint firstLightLocation = GetUniformLocation(programLightVolume.reflection, ShaderId("uFirstLight"));
+        const GLsizei indexCount = submesh.indices.size();
+        void* indexOffset = (void*)(u64)(submesh.firstIndex * mesh.indexSize);
+        for (u32 light = app->directionalLightCount; light < app->lights.size(); ++light)
+        {
+            glUniform1i(firstLightLocation, light);
+
+            // Stencil pass: count the volume faces behind the scene surface. A pixel
+            // ends non-zero only when the surface sits inside the volume.
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            SetDepthFunc(app->glState, GL_LESS);
+            SetCullFace(app->glState, false);
+            SetBlend(app->glState, false);
+            glStencilFunc(GL_ALWAYS, 0, 0xFF);
+            glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+            glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+            glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, indexOffset, submesh.baseVertex);
+
+            // Lighting pass: back faces behind or at the surface (GL_GEQUAL), restricted to
+            // the marked pixels. Every marked pixel has such a back face, so all marks are cleared.
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            SetDepthFunc(app->glState, GL_GEQUAL);
+            SetCullFace(app->glState, true);
+            SetCullMode(app->glState, GL_FRONT);
+            SetBlend(app->glState, true);
+            glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+            glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, mesh.indexType, indexOffset, submesh.baseVertex);
+        }
+
+        SetBlend(app->glState, false);
+        SetCullMode(app->glState, GL_BACK);
+        SetCullFace(app->glState, false);
+        glDisable(GL_STENCIL_TEST);
+        SetDepthFunc(app->glState, GL_LESS);
+    }
+
+    SetDepthWrite(app->glState, true);
+    SetDepthTest(app->glState, true);
+}
+
+// The query from the previous frame is normally done by now, never wait on it
+void BeginLightingTimer(App* app)
+{
+    GLint timeAvailable = 0;
+    glGetQueryObjectiv(app->lightingTimeQuery, GL_QUERY_RESULT_AVAILABLE, &timeAvailable);
+    if (timeAvailable)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(app->lightingTimeQuery, GL_QUERY_RESULT, &elapsed);
+        app->lightingGpuTime = elapsed / 1000000.0;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, app->lightingTimeQuery);
+}
+
+// Color attachments, plus the depth unless it is attached to the pass target
+void ReadGBuffer(FrameGraph& graph, u32 pass, const GBufferResources& gBuffer, bool depth)
+{
+    for (u32 i = 0; i < gBuffer.attachmentCount; ++i)
+    {
+        ReadTexture(graph, pass, gBuffer.attachments[i], FrameGraphAccess_Sampled);
+    }
+    if (depth)
+    {
+        ReadTexture(graph, pass, gBuffer.depth, FrameGraphAccess_Sampled);
+    }
+}
+
+void AddLightingPasses(App* app, const GBufferResources& gBuffer, FrameGraphResource hiZ, FrameGraphResource backbuffer)
+{
+    FrameGraph& graph = app->frameGraph;
+
+    // Only the final render is lit, the other G-buffer views stay on the quad
+    const bool quad = app->lightingMode == LightingMode_FullscreenQuad || app->currentGBufferItem != 0;
+    const bool upscale = app->renderSize != app->displaySize;
+    if (quad && !upscale)
+    {
+        const u32 pass = AddPass(graph, "DeferredLighting", [app, gBuffer](FrameGraph& graph)
+        {
+            BeginLightingTimer(app);
+            RenderScreenFillQuad(app, graph, gBuffer, 0);
+            glEndQuery(GL_TIME_ELAPSED);
+        });
+        ReadGBuffer(graph, pass, gBuffer, true);
+        WriteTexture(graph, pass, backbuffer, FrameGraphAccess_Attachment, false);
+        return;
+    }
+
+    const FrameGraphTextureDesc depthDesc = GetTextureDesc(graph, gBuffer.depth);
+    FrameGraphResource lighting = CreateTexture(graph, "LightingOutput", { depthDesc.width, depthDesc.height, GL_RGBA16F });
+
+    if (quad)
+    {
+        // Below the display size, the quad too goes through the present pass
+        const u32 pass = AddPass(graph, "DeferredLighting", [app, gBuffer, lighting](FrameGraph& graph)
+        {
+            BeginLightingTimer(app);
+            RenderScreenFillQuad(app, graph, gBuffer, GetFramebuffer(graph, &lighting, 1));
+            glEndQuery(GL_TIME_ELAPSED);
+        });
+        ReadGBuffer(graph, pass, gBuffer, true);
+        lighting = WriteTexture(graph, pass, lighting, FrameGraphAccess_Attachment, false);
+    }
+    else if (app->lightingMode == LightingMode_TiledCompute)
+    {
+        const u32 pass = AddPass(graph, "TiledLighting", [app, gBuffer, lighting](FrameGraph& graph)
+        {
+            BeginLightingTimer(app);
+            RenderTiledLighting(app, graph, gBuffer, GetTexture(graph, lighting));
+            glEndQuery(GL_TIME_ELAPSED);
+        });
+        ReadGBuffer(graph, pass, gBuffer, true);
+        lighting = WriteTexture(graph, pass, lighting, FrameGraphAccess_Image, false);
+    }
+    else
+    {
+        // The compact layout rebuilds positions from depth, which the volumes
+        // have attached for the stencil tests: they read a copy instead
+        const bool depthCopy = app->gBufferLayout == GBufferLayout_Compact;
+        if (depthCopy)
+        {
+            const u32 copyPass = AddPass(graph, "SceneDepthCopy", [app, gBuffer](FrameGraph& graph)
+            {
+                CopySceneDepth(app, GetTexture(graph, gBuffer.depth));
+            });
+            ReadTexture(graph, copyPass, gBuffer.depth, FrameGraphAccess_Sampled);
+            hiZ = WriteTexture(graph, copyPass, hiZ, FrameGraphAccess_Image, false);
+        }
+
+        const u32 pass = AddPass(graph, "LightVolumes", [app, gBuffer, lighting, hiZ, depthCopy](FrameGraph& graph)
+        {
+            const FrameGraphResource targets[] = { lighting, gBuffer.depth };
+            BeginLightingTimer(app);
+            RenderLightVolumes(app, graph, gBuffer, GetFramebuffer(graph, targets, ARRAY_COUNT(targets)), depthCopy ? GetTexture(graph, hiZ) : 0);
+            glEndQuery(GL_TIME_ELAPSED);
+        });
+        ReadGBuffer(graph, pass, gBuffer, false);
+        if (depthCopy)
+        {
+            ReadTexture(graph, pass, hiZ, FrameGraphAccess_Sampled);
+        }
+        lighting = WriteTexture(graph, pass, lighting, FrameGraphAccess_Attachment, false);
+        WriteTexture(graph, pass, gBuffer.depth, FrameGraphAccess_Attachment); // Stencil marks
+    }
+
+    const u32 presentPass = AddPass(graph, "Present", [app, lighting](FrameGraph& graph)
+    {
+        PresentLightingTexture(app, graph, lighting);
+    });
+    ReadTexture(graph, presentPass, lighting, upscale ? FrameGraphAccess_Sampled : FrameGraphAccess_Attachment);
+    WriteTexture(graph, presentPass, backbuffer, FrameGraphAccess_Attachment, false);
+}
+
+bool HasExtension(App* app, const char* extension)
+{
+    return std::find(app->glInfo.extensions.begin(), app->glInfo.extensions.end(), extension) != app->glInfo.extensions.end();
+}
+
+void Init(App* app)
+{
+    app->glInfo = GetOpenGLInfo(app->glInfo);
+
+    app->GBufferItems = { "Final Render", "Albedo", "Normals", "Depth", "Position", "View Direction" };
+    app->GBufferLayoutItems = { "Classic (RGBA16F x4)", "Compact (RGBA8 + RG16)" };
+    app->gBufferLayout = GBufferLayout_Compact;
+    app->currentGBufferItem = 0;
+
+    glEnable(GL_DEPTH_TEST);
+
+    // VBO (Vertex)
+    glGenBuffers(1, &app->embeddedVertices);
+    glBindBuffer(GL_ARRAY_BUFFER, app->embeddedVertices);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // EBO (indices)
+    glGenBuffers(1, &app->embeddedElements);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, app->embeddedElements);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // VAO
+    glGenVertexArrays(1, &app->vao);
+    glBindVertexArray(app->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, app->embeddedVertices);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexV3U2), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(VertexV3U2), (void*)12);
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, app->embeddedElements);
+    glBindVertexArray(0);
+
+    // --------- Programs --------- //
+    app->texturedMeshProgramIdx = LoadProgram(app, "shaders/RENDER_GEOMETRY.glsl", "RENDER_GEOMETRY");   // Render Geometry
+    app->texturedGeometryProgramIdx = LoadProgram(app, "shaders/RENDER_QUAD.glsl", "TEXTURED_GEOMETRY"); // Textured Quad
+
+    // --- Lighting Pass --- //
+    app->LightingModeItems = { "Fullscreen Quad", "Tiled Compute", "Stencil Light Volumes" };
+    app->lightingMode = LightingMode_FullscreenQuad;
+    app->tiledLightingProgramIdx = LoadComputeProgram(app, "shaders/RENDER_QUAD.glsl", "TILED_LIGHTING"); // Tiled Lighting
+    app->lightVolumeProgramIdx = LoadProgram(app, "shaders/RENDER_QUAD.glsl", "LIGHT_VOLUME"); // Point Light Volumes
+    glGenQueries(1, &app->lightingTimeQuery);
+
+    // --- Dynamic Resolution --- //
+    app->upscaleProgramIdx = LoadProgram(app, "shaders/RENDER_QUAD.glsl", "UPSCALE"); // Upscale
+    glGenSamplers(1, &app->linearSampler);
+    glSamplerParameteri(app->linearSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(app->linearSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(app->linearSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(app->linearSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    InitDynamicResolution(app->dynamicResolution);
+
+    // --- Clustered Forward --- //
+    app->clusterLightsProgramIdx = LoadComputeProgram(app, "shaders/CLUSTERED_FORWARD.glsl", "CLUSTER_LIGHTS"); // Cluster Light Assignment
+    app->clusteredForwardProgramIdx = LoadProgram(app, "shaders/CLUSTERED_FORWARD.glsl", "CLUSTERED_FORWARD"); // Clustered Forward
+
+    glGenBuffers(1, &app->clusterLightCountsHandle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->clusterLightCountsHandle);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * sizeof(u32), NULL, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &app->clusterLightIndicesHandle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->clusterLightIndicesHandle);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(u32), NULL, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &app->clusterStatsHandle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->clusterStatsHandle);
+    ClusterStats initialStats = {};
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ClusterStats), &initialStats, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    app->clusterStatsReadback = CreateReadbackBuffer(sizeof(ClusterStats));
+
+    // --- Hi-Z Occlusion Culling --- //
+    app->hiZCopyProgramIdx = LoadComputeProgram(app, "shaders/HIZ.glsl", "HIZ_COPY"); // Depth Pyramid Level 0
+    app->hiZReduceProgramIdx = LoadComputeProgram(app, "shaders/HIZ.glsl", "HIZ_REDUCE"); // Depth Pyramid Downsample
+    app->hiZTestProgramIdx = LoadComputeProgram(app, "shaders/HIZ.glsl", "HIZ_OCCLUSION_TEST"); // Occlusion Test
+    glGenBuffers(1, &app->hiZReadbackBuffer);
+    glGenBuffers(1, &app->occlusionCommandsHandle);
+    glGenBuffers(1, &app->occlusionBoundsHandle);
+
+    glGenBuffers(1, &app->occlusionStatsHandle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->occlusionStatsHandle);
+    u32 initialRecovered = 0;
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(u32), &initialRecovered, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    app->occlusionStatsReadback = CreateReadbackBuffer(sizeof(u32));
+
+    // --- Multi-Draw Indirect --- //
+    app->SubmissionModeItems = { "Draw Loop", "Multi-Draw Indirect", "Instanced", "GPU Driven", "GPU Meshlets" };
+    app->submissionMode = SubmissionMode_Loop;
+    app->supportsDrawParameters = HasExtension(app, "GL_ARB_shader_draw_parameters");
+    if (app->supportsDrawParameters)
+    {
+        app->texturedMeshIndirectProgramIdx = LoadProgram(app, "shaders/RENDER_GEOMETRY.glsl", "RENDER_GEOMETRY_INDIRECT"); // Render Geometry (MDI)
+    }
+    else
+    {
+        ELOG("GL_ARB_shader_draw_parameters not supported, Multi-Draw Indirect submission disabled\n");
+    }
+    glGenBuffers(1, &app->indirectBufferHandle);
+
+    // --- GPU Driven Submission --- //
+    app->cullDrawsProgramIdx = LoadComputeProgram(app, "shaders/GPU_CULLING.glsl", "CULL_DRAWS"); // Draw Culling
+    app->cullMeshletsProgramIdx = LoadComputeProgram(app, "shaders/GPU_CULLING.glsl", "CULL_MESHLETS"); // Meshlet Culling
+    app->glMultiDrawElementsIndirectCountARB = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC)GetGLProcAddress("glMultiDrawElementsIndirectCountARB");
+    app->supportsIndirectCount = HasExtension(app, "GL_ARB_indirect_parameters") && app->glMultiDrawElementsIndirectCountARB != nullptr;
+    if (!app->supportsIndirectCount)
+    {
+        ELOG("GL_ARB_indirect_parameters not supported, GPU driven batches are drawn with their full command range\n");
+    }
+    app->meshletConeCulling = true;
+    app->gpuDrawsDirty = true;
+    app->gpuDrawsMeshlets = false;
+    glGenBuffers(1, &app->gpuDrawTemplatesHandle);
+    glGenBuffers(1, &app->gpuCommandsHandle);
+    glGenBuffers(1, &app->gpuBatchCountsHandle);
+
+    glGenBuffers(1, &app->gpuCullingStatsHandle);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->gpuCullingStatsHandle);
+    u32 initialVisibleDraws = 0;
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(u32), &initialVisibleDraws, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    app->gpuCullingStatsReadback = CreateReadbackBuffer(sizeof(u32));
+
+    // --- Instancing --- //
+    app->texturedMeshInstancedProgramIdx = LoadProgram(app, "shaders/RENDER_GEOMETRY.glsl", "RENDER_GEOMETRY_INSTANCED"); // Render Geometry (Instanced)
+    glGenBuffers(1, &app->instanceBufferHandle);
+
+    // --- Create Uniforms --- //
+    glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &app->maxUniformBufferSize);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &app->uniformBlockAlignment);
+
+    GLint storageBufferAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageBufferAlignment);
+    const u32 regionAlignment = glm::max(app->uniformBlockAlignment, storageBufferAlignment);
+
+    app->supportsBufferStorage = HasExtension(app, "GL_ARB_buffer_storage") && LoadBufferStorage();
+    if (!app->supportsBufferStorage)
+    {
+        ELOG("GL_ARB_buffer_storage not supported, uniform ring buffers fall back to unsynchronized mapping\n");
+    }
+
+    // --- Global UBO --- //
+    app->globalUBO = CreateRingBuffer(KB(1), GL_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT, regionAlignment);
+
+    // --- Lights SSBO --- //
+    app->lightSSBO = CreateBuffer(KB(64), GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW); // Grows with the light count
+    app->stressLightCount = 400;
+    CreateDefaultLights(app);
+
+    // --- Entities SSBO --- //
+    app->entitySSBO = CreateBuffer(KB(64), GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_DRAW); // Grows with the entity count
+    app->compressVertices = true;
+    CreateEntities(app);
+    ComputeLightVolumeBounds(app);
+
+    app->ModeItems = { "Textured Quad", "Deferred", "Clustered Forward" };
+    app->frustumCulling = true;
+    app->occlusionCulling = app->supportsDrawParameters;
+    app->lodSelection = true;
+    app->lodErrorThreshold = 1.0f;
+    app->pickedEntity = -1;
+    app->mode = Mode_Forward_Geometry;
+
+    app->oversizeWhileResizing = true;
+    app->framesSinceResize = RESIZE_SETTLE_FRAMES;
+    app->OnResizeWindow(app->displaySize.x, app->displaySize.y);
+}
+
+void Gui(App* app)
+{
+    ImGui::DockSpaceOverViewport(NULL, ImGuiDockNodeFlags_PassthruCentralNode);
+
+    InfoWindow(app);
+}
+
+// Casts a ray from the camera through the mouse cursor into the entity tree
+void PickEntity(App* app)
+{
+    const vec2 ndc = vec2(2.0f * app->input.mousePos.x / app->displaySize.x - 1.0f, 1.0f - 2.0f * app->input.mousePos.y / app->displaySize.y);
+    const glm::mat4 inverseViewProjection = glm::inverse(app->camera.GetProjectionMatrix() * app->camera.GetViewMatrix());
+
+    vec4 nearPoint = inverseViewProjection * vec4(ndc, -1.0f, 1.0f);
+    vec4 farPoint = inverseViewProjection * vec4(ndc, 1.0f, 1.0f);
+    nearPoint /= nearPoint.w;
+    farPoint /= farPoint.w;
+
+    const vec3 origin = vec3(nearPoint);
+    const vec3 direction = glm::normalize(vec3(farPoint) - origin);
+
+    u32 hitEntity = 0;
+    f32 hitDistance = 0.0f;
+    app->pickedEntity = QueryRay(app->entityTree, origin, direction, app->camera.GetFarPlane(), hitEntity, hitDistance) ? (i32)hitEntity : -1;
+}
+
+void Update(App* app)
+{
+    ReloadChangedPrograms(app);
+
+    app->camera.Update(app);
+
+    // Left click alone picks, left + right is the camera rotation. Clicks on
+    // the GUI windows are theirs.
+    if (app->input.mouseButtons[LEFT] == BUTTON_PRESS && app->input.mouseButtons[RIGHT] == BUTTON_IDLE && !ImGui::GetIO().WantCaptureMouse)
+    {
+        PickEntity(app);
+    }
+}
+
+u32 GetSubmeshTextureIdx(App* app, u32 entityTextureIdx, u32 submeshMaterialIdx)
+{
+    Material& submeshMaterial = app->materials[submeshMaterialIdx];
+
+    if (submeshMaterial.albedoTextureIdx > 0)
+    {
+        return submeshMaterial.albedoTextureIdx;
+    }
+    return entityTextureIdx;
+}
+
+void BuildRenderQueue(App* app, u32 programIdx, EntityVisibility visibility)
+{
+    RenderQueue& queue = app->renderQueue;
+    ClearRenderQueue(queue);
+
+    Program& program = app->programs[programIdx];
+    const glm::vec3 cameraPosition = app->camera.GetPosition();
+    const f32 farPlane = app->camera.GetFarPlane();
+
+    for (u32 entityIdx = 0; entityIdx < app->entities.size(); ++entityIdx)
+    {
+        if (app->entityVisibility[entityIdx] != visibility)
+        {
+            continue;
+        }
+
+        const Entity& entity = app->entities[entityIdx];
+        Model& model = app->models[entity.modelIndex];
+        Mesh& mesh = app->meshes[model.meshIdx];
+
+        const f32 depth = glm::length(glm::vec3(entity.worldMatrix[3]) - cameraPosition) / farPlane;
+
+        for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+        {
+            u32 vao = FindVAO(app, mesh.submeshes[i], program);
+            u32 textureIdx = GetSubmeshTextureIdx(app, entity.textureIndex, model.materialIdx[i]);
+            PushRenderItem(queue, MakeSortKey(programIdx, vao, textureIdx, depth), entityIdx, i);
+        }
+    }
+
+    SortRenderQueue(queue);
+}
+
+void RenderGeometryLoop(App* app, u32 programIdx)
+{
+    BuildRenderQueue(app, programIdx, EntityVisibility_Visible);
+
+    RenderQueueStats& stats = app->renderQueue.stats;
+    stats = {};
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+    BindStorageBuffer(app->glState, 1, app->entitySSBO.handle);
+
+    u64 lastKey = 0;
+    GLint entityIndexUniform = -1;
+    for (const auto& item : app->renderQueue.items)
+    {
+        const bool firstDraw = (stats.draws == 0);
+        const u32 itemProgramIdx = GetSortKeyProgram(item.key);
+        const u32 vao = GetSortKeyVao(item.key);
+        const u32 textureIdx = GetSortKeyTexture(item.key);
+
+        // Only emit the binds whose key field differs from the previous draw
+        if (firstDraw || itemProgramIdx != GetSortKeyProgram(lastKey))
+        {
+            const Program& program = app->programs[itemProgramIdx];
+            UseProgram(app->glState, program.handle);
+            glUniform1i(GetUniformLocation(program.reflection, ShaderId("uTexture")), 0);
+            entityIndexUniform = GetUniformLocation(program.reflection, ShaderId("uEntityIndex"));
+            stats.programBinds++;
+        }
+        if (firstDraw || vao != GetSortKeyVao(lastKey))
+        {
+            BindVertexArray(app->glState, app->vaoCache.entries[vao].handle);
+            stats.vaoBinds++;
+        }
+        if (firstDraw || textureIdx != GetSortKeyTexture(lastKey))
+        {
+            BindTexture(app->glState, 0, app->textures[textureIdx].handle);
+            stats.textureBinds++;
+        }
+        lastKey = item.key;
+        stats.draws++;
+
+        const Entity& entity = app->entities[item.entityIdx];
+        glUniform1ui(entityIndexUniform, item.entityIdx);
+
+        Model& model = app->models[entity.modelIndex];
+        Mesh& mesh = app->meshes[model.meshIdx];
+        Submesh& submesh = mesh.submeshes[item.submeshIdx];
+        const SubmeshLod& lod = submesh.lods[app->entityLods[item.entityIdx]];
+        BindVAOArenas(app, vao, submesh.vertexArena, submesh.indexArena);
+        SetVertexConstants(submesh);
+        glDrawElementsBaseVertex(GL_TRIANGLES, lod.indexCount, mesh.indexType, (void*)(u64)((submesh.firstIndex + lod.firstIndex) * mesh.indexSize), submesh.baseVertex);
+    }
+
+    stats.skippedBinds = stats.draws * 3 - (stats.programBinds + stats.vaoBinds + stats.textureBinds);
+}
+
+// One command per render queue item, batched by VAO and texture
+void BuildIndirectCommands(App* app, std::vector<DrawElementsIndirectCommand>& commands, std::vector<IndirectBatch>& batches)
+{
+    RenderQueueStats& stats = app->renderQueue.stats;
+
+    commands.clear();
+    batches.clear();
+
+    for (const auto& item : app->renderQueue.items)
+    {
+        const u32 vao = GetSortKeyVao(item.key);
+        const GLuint texture = app->textures[GetSortKeyTexture(item.key)].handle;
+
+        const Entity& entity = app->entities[item.entityIdx];
+        Model& model = app->models[entity.modelIndex];
+        Mesh& mesh = app->meshes[model.meshIdx];
+        Submesh& submesh = mesh.submeshes[item.submeshIdx];
+        const SubmeshLod& lod = submesh.lods[app->entityLods[item.entityIdx]];
+
+        // The queue is sorted by state, so a new batch only starts when the VAO or the texture
+        // changes, or when the submesh lives in other arenas than the previous one
+        if (batches.empty() || batches.back().vao != vao || batches.back().texture != texture ||
+            batches.back().vertexArena != submesh.vertexArena || batches.back().indexArena != submesh.indexArena)
+        {
+            batches.push_back({ vao, submesh.vertexArena, submesh.indexArena, texture, (u32)commands.size(), 0 });
+        }
+
+        DrawElementsIndirectCommand command = {};
+        command.count = lod.indexCount;
+        command.instanceCount = 1;
+        command.firstIndex = submesh.firstIndex + lod.firstIndex;
+        command.baseVertex = submesh.baseVertex;
+        command.baseInstance = item.entityIdx;
+        commands.push_back(command);
+
+        batches.back().commandCount++;
+        stats.draws++;
+    }
+}
+
+// Expects the indirect program and the command buffer to be bound. With
+// batchDrawCounts the parameter buffer holds the real draw count of every
+// batch and commandCount is only the upper bound.
+void SubmitIndirectBatches(App* app, const std::vector<IndirectBatch>& batches, bool batchDrawCounts)
+{
+    RenderQueueStats& stats = app->renderQueue.stats;
+
+    const Program& indirectProgram = app->programs[app->texturedMeshIndirectProgramIdx];
+    glUniform1i(GetUniformLocation(indirectProgram.reflection, ShaderId("uTexture")), 0);
+    const GLint vertexStrideUniform = GetUniformLocation(indirectProgram.reflection, ShaderId("uVertexStride"));
+
+    for (u32 i = 0; i < batches.size(); ++i)
+    {
+        const IndirectBatch& batch = batches[i];
+
+        if (i == 0 || batch.vao != batches[i - 1].vao)
+        {
+            BindVertexArray(app->glState, app->vaoCache.entries[batch.vao].handle);
+            stats.vaoBinds++;
+        }
+        BindVAOArenas(app, batch.vao, batch.vertexArena, batch.indexArena);
+
+        // The shader reads the dequantization constants of every draw from the arena
+        const GeometryArena& vertexArena = app->geometryArenas.vertexArenas[batch.vertexArena];
+        if (i == 0 || batch.vertexArena != batches[i - 1].vertexArena)
+        {
+            BindStorageBuffer(app->glState, VERTEX_ARENA_STORAGE_BINDING, vertexArena.handle);
+            glUniform1ui(vertexStrideUniform, vertexArena.elementSize / sizeof(float));
+        }
+        const GLenum indexType = app->geometryArenas.indexArenaTypes[batch.indexArena];
+        if (i == 0 || batch.texture != batches[i - 1].texture)
+        {
+            BindTexture(app->glState, 0, batch.texture);
+            stats.textureBinds++;
+        }
+
+        const u64 commandOffset = batch.firstCommand * sizeof(DrawElementsIndirectCommand);
+        if (batchDrawCounts)
+        {
+            app->glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, indexType, (void*)commandOffset, i * sizeof(u32), batch.commandCount, 0);
+        }
+        else
+        {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)commandOffset, batch.commandCount, 0);
+        }
+    }
+
+    stats.skippedBinds = stats.draws * 3 - (stats.programBinds + stats.vaoBinds + stats.textureBinds);
+}
+
+void RenderGeometryIndirect(App* app)
+{
+    BuildRenderQueue(app, app->texturedMeshIndirectProgramIdx, EntityVisibility_Visible);
+
+    RenderQueueStats& stats = app->renderQueue.stats;
+    stats = {};
+
+    Program& indirectProgram = app->programs[app->texturedMeshIndirectProgramIdx];
+    UseProgram(app->glState, indirectProgram.handle);
+    stats.programBinds++;
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+
+    // The base instance of each command is the entity index into the entity SSBO
+    BindStorageBuffer(app->glState, 1, app->entitySSBO.handle);
+
+    BuildIndirectCommands(app, app->indirectCommands, app->indirectBatches);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, app->indirectBufferHandle);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, app->indirectCommands.size() * sizeof(DrawElementsIndirectCommand), app->indirectCommands.data(), GL_STREAM_DRAW);
+
+    SubmitIndirectBatches(app, app->indirectBatches, false);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Every submesh of every entity, or every meshlet of every LOD of them,
+// grouped into one fixed command range per VAO/texture batch. Only runs when
+// the entity list or the kind of template changes.
+void BuildGPUDrawTemplates(App* app)
+{
+    Program& indirectProgram = app->programs[app->texturedMeshIndirectProgramIdx];
+    app->gpuDrawsMeshlets = app->submissionMode == SubmissionMode_GPUMeshlets;
+
+    // Every field in full, so no VAO or arena count can alias two batches
+    struct BatchKey
+    {
+        u32 vao;
+        u32 vertexArena;
+        u32 indexArena;
+        GLuint texture;
+
+        bool operator==(const BatchKey& other) const
+        {
+            return vao == other.vao && vertexArena == other.vertexArena && indexArena == other.indexArena && texture == other.texture;
+        }
+    };
+    struct BatchKeyHash
+    {
+        size_t operator()(const BatchKey& key) const
+        {
+            return (key.vao * 73856093u) ^ (key.vertexArena * 19349663u) ^ (key.indexArena * 83492791u) ^ (key.texture * 2654435761u);
+        }
+    };
+
+    std::unordered_map<BatchKey, u32, BatchKeyHash> batchLookup;
+    std::vector<GPUDrawTemplate> templates;
+    std::vector<GPUMeshletTemplate> meshletTemplates;
+    app->gpuDrivenBatches.clear();
+
+    for (u32 entityIdx = 0; entityIdx < app->entities.size(); ++entityIdx)
+    {
+        const Entity& entity = app->entities[entityIdx];
+        Model& model = app->models[entity.modelIndex];
+        Mesh& mesh = app->meshes[model.meshIdx];
+
+        for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+        {
+            const Submesh& submesh = mesh.submeshes[i];
+            const u32 vao = FindVAO(app, submesh, indirectProgram);
+            const GLuint texture = app->textures[GetSubmeshTextureIdx(app, entity.textureIndex, model.materialIdx[i])].handle;
+            const BatchKey batchKey = { vao, submesh.vertexArena, submesh.indexArena, texture };
+
+            auto it = batchLookup.find(batchKey);
+            if (it == batchLookup.end())
+            {
+                it = batchLookup.emplace(batchKey, (u32)app->gpuDrivenBatches.size()).first;
+                app->gpuDrivenBatches.push_back({ vao, submesh.vertexArena, submesh.indexArena, texture, 0, 0 });
+            }
+
+            if (app->gpuDrawsMeshlets)
+            {
+                for (u32 lod = 0; lod < MESH_LOD_COUNT; ++lod)
+                {
+                    // LODs that could not be simplified further share the meshlets of the previous one
+                    u32 lastLod = lod;
+                    while (lastLod + 1 < MESH_LOD_COUNT && submesh.lodFirstMeshlet[lastLod + 1] == submesh.lodFirstMeshlet[lod])
+                    {
+                        lastLod++;
+                    }
+
+                    for (u32 m = 0; m < submesh.lodMeshletCount[lod]; ++m)
+                    {
+                        const Meshlet& meshlet = submesh.meshlets[submesh.lodFirstMeshlet[lod] + m];
+
+                        GPUMeshletTemplate draw = {};
+                        draw.sphere = glm::vec4(meshlet.boundingSphere.center, meshlet.boundingSphere.radius);
+                        draw.cone = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+                        draw.coneApex = meshlet.coneApex;
+                        draw.entityIndex = entityIdx;
+                        draw.meshSphere = glm::vec4(mesh.boundingSphere.center, mesh.boundingSphere.radius);
+                        draw.batchIndex = it->second;
+                        draw.firstIndex = submesh.firstIndex + meshlet.firstIndex;
+                        draw.baseVertex = submesh.baseVertex;
+                        draw.indexCount = meshlet.indexCount;
+                        draw.lodMinError = mesh.lodErrors[lod];
+                        draw.lodMaxError = lastLod + 1 < MESH_LOD_COUNT ? mesh.lodErrors[lastLod + 1] : FLT_MAX;
+                        draw.firstLod = lod;
+                        meshletTemplates.push_back(draw);
+                        app->gpuDrivenBatches[it->second].commandCount++;
+                    }
+                    lod = lastLod;
+                }
+                continue;
+            }
+
+            app->gpuDrivenBatches[it->second].commandCount++;
+
+            GPUDrawTemplate draw = {};
+            draw.aabbMin = submesh.aabb.min;
+            draw.aabbMax = submesh.aabb.max;
+            draw.meshSphere = glm::vec4(mesh.boundingSphere.center, mesh.boundingSphere.radius);
+            draw.entityIndex = entityIdx;
+            draw.batchIndex = it->second;
+            draw.baseVertex = submesh.baseVertex;
+            for (u32 lod = 0; lod < MESH_LOD_COUNT; ++lod)
+            {
+                draw.lodIndexCount[lod] = submesh.lods[lod].indexCount;
+                draw.lodFirstIndex[lod] = submesh.firstIndex + submesh.lods[lod].firstIndex;
+                draw.lodError[lod] = mesh.lodErrors[lod];
+            }
+            templates.push_back(draw);
+        }
+    }
+
+    u32 firstCommand = 0;
+    for (auto& batch : app->gpuDrivenBatches)
+    {
+        batch.firstCommand = firstCommand;
+        firstCommand += batch.commandCount;
+    }
+    for (auto& draw : templates)
+    {
+        draw.firstCommand = app->gpuDrivenBatches[draw.batchIndex].firstCommand;
+    }
+    for (auto& draw : meshletTemplates)
+    {
+        draw.firstCommand = app->gpuDrivenBatches[draw.batchIndex].firstCommand;
+    }
+    app->gpuDrawCount = app->gpuDrawsMeshlets ? meshletTemplates.size() : templates.size();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->gpuDrawTemplatesHandle);
+    if (app->gpuDrawsMeshlets)
+    {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, meshletTemplates.size() * sizeof(GPUMeshletTemplate), meshletTemplates.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, templates.size() * sizeof(GPUDrawTemplate), templates.data(), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->gpuCommandsHandle);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, app->gpuDrawCount * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->gpuBatchCountsHandle);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, app->gpuDrivenBatches.size() * sizeof(u32), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// The CPU only clears a few counters, dispatches and issues one draw per
+// batch, so its cost does not grow with the number of entities
+void RenderGeometryGPUDriven(App* app)
+{
+    if (app->gpuDrawsDirty || app->gpuDrawsMeshlets != (app->submissionMode == SubmissionMode_GPUMeshlets))
+    {
+        BuildGPUDrawTemplates(app);
+        app->gpuDrawsDirty = false;
+    }
+
+    RenderQueueStats& stats = app->renderQueue.stats;
+    stats = {};
+
+    // Counter of an earlier dispatch, once its copy has landed
+    ConsumeReadback(app->gpuCullingStatsReadback, &app->gpuVisibleDrawCount);
+
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->gpuCullingStatsHandle);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->gpuBatchCountsHandle);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    // Without a draw count every batch range is drawn whole, so the slots
+    // the shader leaves untouched have to be empty commands
+    if (!app->supportsIndirectCount)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->gpuCommandsHandle);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    if (app->gpuDrawCount == 0)
+    {
+        // The cleared counter, so the readout drops to zero
+        RequestReadback(app->gpuCullingStatsReadback, app->gpuCullingStatsHandle);
+        return;
+    }
+
+    Program& cullProgram = app->programs[app->gpuDrawsMeshlets ? app->cullMeshletsProgramIdx : app->cullDrawsProgramIdx];
+    UseProgram(app->glState, cullProgram.handle);
+
+    const Frustum frustum = ExtractFrustumPlanes(app->camera.GetProjectionMatrix() * app->camera.GetViewMatrix());
+    glUniform4fv(GetUniformLocation(cullProgram.reflection, ShaderId("uFrustumPlanes")), 6, glm::value_ptr(frustum.planes[0]));
+    glUniform1i(GetUniformLocation(cullProgram.reflection, ShaderId("uFrustumCulling")), app->frustumCulling ? 1 : 0);
+    glUniform1ui(GetUniformLocation(cullProgram.reflection, ShaderId("uDrawCount")), app->gpuDrawCount);
+    glUniform3fv(GetUniformLocation(cullProgram.reflection, ShaderId("uCameraPosition")), 1, glm::value_ptr(app->camera.GetPosition()));
+    glUniform1f(GetUniformLocation(cullProgram.reflection, ShaderId("uNear")), app->camera.GetNearPlane());
+    glUniform1f(GetUniformLocation(cullProgram.reflection, ShaderId("uLodScale")), app->lodSelection ? GetLodProjectionScale(app) : 0.0f);
+    glUniform1f(GetUniformLocation(cullProgram.reflection, ShaderId("uLodThreshold")), app->lodErrorThreshold);
+    if (app->gpuDrawsMeshlets)
+    {
+        glUniform1i(GetUniformLocation(cullProgram.reflection, ShaderId("uConeCulling")), app->meshletConeCulling ? 1 : 0);
+    }
+
+    BindStorageBuffer(app->glState, 1, app->entitySSBO.handle);
+    BindStorageBuffer(app->glState, 11, app->gpuDrawTemplatesHandle);
+    BindStorageBuffer(app->glState, 12, app->gpuCommandsHandle);
+    BindStorageBuffer(app->glState, 13, app->gpuBatchCountsHandle);
+    BindStorageBuffer(app->glState, 14, app->gpuCullingStatsHandle);
+
+    const u32 groupSize = 64; // Must match local_size_x in the shader
+    glDispatchCompute((app->gpuDrawCount + groupSize - 1) / groupSize, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+    RequestReadback(app->gpuCullingStatsReadback, app->gpuCullingStatsHandle);
+
+    Program& indirectProgram = app->programs[app->texturedMeshIndirectProgramIdx];
+    UseProgram(app->glState, indirectProgram.handle);
+    stats.programBinds++;
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, app->gpuCommandsHandle);
+    if (app->supportsIndirectCount)
+    {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, app->gpuBatchCountsHandle);
+    }
+
+    // Upper bound, the real count is only known to the GPU
+    stats.draws = app->gpuDrawCount;
+    SubmitIndirectBatches(app, app->gpuDrivenBatches, app->supportsIndirectCount);
+
+    if (app->supportsIndirectCount)
+    {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void RenderGeometryInstanced(App* app)
+{
+    // Culling and LOD selection change the groups every frame
+    if (app->instanceGroupsDirty || app->frustumCulling || app->lodSelection || OcclusionCullingActive(app))
+    {
+        BuildInstanceGroups(app);
+        app->instanceGroupsDirty = false;
+    }
+
+    RenderQueueStats& stats = app->renderQueue.stats;
+    stats = {};
+
+    Program& instancedProgram = app->programs[app->texturedMeshInstancedProgramIdx];
+    UseProgram(app->glState, instancedProgram.handle);
+    stats.programBinds++;
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+    BindStorageBuffer(app->glState, 1, app->entitySSBO.handle);
+    BindStorageBuffer(app->glState, 4, app->instanceBufferHandle);
+
+    glUniform1i(GetUniformLocation(instancedProgram.reflection, ShaderId("uTexture")), 0);
+    const GLint instanceOffsetUniform = GetUniformLocation(instancedProgram.reflection, ShaderId("uInstanceOffset"));
+
+    for (const auto& group : app->instanceGroups)
+    {
+        Model& model = app->models[group.modelIndex];
+        Mesh& mesh = app->meshes[model.meshIdx];
+
+        glUniform1ui(instanceOffsetUniform, group.firstInstance);
+
+        for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+        {
+            Submesh& submesh = mesh.submeshes[i];
+            const u32 vaoIdx = FindVAO(app, submesh, instancedProgram);
+            BindVertexArray(app->glState, app->vaoCache.entries[vaoIdx].handle);
+            BindTexture(app->glState, 0, app->textures[GetSubmeshTextureIdx(app, group.textureIndex, model.materialIdx[i])].handle);
+            stats.vaoBinds++;
+            stats.textureBinds++;
+
+            BindVAOArenas(app, vaoIdx, submesh.vertexArena, submesh.indexArena);
+            SetVertexConstants(submesh);
+            const SubmeshLod& lod = submesh.lods[group.lod];
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lod.indexCount, mesh.indexType, (void*)(u64)((submesh.firstIndex + lod.firstIndex) * mesh.indexSize), group.instanceCount, submesh.baseVertex);
+            stats.draws++;
+        }
+    }
+}
+
+void BuildDepthPyramid(App* app, GLuint aDepthTexture)
+{
+    const u32 groupSize = 8; // Must match local_size_x/y in the shader
+
+    CopySceneDepth(app, aDepthTexture);
+
+    u32 width = app->hiZSize.x;
+    u32 height = app->hiZSize.y;
+
+    // Every level reads the one above it
+    Program& reduceProgram = app->programs[app->hiZReduceProgramIdx];
+    UseProgram(app->glState, reduceProgram.handle);
+
+    for (u32 level = 1; level < app->hiZLevelCount; ++level)
+    {
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        width = glm::max(width / 2, 1u);
+        height = glm::max(height / 2, 1u);
+
+        glBindImageTexture(0, app->hiZTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        glBindImageTexture(1, app->hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((width + groupSize - 1) / groupSize, (height + groupSize - 1) / groupSize, 1);
+    }
+}
+
+void RequestDepthPyramidReadback(App* app)
+{
+    // One readback in flight at a time
+    if (app->hiZReadbackFence != 0)
+    {
+        return;
+    }
+
+    u32 level = 0;
+    while (level + 1 < app->hiZLevelCount && (app->hiZSize.x >> level) > HIZ_READBACK_MAX_WIDTH)
+    {
+        level++;
+    }
+
+    app->hiZPendingWidth = glm::max(app->hiZSize.x >> level, 1);
+    app->hiZPendingHeight = glm::max(app->hiZSize.y >> level, 1);
+    app->hiZPendingViewProjection = app->camera.GetProjectionMatrix() * app->camera.GetViewMatrix();
+
+    // Copied into a buffer so the CPU only touches it once the fence says it is there
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, app->hiZReadbackBuffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, app->hiZPendingWidth * app->hiZPendingHeight * sizeof(f32), NULL, GL_STREAM_READ);
+    BindTexture(app->glState, 0, app->hiZTexture);
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RED, GL_FLOAT, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    app->hiZReadbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Second occlusion phase: the draws of the entities rejected against last
+// frame's depth are tested against this frame's pyramid on the GPU, which
+// zeroes the instance count of the ones still hidden before drawing them all
+void RenderOccludedGeometry(App* app)
+{
+    // Result of an earlier test, once its copy has landed
+    ConsumeReadback(app->occlusionStatsReadback, &app->occlusionRecoveredCount);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->occlusionStatsHandle);
+    GLuint zero = 0;
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    app->occlusionRetestedCount = app->occlusionCommands.size();
+
+    BuildRenderQueue(app, app->texturedMeshIndirectProgramIdx, EntityVisibility_Occluded);
+    BuildIndirectCommands(app, app->occlusionCommands, app->occlusionBatches);
+    if (app->occlusionCommands.empty())
+    {
+        // Nothing recovered this frame, the cleared counter says so
+        RequestReadback(app->occlusionStatsReadback, app->occlusionStatsHandle);
+        return;
+    }
+
+    // Per submesh bounds, tighter than the entity ones the first phase used
+    app->occlusionBounds.clear();
+    for (const auto& item : app->renderQueue.items)
+    {
+        const Entity& entity = app->entities[item.entityIdx];
+        Model& model = app->models[entity.modelIndex];
+        const AABB worldAABB = TransformAABB(app->meshes[model.meshIdx].submeshes[item.submeshIdx].aabb, entity.worldMatrix);
+        app->occlusionBounds.push_back(glm::vec4(worldAABB.min, 0.0f));
+        app->occlusionBounds.push_back(glm::vec4(worldAABB.max, 0.0f));
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->occlusionCommandsHandle);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, app->occlusionCommands.size() * sizeof(DrawElementsIndirectCommand), app->occlusionCommands.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->occlusionBoundsHandle);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, app->occlusionBounds.size() * sizeof(glm::vec4), app->occlusionBounds.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    Program& testProgram = app->programs[app->hiZTestProgramIdx];
+    UseProgram(app->glState, testProgram.handle);
+
+    const glm::mat4 viewProjection = app->camera.GetProjectionMatrix() * app->camera.GetViewMatrix();
+    glUniformMatrix4fv(GetUniformLocation(testProgram.reflection, ShaderId("uViewProjection")), 1, GL_FALSE, glm::value_ptr(viewProjection));
+    glUniform1ui(GetUniformLocation(testProgram.reflection, ShaderId("uCommandCount")), app->occlusionCommands.size());
+    glUniform1i(GetUniformLocation(testProgram.reflection, ShaderId("uPyramid")), 0);
+    BindTexture(app->glState, 0, app->hiZTexture);
+
+    BindStorageBuffer(app->glState, 8, app->occlusionCommandsHandle);
+    BindStorageBuffer(app->glState, 9, app->occlusionBoundsHandle);
+    BindStorageBuffer(app->glState, 10, app->occlusionStatsHandle);
+
+    const u32 groupSize = 64; // Must match local_size_x in the shader
+    glDispatchCompute((app->occlusionCommands.size() + groupSize - 1) / groupSize, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+    RequestReadback(app->occlusionStatsReadback, app->occlusionStatsHandle);
+
+    // Same state as the first phase, into the same G-buffer
+    Program& indirectProgram = app->programs[app->texturedMeshIndirectProgramIdx];
+    UseProgram(app->glState, indirectProgram.handle);
+    app->renderQueue.stats.programBinds++;
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+    BindStorageBuffer(app->glState, 1, app->entitySSBO.handle);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, app->occlusionCommandsHandle);
+
+    SubmitIndirectBatches(app, app->occlusionBatches, false);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void AssignClusterLights(App* app)
+{
+    // Counters of an earlier dispatch, once their copy has landed
+    ConsumeReadback(app->clusterStatsReadback, &app->clusterStats);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->clusterStatsHandle);
+    GLuint zero = 0;
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    Program& programClusterLights = app->programs[app->clusterLightsProgramIdx];
+    UseProgram(app->glState, programClusterLights.handle);
+
+    BindUniformBufferRange(app->glState, 0, app->globalUBO.handle, GetRingBufferOffset(app->globalUBO), app->globalUBO.size);
+    BindStorageBuffer(app->glState, 2, app->lightSSBO.handle);
+    BindStorageBuffer(app->glState, 5, app->clusterLightCountsHandle);
+    BindStorageBuffer(app->glState, 6, app->clusterLightIndicesHandle);
+    BindStorageBuffer(app->glState, 7, app->clusterStatsHandle);
+
+    glm::mat4 inverseProjection = glm::inverse(app->camera.GetProjectionMatrix());
+    glUniformMatrix4fv(GetUniformLocation(programClusterLights.reflection, ShaderId("uView")), 1, GL_FALSE, glm::value_ptr(app->camera.GetViewMatrix()));
+    glUniformMatrix4fv(GetUniformLocation(programClusterLights.reflection, ShaderId("uInverseProjection")), 1, GL_FALSE, glm::value_ptr(inverseProjection));
+    glUniform1f(GetUniformLocation(programClusterLights.reflection, ShaderId("uNear")), app->camera.GetNearPlane());
+    glUniform1f(GetUniformLocation(programClusterLights.reflection, ShaderId("uFar")), app->camera.GetFarPlane());
+
+    const u32 groupSize = 64; // Must match local_size_x in the shader
+    glDispatchCompute((CLUSTER_COUNT + groupSize - 1) / groupSize, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    RequestReadback(app->clusterStatsReadback, app->clusterStatsHandle);
+}
+
+void RenderClusteredForward(App* app)
+{
+    AssignClusterLights(app);
+
+    Program& programClusteredForward = app->programs[app->clusteredForwardProgramIdx];
+    UseProgram(app->glState, programClusteredForward.handle);
+    glUniform1f(GetUniformLocation(programClusteredForward.reflection, ShaderId("uNear")), app->camera.GetNearPlane());
+    glUniform1f(GetUniformLocation(programClusteredForward.reflection, ShaderId("uFar")), app->camera.GetFarPlane());
+    glUniform2f(GetUniformLocation(programClusteredForward.reflection, ShaderId("uScreenSize")), (f32)app->displaySize.x, (f32)app->displaySize.y);
+
+    BindStorageBuffer(app->glState, 2, app->lightSSBO.handle);
+    BindStorageBuffer(app->glState, 5, app->clusterLightCountsHandle);
+    BindStorageBuffer(app->glState, 6, app->clusterLightIndicesHandle);
+
+    RenderGeometryLoop(app, app->clusteredForwardProgramIdx);
+}
+
+GLuint GetGBufferFramebuffer(FrameGraph& graph, const GBufferResources& gBuffer)
+{
+    FrameGraphResource targets[GBUFFER_MAX_ATTACHMENTS + 1];
+    for (u32 i = 0; i < gBuffer.attachmentCount; ++i)
+    {
+        targets[i] = gBuffer.attachments[i];
+    }
+    targets[gBuffer.attachmentCount] = gBuffer.depth;
+    return GetFramebuffer(graph, targets, gBuffer.attachmentCount + 1);
+}
+
+void WriteGBuffer(FrameGraph& graph, u32 pass, GBufferResources& gBuffer, bool keepContents)
+{
+    for (u32 i = 0; i < gBuffer.attachmentCount; ++i)
+    {
+        gBuffer.attachments[i] = WriteTexture(graph, pass, gBuffer.attachments[i], FrameGraphAccess_Attachment, keepContents);
+    }
+    gBuffer.depth = WriteTexture(graph, pass, gBuffer.depth, FrameGraphAccess_Attachment, keepContents);
+}
+
+GBufferResources AddGBufferPass(App* app)
+{
+    FrameGraph& graph = app->frameGraph;
+
+    const char* attachmentNames[GBUFFER_MAX_ATTACHMENTS] = { "GBufferAlbedo", "GBufferNormals", "GBufferPosition", "GBufferViewDir" };
+    const std::vector<GLenum> formats = GetGBufferFormats(app->gBufferLayout);
+    const u32 width = app->renderTargetSize.x;
+    const u32 height = app->renderTargetSize.y;
+
+    GBufferResources gBuffer = {};
+    gBuffer.attachmentCount = formats.size();
+    for (u32 i = 0; i < gBuffer.attachmentCount; ++i)
+    {
+        gBuffer.attachments[i] = CreateTexture(graph, attachmentNames[i], { width, height, formats[i] });
+    }
+    gBuffer.depth = CreateTexture(graph, "GBufferDepth", { width, height, GL_DEPTH24_STENCIL8 });
+
+    const u32 pass = AddPass(graph, "GBuffer", [app, gBuffer](FrameGraph& graph)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, GetGBufferFramebuffer(graph, gBuffer));
+        glClearColor(0.f, 0.f, 0.f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glViewport(0, 0, app->renderSize.x, app->renderSize.y);
+
+        auto submitStart = std::chrono::high_resolution_clock::now();
+
+        if (GPUDrivenSubmissionActive(app))
+        {
+            RenderGeometryGPUDriven(app);
+        }
+        else if (app->submissionMode == SubmissionMode_MultiDrawIndirect && app->supportsDrawParameters)
+        {
+            RenderGeometryIndirect(app);
+        }
+        else if (app->submissionMode == SubmissionMode_Instanced)
+        {
+            RenderGeometryInstanced(app);
+        }
+        else
+        {
+            RenderGeometryLoop(app, app->texturedMeshProgramIdx);
+        }
+
+        auto submitEnd = std::chrono::high_resolution_clock::now();
+        app->geometrySubmitTime = std::chrono::duration<f64, std::milli>(submitEnd - submitStart).count();
+    });
+    WriteGBuffer(graph, pass, gBuffer, false);
+
+    return gBuffer;
+}
+
+// The pyramid only holds the first phase depth, which at worst makes next
+// frame's first phase keep a few more entities than needed
+void AddOcclusionCullingPasses(App* app, GBufferResources& gBuffer, FrameGraphResource& hiZ)
+{
+    FrameGraph& graph = app->frameGraph;
+
+    const u32 pyramidPass = AddPass(graph, "DepthPyramid", [app, gBuffer](FrameGraph& graph)
+    {
+        BuildDepthPyramid(app, GetTexture(graph, gBuffer.depth));
+    });
+    ReadTexture(graph, pyramidPass, gBuffer.depth, FrameGraphAccess_Sampled);
+    hiZ = WriteTexture(graph, pyramidPass, hiZ, FrameGraphAccess_Image, false);
+
+    const u32 occludedPass = AddPass(graph, "OccludedGeometry", [app, gBuffer](FrameGraph& graph)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, GetGBufferFramebuffer(graph, gBuffer));
+
+        auto submitStart = std::chrono::high_resolution_clock::now();
+        RenderOccludedGeometry(app);
+        auto submitEnd = std::chrono::high_resolution_clock::now();
+        app->geometrySubmitTime += std::chrono::duration<f64, std::milli>(submitEnd - submitStart).count();
+    });
+    ReadTexture(graph, occludedPass, hiZ, FrameGraphAccess_Sampled);
+    WriteGBuffer(graph, occludedPass, gBuffer, true);
+
+    const u32 readbackPass = AddPass(graph, "HiZReadback", [app](FrameGraph&)
+    {
+        RequestDepthPyramidReadback(app);
+    });
+    ReadTexture(graph, readbackPass, hiZ, FrameGraphAccess_Transfer);
+    SetPassSideEffect(graph, readbackPass);
+}
 
-            glBindFramebuffer(GL_FRAMEBUFFER, app->primaryFBO.handle);
+void Render(App* app)
+{
+    // Anything may have changed the GL state since the last frame
+    InvalidateGLState(app->glState);
 
-            std::vector<GLuint>textures;
-            for(auto& it:app->primaryFBO.attachments)
-            {
-                textures.push_back(it.second);
-            }
-            glDrawBuffers(textures.size(), textures.data());
+    BeginRenderTargetFrame(app->renderTargets);
+    ApplyPendingResize(app);
+    UpdateRenderSize(app);
 
-            glClearColor(0.f, 0.f, 0.f, 0.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    app->vaoCache.lookups = 0;
+    app->vaoCache.hits = 0;
+    app->vaoCache.arenaRebinds = 0;
 
-            glViewport(0, 0, app->displaySize.x, app->displaySize.y);
+    BeginFrameUniforms(app);
+    CullEntities(app);
+    if (!GPUDrivenSubmissionActive(app))
+    {
+        SelectEntityLods(app);
+    }
 
-            Program& textureMeshProgram = app->programs[app->texturedMeshProgramIdx];
-            glUseProgram(textureMeshProgram.handle);
+    FrameGraph& graph = app->frameGraph;
+    BeginFrameGraph(graph);
 
-            glBindBufferRange(GL_UNIFORM_BUFFER, 0, app->globalUBO.handle, 0, app->globalUBO.size);
+    const u32 width = app->displaySize.x;
+    const u32 height = app->displaySize.y;
+    const FrameGraphResource backbuffer = ImportTexture(graph, "Backbuffer", 0, { width, height, GL_RGBA8 });
 
-            for (const auto& entity : app->entities) 
+    switch (app->mode)
+    {
+        case Mode_TexturedQuad:
+        {
+            const u32 pass = AddPass(graph, "TexturedQuad", [app](FrameGraph&)
             {
-                glBindBufferRange(GL_UNIFORM_BUFFER, 1, app->entityUBO.handle, entity.entityBufferOffset, entity.entityBufferSize);
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glClearColor(0.f, 0.f, 0.f, 0.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-                Model& model = app->models[entity.modelIndex];
-                Mesh& mesh = app->meshes[model.meshIdx];
+                glViewport(0, 0, app->displaySize.x, app->displaySize.y);
 
-                for (u32 i = 0; i < mesh.submeshes.size(); ++i) {
-                    GLuint vao = FindVAO(mesh, i, textureMeshProgram);
-                    glBindVertexArray(vao);
+                Program& programTexturedGeometry = app->programs[app->texturedGeometryProgramIdx];
+                UseProgram(app->glState, programTexturedGeometry.handle);
+                BindVertexArray(app->glState, app->vao);
 
-                    u32 submeshMaterialIdx = model.materialIdx[i];
-                    Material& submeshMaterial = app->materials[submeshMaterialIdx];
+                SetBlend(app->glState, true);
+                SetBlendFunc(app->glState, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-                    if (submeshMaterial.albedoTextureIdx > 0) 
-                    {
-                        glActiveTexture(GL_TEXTURE0);
-                        glBindTexture(GL_TEXTURE_2D, app->textures[submeshMaterial.albedoTextureIdx].handle);
-                        glUniform1i(app->textureUniform, 0);
-                    }
-                    else 
-                    {
-                        glActiveTexture(GL_TEXTURE0);
-                        glBindTexture(GL_TEXTURE_2D, app->textures[entity.textureIndex].handle);
-                        glUniform1i(app->textureUniform, 0);
-                    }
+                glUniform1i(GetUniformLocation(programTexturedGeometry.reflection, ShaderId("uColor")), 0);
+                GLuint textureHandle = app->textures[app->diceTexIdx].handle;
+                BindTexture(app->glState, 0, textureHandle);
 
-                    Submesh& submesh = mesh.submeshes[i];
-                    glDrawElements(GL_TRIANGLES, submesh.indices.size(), GL_UNSIGNED_INT, (void*)(u64)submesh.indexOffset);
+                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+            });
+            WriteTexture(graph, pass, backbuffer, FrameGraphAccess_Attachment, false);
+        }
+        break;
+        case Mode_Forward_Geometry:
+        {
+            GBufferResources gBuffer = AddGBufferPass(app);
 
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                }
+            FrameGraphResource hiZ = ImportTexture(graph, "HiZ", app->hiZTexture, { (u32)app->hiZSize.x, (u32)app->hiZSize.y, GL_R32F });
+            if (OcclusionCullingActive(app))
+            {
+                AddOcclusionCullingPasses(app, gBuffer, hiZ);
             }
 
-            glUseProgram(0);
-            RenderScreenFillQuad(app, app->primaryFBO);
-            glBindBuffer(GL_FRAMEBUFFER, 0);
+            AddLightingPasses(app, gBuffer, hiZ, backbuffer);
+        }
+        break;
+        case Mode_ClusteredForward:
+        {
+            // Shades straight into the backbuffer, no G-buffer involved
+            const u32 pass = AddPass(graph, "ClusteredForward", [app](FrameGraph&)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glClearColor(0.f, 0.f, 0.f, 0.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                glViewport(0, 0, app->displaySize.x, app->displaySize.y);
+
+                auto submitStart = std::chrono::high_resolution_clock::now();
+
+                RenderClusteredForward(app);
+
+                auto submitEnd = std::chrono::high_resolution_clock::now();
+                app->geometrySubmitTime = std::chrono::duration<f64, std::milli>(submitEnd - submitStart).count();
+            });
+            WriteTexture(graph, pass, backbuffer, FrameGraphAccess_Attachment, false);
         }
         break;
 
         default:;
     }
+
+    CompileFrameGraph(graph, app->renderTargets);
+
+    BeginGpuFrameTimer(app->dynamicResolution);
+    ExecuteFrameGraph(graph);
+    EndGpuFrameTimer(app->dynamicResolution);
+
+    EndFrameUniforms(app);
 }
 
 void Cleanup(App* app)
@@ -649,6 +2475,22 @@ void Cleanup(App* app)
         app->vao = 0;
     }
 
+    for (auto& vao : app->vaoCache.entries)
+    {
+        glDeleteVertexArrays(1, &vao.handle);
+    }
+    app->vaoCache.entries.clear();
+    app->vaoCache.lookup.clear();
+
+    for (auto& arena : app->geometryArenas.vertexArenas)
+    {
+        DestroyGeometryArena(arena);
+    }
+    for (auto& arena : app->geometryArenas.indexArenas)
+    {
+        DestroyGeometryArena(arena);
+    }
+
     if (app->embeddedVertices != 0)
     {
         glDeleteBuffers(1, &app->embeddedVertices);
@@ -661,42 +2503,98 @@ void Cleanup(App* app)
         app->embeddedElements = 0;
     }
 
-    app->primaryFBO.Clean();
+    if (app->indirectBufferHandle != 0)
+    {
+        glDeleteBuffers(1, &app->indirectBufferHandle);
+        app->indirectBufferHandle = 0;
+    }
+
+    if (app->instanceBufferHandle != 0)
+    {
+        glDeleteBuffers(1, &app->instanceBufferHandle);
+        app->instanceBufferHandle = 0;
+    }
+
+    DestroyRingBuffer(app->globalUBO);
+    glDeleteBuffers(1, &app->entitySSBO.handle);
+    app->entitySSBO.handle = 0;
+
+    glDeleteBuffers(1, &app->lightSSBO.handle);
+    app->lightSSBO.handle = 0;
+
+    GLuint clusterBuffers[] = { app->clusterLightCountsHandle, app->clusterLightIndicesHandle, app->clusterStatsHandle };
+    glDeleteBuffers(ARRAY_COUNT(clusterBuffers), clusterBuffers);
+    app->clusterLightCountsHandle = 0;
+    app->clusterLightIndicesHandle = 0;
+    app->clusterStatsHandle = 0;
+    DestroyReadbackBuffer(app->clusterStatsReadback);
+
+    glDeleteQueries(1, &app->lightingTimeQuery);
+    app->lightingTimeQuery = 0;
+
+    DestroyDynamicResolution(app->dynamicResolution);
+    glDeleteSamplers(1, &app->linearSampler);
+    app->linearSampler = 0;
+
+    GLuint gpuDrivenBuffers[] = { app->gpuDrawTemplatesHandle, app->gpuCommandsHandle, app->gpuBatchCountsHandle, app->gpuCullingStatsHandle };
+    glDeleteBuffers(ARRAY_COUNT(gpuDrivenBuffers), gpuDrivenBuffers);
+    app->gpuDrawTemplatesHandle = 0;
+    app->gpuCommandsHandle = 0;
+    app->gpuBatchCountsHandle = 0;
+    app->gpuCullingStatsHandle = 0;
+    DestroyReadbackBuffer(app->gpuCullingStatsReadback);
+
+    GLuint occlusionBuffers[] = { app->hiZReadbackBuffer, app->occlusionCommandsHandle, app->occlusionBoundsHandle, app->occlusionStatsHandle };
+    glDeleteBuffers(ARRAY_COUNT(occlusionBuffers), occlusionBuffers);
+    app->hiZReadbackBuffer = 0;
+    app->occlusionCommandsHandle = 0;
+    app->occlusionBoundsHandle = 0;
+    app->occlusionStatsHandle = 0;
+    DestroyReadbackBuffer(app->occlusionStatsReadback);
+
+    if (app->hiZReadbackFence != 0)
+    {
+        glDeleteSync(app->hiZReadbackFence);
+        app->hiZReadbackFence = 0;
+    }
+
+    app->hiZTexture = 0;
+
+    DestroyFrameGraph(app->frameGraph);
+    DestroyRenderTargetPool(app->renderTargets);
 }
 
-GLuint FindVAO(Mesh& mesh, u32 submeshIndex, const Program& program)
+u32 FindVAO(App* app, const Submesh& submesh, const Program& program)
 {
-    Submesh& submesh = mesh.submeshes[submeshIndex];
+    VaoCache& cache = app->vaoCache;
+    cache.lookups++;
 
-    // Try finding a VAO for this submesh/program
-    for (u32 i = 0; i < (u32)submesh.vaos.size(); ++i) {
-        if (submesh.vaos[i].programHandle == program.handle) {
-            return submesh.vaos[i].handle;
-        }
+    const u64 key = ((u64)submesh.vertexFormat << 32) | program.inputLayout;
+    auto it = cache.lookup.find(key);
+    if (it != cache.lookup.end())
+    {
+        cache.hits++;
+        return it->second;
     }
 
-    GLuint vaoHandle = 0;
-
-    // Create a new VAO for this submesh/program
-    //CreateVAO(mesh, submesh, program, vaoHandle);
-    glGenVertexArrays(1, &vaoHandle);
-    glBindVertexArray(vaoHandle);
+    VaoCacheEntry vao = { 0, UINT32_MAX, UINT32_MAX };
+    glGenVertexArrays(1, &vao.handle);
+    BindVertexArray(app->glState, vao.handle);
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
+    // Link all vertex input attributes to attributes of the vertex format
+    const VertexBufferLayout& format = app->geometryArenas.vertexFormats[submesh.vertexFormat];
+    for (const auto& input : program.vertexInputLayout.attributes) {
+        // Generic values set per draw, see SetVertexConstants
+        if (input.location == VERTEX_POSITION_DEQUANTIZE_LOCATION || input.location == VERTEX_TEXCOORD_DEQUANTIZE_LOCATION) {
+            continue;
+        }
 
-    // Link all vertex input attributes to attributes in the vertex buffer
-    for (u32 i = 0; i < program.vertexInputLayout.attributes.size(); ++i) {
         bool attributeWasLinked = false;
-
-        for (u32 j = 0; j < submesh.vertexBufferLayout.attributes.size(); ++j) {
-            if (program.vertexInputLayout.attributes[i].location == submesh.vertexBufferLayout.attributes[j].location) {
-                const u32 index = submesh.vertexBufferLayout.attributes[j].location;
-                const u32 ncomp = submesh.vertexBufferLayout.attributes[j].componentCount;
-                const u32 offset = submesh.vertexBufferLayout.attributes[j].offset + submesh.vertexOffset; // attribute offset + vertex offset
-                const u32 stride = submesh.vertexBufferLayout.stride;
-                glVertexAttribPointer(index, ncomp, GL_FLOAT, GL_FALSE, stride, (void*)(u64)offset);
-                glEnableVertexAttribArray(index);
+        for (const auto& attribute : format.attributes) {
+            if (input.location == attribute.location) {
+                glVertexAttribFormat(input.location, attribute.componentCount, attribute.type, attribute.normalized, attribute.offset);
+                glVertexAttribBinding(input.location, VERTEX_ARENA_BINDING);
+                glEnableVertexAttribArray(input.location);
 
                 attributeWasLinked = true;
                 break;
@@ -706,43 +2604,35 @@ GLuint FindVAO(Mesh& mesh, u32 submeshIndex, const Program& program)
         assert(attributeWasLinked); // The submesh should provide an attribute for each vertex input
     }
 
-    glBindVertexArray(0);
-    Vao vao = { vaoHandle, program.handle };
-    submesh.vaos.push_back(vao);
-
-    return vaoHandle;
+    cache.entries.push_back(vao);
+    cache.lookup.emplace(key, (u32)cache.entries.size() - 1);
+    return cache.entries.size() - 1;
 }
 
-void CreateVAO(Mesh& mesh, Submesh& submesh, const Program& program, GLuint& vaoHandle)
+void BindVAOArenas(App* app, u32 vaoIdx, u32 vertexArena, u32 indexArena)
 {
-    glGenVertexArrays(1, &vaoHandle);
-    glBindVertexArray(vaoHandle);
-
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
-
-    // Link all vertex input attributes to attributes in the vertex buffer
-    for (u32 i = 0; i < program.vertexInputLayout.attributes.size(); ++i) {
-        bool attributeWasLinked = false;
-
-        for (u32 j = 0; j < submesh.vertexBufferLayout.attributes.size(); ++j) {
-            if (program.vertexInputLayout.attributes[i].location == submesh.vertexBufferLayout.attributes[j].location) {
-                const u32 index = submesh.vertexBufferLayout.attributes[j].location;
-                const u32 ncomp = submesh.vertexBufferLayout.attributes[j].componentCount;
-                const u32 offset = submesh.vertexBufferLayout.attributes[j].offset + submesh.vertexOffset; // attribute offset + vertex offset
-                const u32 stride = submesh.vertexBufferLayout.stride;
-                glVertexAttribPointer(index, ncomp, GL_FLOAT, GL_FALSE, stride, (void*)(u64)offset);
-                glEnableVertexAttribArray(index);
-
-                attributeWasLinked = true;
-                break;
-            }
-        }
+    VaoCacheEntry& vao = app->vaoCache.entries[vaoIdx];
+    const GeometryArenas& arenas = app->geometryArenas;
 
-        assert(attributeWasLinked); // The submesh should provide an attribute for each vertex input
+    if (vao.vertexArena != vertexArena)
+    {
+        const GeometryArena& arena = arenas.vertexArenas[vertexArena];
+        glBindVertexBuffer(VERTEX_ARENA_BINDING, arena.handle, 0, arena.elementSize);
+        vao.vertexArena = vertexArena;
+        app->vaoCache.arenaRebinds++;
+    }
+    if (vao.indexArena != indexArena)
+    {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arenas.indexArenas[indexArena].handle);
+        vao.indexArena = indexArena;
+        app->vaoCache.arenaRebinds++;
     }
+}
 
-    glBindVertexArray(0);
+void SetVertexConstants(const Submesh& submesh)
+{
+    glVertexAttrib4fv(VERTEX_POSITION_DEQUANTIZE_LOCATION, glm::value_ptr(submesh.vertexConstants.position));
+    glVertexAttrib4fv(VERTEX_TEXCOORD_DEQUANTIZE_LOCATION, glm::value_ptr(submesh.vertexConstants.texCoord));
 }
 
 OpenGLInfo GetOpenGLInfo(OpenGLInfo& glInfo)
@@ -786,6 +2676,12 @@ void InfoWindow(App* app)
     ImGui::Separator();
     ImGui::Spacing();
 
+    ImGuiDynamicResolutionTab(app); // Dynamic Resolution
+
+    ImGui::Spacing();
+    ImGui::Separator();
+    ImGui::Spacing();
+
     ImGuiLightTab(app); // Lights
 
     ImGui::Spacing();
@@ -908,6 +2804,37 @@ void ImGuiGbufferTab(App* app)
 {
     if (ImGui::TreeNodeEx("Render", ImGuiTreeNodeFlags_DefaultOpen))
     {
+        ImGui::Spacing();
+        ImGui::Text("Render Mode:");
+        ImGui::Spacing();
+
+        if (ImGui::BeginCombo("##Mode", app->ModeItems[app->mode].c_str())) {
+            for (int i = 0; i < Mode_Count; i++) {
+                const bool isSelected = (app->mode == i);
+                if (ImGui::Selectable(app->ModeItems[i].c_str(), isSelected)) {
+                    app->mode = (Mode)i;
+                }
+
+                if (isSelected) {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        if (app->mode == Mode_ClusteredForward)
+        {
+            const ClusterStats& clusterStats = app->clusterStats;
+            const f32 occupancy = 100.0f * clusterStats.occupiedClusters / CLUSTER_COUNT;
+            const f32 averageLights = clusterStats.occupiedClusters > 0 ? (f32)clusterStats.lightAssignments / clusterStats.occupiedClusters : 0.0f;
+
+            ImGui::Text("Clusters: %dx%dx%d (%d)", CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, CLUSTER_COUNT);
+            ImGui::Text("Occupied: %u (%.1f%%)", clusterStats.occupiedClusters, occupancy);
+            ImGui::Text("Lights per occupied cluster: %.1f avg, %u max", averageLights, clusterStats.maxLightsPerCluster);
+            ImGui::Text("Light assignments: %u", clusterStats.lightAssignments);
+            ImGui::Text("Overflowed clusters: %u (limit %d)", clusterStats.overflowedClusters, MAX_LIGHTS_PER_CLUSTER);
+        }
+
         ImGui::Spacing();
         ImGui::Text("GBuffer Modes:");
         ImGui::Spacing();
@@ -928,6 +2855,310 @@ void ImGuiGbufferTab(App* app)
             }
             ImGui::EndCombo();
         }
+
+        ImGui::Spacing();
+        ImGui::Text("GBuffer Layout:");
+        ImGui::Spacing();
+
+        if (ImGui::BeginCombo("##GBufferLayout", app->GBufferLayoutItems[app->gBufferLayout].c_str())) {
+            for (int i = 0; i < GBufferLayout_Count; i++) {
+                const bool isSelected = (app->gBufferLayout == i);
+                if (ImGui::Selectable(app->GBufferLayoutItems[i].c_str(), isSelected) && !isSelected) {
+                    app->gBufferLayout = (GBufferLayout)i;
+                }
+
+                if (isSelected) {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        const u32 gBufferBytesPerPixel = GetGBufferBytesPerPixel(app->gBufferLayout);
+        ImGui::Text("GBuffer: %u bytes per pixel, %.1f MB (%.1f MB at 4K)", gBufferBytesPerPixel,
+                    (f32)gBufferBytesPerPixel * app->displaySize.x * app->displaySize.y / (1024.0f * 1024.0f),
+                    (f32)gBufferBytesPerPixel * 3840 * 2160 / (1024.0f * 1024.0f));
+
+        const RenderTargetPool& renderTargets = app->renderTargets;
+        ImGui::Text("Render targets: %d, %.1f MB; this frame %u allocated, %u reused, %u evicted (%llu allocations)", (int)renderTargets.targets.size(),
+                    GetRenderTargetPoolBytes(renderTargets) / (1024.0 * 1024.0), renderTargets.stats.allocations, renderTargets.stats.reuses,
+                    renderTargets.stats.evictions, (unsigned long long)renderTargets.stats.totalAllocations);
+        ImGui::Text("Targets %dx%d for a %dx%d viewport, last resize merged %u window events", app->renderTargetSize.x, app->renderTargetSize.y,
+                    app->displaySize.x, app->displaySize.y, app->coalescedResizeCount);
+        ImGui::Checkbox("Oversize targets while resizing", &app->oversizeWhileResizing);
+
+        ImGuiFrameGraph(app);
+
+        ImGui::Spacing();
+        ImGui::Text("Lighting Pass:");
+        ImGui::Spacing();
+
+        if (ImGui::BeginCombo("##Lighting", app->LightingModeItems[app->lightingMode].c_str())) {
+            for (int i = 0; i < LightingMode_Count; i++) {
+                const bool isSelected = (app->lightingMode == i);
+                if (ImGui::Selectable(app->LightingModeItems[i].c_str(), isSelected)) {
+                    app->lightingMode = (LightingMode)i;
+                }
+
+                if (isSelected) {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        ImGui::Text("Lighting GPU time: %.3f ms (%d lights)", app->lightingGpuTime, (int)app->lights.size());
+
+        ImGui::Spacing();
+        ImGui::Text("Geometry Submission:");
+        ImGui::Spacing();
+
+        if (ImGui::BeginCombo("##Submission", app->SubmissionModeItems[app->submissionMode].c_str())) {
+            for (int i = 0; i < SubmissionMode_Count; i++) {
+                const bool isSelected = (app->submissionMode == i);
+                const bool isAvailable = (i != SubmissionMode_MultiDrawIndirect && i != SubmissionMode_GPUDriven && i != SubmissionMode_GPUMeshlets) || app->supportsDrawParameters;
+                if (ImGui::Selectable(app->SubmissionModeItems[i].c_str(), isSelected, isAvailable ? 0 : ImGuiSelectableFlags_Disabled)) {
+                    app->submissionMode = (SubmissionMode)i;
+                }
+
+                if (isSelected) {
+                    ImGui::SetItemDefaultFocus();
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        ImGui::Text("Entities: %d", (int)app->entities.size());
+        ImGui::Text("Vertex memory: %.1f KB (%.1f KB as floats, %s)", app->vertexMemory / 1024.0, app->vertexMemoryFloat / 1024.0,
+                    app->compressVertices ? "packed" : "not packed");
+        ImGui::SameLine();
+        if (ImGui::Button("Entity Stress Test"))
+        {
+            CreateEntityStressTest(app);
+        }
+
+        u64 arenaUsed = 0;
+        u64 arenaCapacity = 0;
+        u32 arenaFreeBlocks = 0;
+        auto addArenaUsage = [&](const std::vector<GeometryArena>& arenas)
+        {
+            for (const auto& arena : arenas)
+            {
+                arenaUsed += (u64)arena.allocator.usedCount * arena.elementSize;
+                arenaCapacity += (u64)arena.allocator.capacity * arena.elementSize;
+                arenaFreeBlocks += arena.allocator.freeBlocks.size();
+            }
+        };
+        addArenaUsage(app->geometryArenas.vertexArenas);
+        addArenaUsage(app->geometryArenas.indexArenas);
+        ImGui::Text("Geometry arenas: %d vertex, %d index, %.2f of %.1f MB, %u free blocks", (int)app->geometryArenas.vertexArenas.size(),
+                    (int)app->geometryArenas.indexArenas.size(), arenaUsed / (1024.0 * 1024.0), arenaCapacity / (1024.0 * 1024.0), arenaFreeBlocks);
+        ImGui::SameLine();
+        if (ImGui::Button("Defragment"))
+        {
+            const u32 movedCount = DefragmentGeometry(app->geometryArenas, app->meshes);
+            app->gpuDrawsDirty = true;
+            ILOG("Geometry defragmented, %u submeshes moved", movedCount);
+        }
+
+        if (ImGui::Checkbox("Frustum Culling", &app->frustumCulling))
+        {
+            app->instanceGroupsDirty = true;
+        }
+        if (GPUDrivenSubmissionActive(app))
+        {
+            ImGui::Text("Visible: culled on the GPU, see GPU draws");
+        }
+        else
+        {
+            ImGui::Text("Visible: %u, culled: %u (%.3f ms)", app->visibleEntityCount, (u32)app->entities.size() - app->visibleEntityCount, app->cullingTime);
+        }
+        // The second phase draws indirectly
+        if (app->supportsDrawParameters)
+        {
+            ImGui::Checkbox("Hi-Z Occlusion Culling", &app->occlusionCulling);
+        }
+        if (OcclusionCullingActive(app))
+        {
+            ImGui::Text("Occluded: %u (last frame's depth)", app->occludedEntityCount);
+            ImGui::Text("Re-tested draws: %u, drawn after all: %u", app->occlusionRetestedCount, app->occlusionRecoveredCount);
+        }
+        ImGui::Checkbox("LOD Selection", &app->lodSelection);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::SliderFloat("Max error (px)", &app->lodErrorThreshold, 0.1f, 16.0f, "%.1f");
+        if (app->lodSelection && !GPUDrivenSubmissionActive(app))
+        {
+            ImGui::Text("Entities per LOD:");
+            for (u32 lod = 0; lod < MESH_LOD_COUNT; ++lod)
+            {
+                ImGui::SameLine();
+                ImGui::Text(lod + 1 < MESH_LOD_COUNT ? "%u /" : "%u", app->lodHistogram[lod]);
+            }
+        }
+        ImGui::Text("BVH: %u leaves, height %u", app->entityTree.proxyCount, GetTreeHeight(app->entityTree));
+        if (app->pickedEntity >= 0)
+        {
+            ImGui::Text("Picked entity: %d (model %u)", app->pickedEntity, app->entities[app->pickedEntity].modelIndex);
+            ImGui::SameLine();
+            if (ImGui::Button("Remove"))
+            {
+                RemoveEntity(app, app->pickedEntity);
+            }
+        }
+        if (ImGui::Button("Culling Benchmark (1M AABBs)"))
+        {
+            const glm::mat4 viewProjection = app->camera.GetProjectionMatrix() * app->camera.GetViewMatrix();
+            app->cullingBenchmark = RunCullingBenchmark(ExtractFrustumPlanes(viewProjection), 1000000);
+        }
+        if (app->cullingBenchmark.count > 0)
+        {
+            const CullingBenchmarkResult& benchmark = app->cullingBenchmark;
+            ImGui::Text("Scalar: %.3f ms, SIMD (%u wide): %.3f ms (%.1fx)", benchmark.scalarTime, GetCullingSIMDWidth(), benchmark.simdTime,
+                        benchmark.scalarTime / glm::max(benchmark.simdTime, 0.001));
+            ImGui::Text("Visible: %u scalar, %u SIMD", benchmark.visibleScalar, benchmark.visibleSIMD);
+        }
+        if (ImGui::Button("BVH Benchmark (1k to 100k AABBs)"))
+        {
+            u32 count = 1000;
+            for (u32 i = 0; i < BVH_BENCHMARK_SIZES; ++i, count *= 10)
+            {
+                app->bvhBenchmarks[i] = RunBVHBenchmark(count);
+            }
+        }
+        for (u32 i = 0; i < BVH_BENCHMARK_SIZES; ++i)
+        {
+            const BVHBenchmarkResult& benchmark = app->bvhBenchmarks[i];
+            if (benchmark.count == 0)
+            {
+                continue;
+            }
+
+            ImGui::Text("%u AABBs, build %.3f ms, %d queries, linear vs BVH:", benchmark.count, benchmark.buildTime, BVH_BENCHMARK_QUERIES);
+            ImGui::Text("  Spheres: %.3f ms, %.3f ms (%.1fx, %u/%u hits)", benchmark.sphereLinearTime, benchmark.sphereTreeTime,
+                        benchmark.sphereLinearTime / glm::max(benchmark.sphereTreeTime, 0.001), benchmark.sphereHitsLinear, benchmark.sphereHitsTree);
+            ImGui::Text("  Rays: %.3f ms, %.3f ms (%.1fx, %u/%u hits)", benchmark.rayLinearTime, benchmark.rayTreeTime,
+                        benchmark.rayLinearTime / glm::max(benchmark.rayTreeTime, 0.001), benchmark.rayHitsLinear, benchmark.rayHitsTree);
+        }
+
+        ImGui::Text("Submit CPU time: %.3f ms", app->geometrySubmitTime);
+        ImGui::Text("Uniform ring stall: %.3f ms (%s)", app->uniformStallTime, app->supportsBufferStorage ? "persistent" : "unsynchronized map");
+
+        const RenderQueueStats& queueStats = app->renderQueue.stats;
+        ImGui::Text("Draws: %u", queueStats.draws);
+        ImGui::Text("Binds: %u program, %u VAO, %u texture", queueStats.programBinds, queueStats.vaoBinds, queueStats.textureBinds);
+        ImGui::Text("Binds skipped: %u", queueStats.skippedBinds);
+        const GLStateStats& glStateStats = app->glState.stats;
+        ImGui::Text("GL state calls: %u issued, %u filtered (%.1f%%)", glStateStats.issued, glStateStats.filtered,
+                    glStateStats.issued + glStateStats.filtered > 0 ? 100.0f * glStateStats.filtered / (glStateStats.issued + glStateStats.filtered) : 0.0f);
+        const VaoCache& vaoCache = app->vaoCache;
+        ImGui::Text("VAOs: %d, cache hit rate %.1f%% (%u lookups), %u arena rebinds", (int)vaoCache.entries.size(),
+                    vaoCache.lookups > 0 ? 100.0f * vaoCache.hits / vaoCache.lookups : 100.0f, vaoCache.lookups, vaoCache.arenaRebinds);
+        if (app->submissionMode == SubmissionMode_MultiDrawIndirect)
+        {
+            ImGui::Text("Indirect commands: %d in %d batches", (int)app->indirectCommands.size(), (int)app->indirectBatches.size());
+        }
+        if (app->submissionMode == SubmissionMode_GPUDriven || app->submissionMode == SubmissionMode_GPUMeshlets)
+        {
+            ImGui::Text("GPU %s: %u visible of %u in %d batches (%s)", app->gpuDrawsMeshlets ? "meshlets" : "draws", app->gpuVisibleDrawCount, app->gpuDrawCount,
+                        (int)app->gpuDrivenBatches.size(), app->supportsIndirectCount ? "indirect count" : "full ranges");
+        }
+        if (app->submissionMode == SubmissionMode_GPUMeshlets)
+        {
+            ImGui::Checkbox("Meshlet cone culling", &app->meshletConeCulling);
+        }
+        if (app->submissionMode == SubmissionMode_Instanced)
+        {
+            ImGui::Text("Instance groups: %d for %d entities", (int)app->instanceGroups.size(), (int)app->entities.size());
+        }
+        ImGui::TreePop();
+    }
+}
+
+void ImGuiFrameGraph(App* app)
+{
+    if (ImGui::TreeNode("Frame Graph"))
+    {
+        const FrameGraph& graph = app->frameGraph;
+        const FrameGraphStats& stats = graph.stats;
+        ImGui::Text("Passes: %u, culled: %u, barriers: %u", stats.passCount, stats.culledPassCount, stats.barrierCount);
+        ImGui::Text("Transients: %u in %u textures, %.1f MB (%.1f MB without aliasing)", stats.transientCount, stats.targetCount,
+                    stats.targetBytes / (1024.0 * 1024.0), stats.transientBytes / (1024.0 * 1024.0));
+
+        for (u32 position = 0; position < graph.order.size(); ++position)
+        {
+            const FrameGraphPass& pass = graph.passes[graph.order[position]];
+            ImGui::BulletText("%u: %s%s", position, pass.name, pass.barriers != 0 ? " (barrier)" : "");
+        }
+        for (const auto& pass : graph.passes)
+        {
+            if (pass.culled)
+            {
+                ImGui::BulletText("%s (culled)", pass.name);
+            }
+        }
+
+        ImGui::Spacing();
+        for (const auto& texture : graph.textures)
+        {
+            if (texture.imported)
+            {
+                ImGui::Text("%s: imported", texture.name);
+            }
+            else if (texture.firstUse == FRAME_GRAPH_INVALID)
+            {
+                ImGui::Text("%s: unused", texture.name);
+            }
+            else
+            {
+                ImGui::Text("%s: passes %u-%u, texture %u", texture.name, texture.firstUse, texture.lastUse, texture.texture);
+            }
+        }
+
+        if (ImGui::Button("Dump Frame Graph"))
+        {
+            if (DumpFrameGraph(graph, "framegraph.dot"))
+            {
+                ILOG("Frame graph written to framegraph.dot");
+            }
+        }
+        ImGui::TreePop();
+    }
+}
+
+void ImGuiDynamicResolutionTab(App* app)
+{
+    if (ImGui::TreeNodeEx("Dynamic Resolution", ImGuiTreeNodeFlags_DefaultOpen))
+    {
+        DynamicResolution& resolution = app->dynamicResolution;
+
+        ImGui::Checkbox("Follow GPU frame time", &resolution.enabled);
+        ImGui::SliderFloat("Target (ms)", &resolution.targetGpuTime, 2.0f, 50.0f, "%.1f");
+        ImGui::SliderFloat("Min scale", &resolution.minScale, 0.25f, 1.0f, "%.2f");
+        ImGui::SliderFloat("Max scale", &resolution.maxScale, 0.25f, 1.0f, "%.2f");
+        resolution.minScale = glm::min(resolution.minScale, resolution.maxScale);
+
+        // Set by hand while the controller is off
+        if (!resolution.enabled)
+        {
+            ImGui::SliderFloat("Scale", &resolution.scale, 0.25f, 1.0f, "%.2f");
+        }
+        resolution.scale = glm::clamp(resolution.scale, resolution.minScale, resolution.maxScale);
+
+        if (app->mode != Mode_Forward_Geometry)
+        {
+            ImGui::Text("Only the deferred mode is scaled");
+        }
+        ImGui::Text("Scale %.2f: %dx%d of %dx%d, %u changes", resolution.scale, app->renderSize.x, app->renderSize.y,
+                    app->displaySize.x, app->displaySize.y, resolution.scaleChanges);
+        ImGui::Text("GPU frame: %.2f ms (%.2f ms smoothed)", resolution.gpuTime, resolution.smoothedGpuTime);
+
+        char overlay[32];
+        snprintf(overlay, sizeof(overlay), "target %.1f ms", resolution.targetGpuTime);
+        ImGui::PlotLines("GPU ms", resolution.gpuTimeHistory, DYNAMIC_RESOLUTION_HISTORY, resolution.historyOffset, overlay,
+                         0.0f, resolution.targetGpuTime * 2.0f, ImVec2(0.0f, 60.0f));
+        ImGui::PlotLines("Scale", resolution.scaleHistory, DYNAMIC_RESOLUTION_HISTORY, resolution.historyOffset, NULL,
+                         0.0f, 1.0f, ImVec2(0.0f, 60.0f));
         ImGui::TreePop();
     }
 }
@@ -951,81 +3182,95 @@ void ImGuiLightTab(App* app)
         {
             CreateLightStressTest(app);
         }
+        ImGui::SliderInt("Stress Lights", &app->stressLightCount, 16, 16384, "%d", ImGuiSliderFlags_Logarithmic);
 
-        bool lightChanged = false;
+        ImGui::Spacing();
 
-        for (auto& light : app->lights)
+        // Editing thousands of lights is not practical, keep the list folded by default
+        if (ImGui::TreeNode("Edit Lights"))
         {
-            ImGui::Text(light.name.c_str());
-            vec3 checkVector;
-            int checkInt;
-
-            ImGui::PushID(&light);
-            float color[3] = { light.color.x, light.color.y ,light.color.z };
-            ImGui::DragFloat3("Color", color, 0.01, 0.0, 1.0);
-            checkVector = vec3(color[0], color[1], color[2]);
+            bool lightChanged = false;
 
-            if (checkVector != light.color)
+            for (auto& light : app->lights)
             {
-                light.color = checkVector;
-                lightChanged = true;
-            }
+                ImGui::Text(light.name.c_str());
+                vec3 checkVector;
+                float checkFloat;
 
-            if (light.type == 0)
-            {
-                float direction[3] = { light.direction.x, light.direction.y ,light.direction.z };
-                ImGui::DragFloat3("Direction", direction, 0.01, -1.0, 1.0);
-                checkVector = vec3(direction[0], direction[1], direction[2]);
+                ImGui::PushID(&light);
+                float color[3] = { light.color.x, light.color.y ,light.color.z };
+                ImGui::DragFloat3("Color", color, 0.01, 0.0, 1.0);
+                checkVector = vec3(color[0], color[1], color[2]);
 
-                if (checkVector != light.direction)
+                if (checkVector != light.color)
                 {
-                    light.direction = checkVector;
+                    light.color = checkVector;
                     lightChanged = true;
                 }
-            }
-
-            if (light.type == 1) 
-            {
-                float position[3] = { light.position.x, light.position.y ,light.position.z };
-                ImGui::DragFloat3("Position", position);
-                checkVector = vec3(position[0], position[1], position[2]);
 
-                if (checkVector != light.position)
+                if (light.type == 0)
                 {
-                    light.position = checkVector;
-                    lightChanged = true;
-                }
+                    float direction[3] = { light.direction.x, light.direction.y ,light.direction.z };
+                    ImGui::DragFloat3("Direction", direction, 0.01, -1.0, 1.0);
+                    checkVector = vec3(direction[0], direction[1], direction[2]);
 
-                int intensity = light.intensity;
-                ImGui::DragInt("Intensity", &intensity, 1.0f, 1, 255);
-                checkInt = intensity;
+                    if (checkVector != light.direction)
+                    {
+                        light.direction = checkVector;
+                        lightChanged = true;
+                    }
+                }
 
-                if (checkInt != light.intensity)
+                if (light.type == 1) 
                 {
-                    light.intensity = checkInt;
-                    lightChanged = true;
-                }
+                    float position[3] = { light.position.x, light.position.y ,light.position.z };
+                    ImGui::DragFloat3("Position", position);
+                    checkVector = vec3(position[0], position[1], position[2]);
+
+                    if (checkVector != light.position)
+                    {
+                        light.position = checkVector;
+                        lightChanged = true;
+                    }
 
-                int range = light.range;
-                ImGui::DragInt("Range", &range, 1.0f, 1, 50);
-                checkInt = range;
+                    float intensity = light.intensity;
+                    ImGui::DragFloat("Intensity", &intensity, 1.0f, 0.01f, 255.0f);
+                    checkFloat = intensity;
 
-                if(checkInt != light.range)
-                {
-                    light.range = checkInt;
-                    lightChanged = true;
+                    if (checkFloat != light.intensity)
+                    {
+                        light.intensity = checkFloat;
+                        lightChanged = true;
+                    }
+
+                    float range = light.range;
+                    ImGui::DragFloat("Range", &range, 0.1f, 0.1f, 50.0f);
+                    checkFloat = range;
+
+                    if(checkFloat != light.range)
+                    {
+                        light.range = checkFloat;
+                        lightChanged = true;
+                    }
+
+                    app->queryResults.clear();
+                    QuerySphere(app->entityTree, light.position, light.range, app->queryResults);
+                    ImGui::Text("Entities in range: %d", (int)app->queryResults.size());
                 }
+
+                ImGui::PopID();
+
+                ImGui::Spacing();
+                ImGui::Separator();
+                ImGui::Spacing();
             }
 
-            ImGui::PopID();
             if (lightChanged)
             {
-                app->UpdateLights(app);
+                app->lightsDirty = true;
             }
 
-            ImGui::Spacing();
-            ImGui::Separator();
-            ImGui::Spacing();
+            ImGui::TreePop();
         }
 
         ImGui::TreePop();
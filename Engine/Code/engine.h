@@ -8,10 +8,17 @@
 #include "ModelLoader.h"
 #include "Camera.h"
 #include "BufferManagement.h"
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "ShaderReflection.h"
+#include "FrameGraph.h"
+#include "DynamicResolution.h"
+#include "BVH.h"
 
 #include <glad/glad.h>
 #include <stdexcept>
 #include <assert.h>
+#include <unordered_map>
 
 typedef glm::vec2  vec2;
 typedef glm::vec3  vec3;
@@ -48,17 +55,180 @@ struct Program
     GLuint             handle;
     std::string        filepath;
     std::string        programName;
-    u64                lastWriteTimestamp; // What is this for?
-    VertexShaderLayout vertexInputLayout;
+    u64                lastWriteTimestamp;  // Newest source file time, see ReloadChangedPrograms
+    std::vector<std::string> includes;      // Files pulled in by #include, see ReadShaderSource
+    bool               compute;
+    VertexShaderLayout vertexInputLayout;   // Sorted by location
+    u32                inputLayout;         // Interned in VaoCache::inputLayouts
+    ShaderReflection   reflection;          // Rebuilt whenever the program is relinked
+};
+
+// Vertex buffer binding point the arena of the submesh being drawn goes to
+#define VERTEX_ARENA_BINDING 0
+
+// SSBO the multi-draw shader reads the dequantization constants from, see
+// VertexDequantization
+#define VERTEX_ARENA_STORAGE_BINDING 3
+
+// VAO shared by every submesh of one vertex format (Submesh::vertexFormat)
+// drawn with one program input layout (Program::inputLayout). Only the
+// attribute formats are baked in, the arena buffers are switched when a
+// submesh from another arena is drawn, see BindVAOArenas.
+struct VaoCacheEntry
+{
+    GLuint handle;
+    u32 vertexArena;    // Currently bound, UINT32_MAX for none
+    u32 indexArena;
+};
+
+struct VaoCache
+{
+    std::unordered_map<u64, u32> lookup;            // vertexFormat << 32 | inputLayout -> entry
+    std::vector<VaoCacheEntry> entries;
+    std::vector<VertexShaderLayout> inputLayouts;
+
+    // This frame
+    u32 lookups;
+    u32 hits;
+    u32 arenaRebinds;
 };
 
 enum Mode
 {
     Mode_TexturedQuad,
     Mode_Forward_Geometry,
+    Mode_ClusteredForward,
     Mode_Count
 };
 
+// How the geometry pass hands its draws to the driver
+enum SubmissionMode
+{
+    SubmissionMode_Loop,              // One glDrawElements per submesh
+    SubmissionMode_MultiDrawIndirect, // glMultiDrawElementsIndirect per VAO/texture batch
+    SubmissionMode_Instanced,         // glDrawElementsInstanced per model/material group
+    SubmissionMode_GPUDriven,         // Compute shader culls and writes the indirect commands
+    SubmissionMode_GPUMeshlets,       // Same, culling every meshlet on its own
+    SubmissionMode_Count
+};
+
+// How the deferred lighting pass shades the G-buffer
+enum LightingMode
+{
+    LightingMode_FullscreenQuad, // Fragment shader evaluates every light per pixel
+    LightingMode_TiledCompute,   // Compute shader culls lights per 16x16 tile first
+    LightingMode_StencilVolumes, // Point lights drawn as stencil bounded sphere volumes
+    LightingMode_Count
+};
+
+// What the geometry pass writes for the lighting pass
+enum GBufferLayout
+{
+    GBufferLayout_Classic,  // RGBA16F albedo, normal, position and view direction
+    GBufferLayout_Compact,  // RGBA8 albedo, RG16 octahedral normal, position rebuilt from depth
+    GBufferLayout_Count
+};
+
+// Froxel grid of the clustered forward mode, must match CLUSTERED_FORWARD.glsl
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+// Per entity result of the culling passes
+enum EntityVisibility
+{
+    EntityVisibility_Culled,    // Outside the frustum
+    EntityVisibility_Visible,   // Drawn in the geometry pass
+    EntityVisibility_Occluded,  // Hidden behind last frame's depth, re-tested on the GPU after the geometry pass
+};
+
+// Widest pyramid level read back for the CPU occlusion test
+#define HIZ_READBACK_MAX_WIDTH 256
+
+// Occupancy counters written by the cluster light assignment shader
+struct ClusterStats
+{
+    u32 occupiedClusters;
+    u32 lightAssignments;
+    u32 maxLightsPerCluster;
+    u32 overflowedClusters; // Clusters that had more than MAX_LIGHTS_PER_CLUSTER lights
+};
+
+// Layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    u32 count;
+    u32 instanceCount;
+    u32 firstIndex;
+    u32 baseVertex;
+    u32 baseInstance;
+};
+
+// Entities sharing model and material, drawn with a single instanced call per submesh
+struct InstanceGroup
+{
+    u32 modelIndex;
+    u32 textureIndex;
+    u32 lod;
+    u32 firstInstance;
+    u32 instanceCount;
+};
+
+// Run of consecutive indirect commands that share VAO, arenas and texture
+struct IndirectBatch
+{
+    u32 vao;            // VaoCache entry
+    u32 vertexArena;
+    u32 indexArena;
+    GLuint texture;
+    u32 firstCommand;
+    u32 commandCount;
+};
+
+// Not part of the GL 4.3 headers we ship (GL 4.6 / ARB_indirect_parameters)
+#ifndef GL_PARAMETER_BUFFER_ARB
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+#endif
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC)(GLenum mode, GLenum type, const void* indirect, GLintptr drawcount, GLsizei maxdrawcount, GLsizei stride);
+
+// One submesh of one entity, culled and given a LOD on the GPU. Must match DrawTemplate in GPU_CULLING.glsl
+struct GPUDrawTemplate
+{
+    vec3 aabbMin;       // Submesh bounds, model space
+    u32 entityIndex;
+    vec3 aabbMax;
+    u32 batchIndex;
+    glm::vec4 meshSphere;   // Whole mesh bounding sphere, so every submesh of an entity picks the same LOD
+    u32 firstCommand;   // First command of the batch range
+    u32 baseVertex;     // Of the submesh in its vertex arena
+    u32 padding[2];
+    u32 lodIndexCount[MESH_LOD_COUNT];
+    u32 lodFirstIndex[MESH_LOD_COUNT];  // Into the index arena
+    f32 lodError[MESH_LOD_COUNT];       // Mesh errors, see Mesh::lodErrors
+};
+static_assert(sizeof(GPUDrawTemplate) == 112, "GPUDrawTemplate must match the DrawTemplate struct in the shaders");
+
+// One meshlet of one LOD of an entity, std430 layout
+struct GPUMeshletTemplate
+{
+    glm::vec4 sphere;       // Meshlet bounds, model space
+    glm::vec4 cone;         // Axis and cutoff, see Meshlet
+    vec3 coneApex;
+    u32 entityIndex;
+    glm::vec4 meshSphere;   // Whole mesh bounds, for the LOD selection
+    u32 batchIndex;
+    u32 firstCommand;       // First command of the batch range
+    u32 firstIndex;         // Into the index arena
+    u32 indexCount;
+    f32 lodMinError;        // Error of the LODs using these indices and of the next one:
+    f32 lodMaxError;        // drawn when only the first stays under the pixel threshold
+    u32 firstLod;           // Lowest LOD using these indices, LOD 0 alone is drawn without selection
+    u32 baseVertex;         // Of the submesh in its vertex arena
+};
+static_assert(sizeof(GPUMeshletTemplate) == 96, "GPUMeshletTemplate must match the MeshletTemplate struct in the shaders");
+
 // Textured Quad
 struct VertexV3U2
 {
@@ -71,8 +241,6 @@ struct Entity
     glm::mat4 worldMatrix;
     u32 modelIndex;
     u32 textureIndex;
-    u32 entityBufferOffset;
-    u32 entityBufferSize;
 };
 
 enum LightType
@@ -88,93 +256,39 @@ struct Light
     vec3 color;        
     vec3 direction;    
     vec3 position; 
-    int intensity;
-    int range;
+    float intensity;
+    float range;
 };
 
-struct FrameBuffer 
+// Light as stored in the lights SSBO (std430, no vec3 padding)
+struct GPULight
 {
-    GLuint handle;
-    std::vector<std::pair<GLenum,GLuint>> attachments;
-    GLuint depthHandle;
-
-    bool CreateFBO(const uint64_t aAtachments, const uint64_t displayWidth, const uint64_t displayHeight)
-    {
-        if (aAtachments > GL_MAX_COLOR_ATTACHMENTS) 
-        {
-            return false;
-        }
-
-        std::vector<GLenum> enums;
-        for (size_t i = 0; i < aAtachments; ++i)
-        {
-            GLuint colorAttachment;
-            glGenTextures(1, &colorAttachment);
-            glBindTexture(GL_TEXTURE_2D, colorAttachment);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, displayWidth, displayHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glBindTexture(GL_TEXTURE_2D, 0);
-
-            attachments.push_back({ GL_COLOR_ATTACHMENT0 + i, colorAttachment });
-            enums.push_back(GL_COLOR_ATTACHMENT0 + i);
-        }
-
-        glGenTextures(1, &depthHandle);
-        glBindTexture(GL_TEXTURE_2D, depthHandle);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, displayWidth, displayHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        glGenFramebuffers(1, &handle);
-        glBindFramebuffer(GL_FRAMEBUFFER, handle);
-        for (auto it = attachments.begin(); it != attachments.end(); ++it)
-        {
-            glFramebufferTexture(GL_FRAMEBUFFER, it->first, it->second, 0);
-        }
-
-        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthHandle, 0);
-
-        GLenum framebufferStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (framebufferStatus != GL_FRAMEBUFFER_COMPLETE)
-        {
-            const char* error = "";
-            switch (framebufferStatus) {
-            case GL_FRAMEBUFFER_UNDEFINED: error = "UNDEFINED"; break;
-            case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT: error = "INCOMPLETE_ATTACHMENT"; break;
-            case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT: error = "MISSING_ATTACHMENT"; break;
-            case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER: error = "INCOMPLETE_DRAW_BUFFER"; break;
-            case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER: error = "INCOMPLETE_READ_BUFFER"; break;
-            case GL_FRAMEBUFFER_UNSUPPORTED: error = "UNSUPPORTED"; break;
-            case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE: error = "INCOMPLETE_MULTISAMPLE"; break;
-            case GL_FRAMEBUFFER_INCOMPLETE_LAYER_TARGETS: error = "INCOMPLETE_LAYER_TARGETS"; break;
-            }
-            throw std::runtime_error(std::string("Framebuffer creation error: ") + error);
-        }
-
-        glDrawBuffers(enums.size(), enums.data());
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    }
-
-    void Clean()
-    {
-        glDeleteFramebuffers(1, &handle);
-        for (auto& texture : attachments) 
-        {
-            glDeleteTextures(1, &texture.second);
-            texture.second = 0;
-        }
-        attachments.clear();
-        glDeleteTextures(1, &depthHandle);
-        depthHandle = 0;
-    }
+    vec3 color;
+    f32 intensity;
+    vec3 direction;
+    f32 range;
+    vec3 position;
+    u32 type;
+};
+static_assert(sizeof(GPULight) == 48, "GPULight must match the Light struct in the shaders");
+
+// Frames without a resize after which the size counts as settled, see
+// App::oversizeWhileResizing
+#define RESIZE_SETTLE_FRAMES 30
+
+// Oversized targets are rounded up to a multiple of it
+#define RESIZE_TARGET_GRANULARITY 256
+
+// Most color attachments a G-buffer layout has, see GetGBufferFormats
+#define GBUFFER_MAX_ATTACHMENTS 4
+
+// The G-buffer of the frame as frame graph resources, see AddGBufferPass.
+// Passes writing it update the versions they were handed.
+struct GBufferResources
+{
+    FrameGraphResource attachments[GBUFFER_MAX_ATTACHMENTS];
+    u32 attachmentCount;
+    FrameGraphResource depth;
 };
 
 const VertexV3U2 vertices[] = {
@@ -212,6 +326,25 @@ struct App
     std::string mOpenGLInfo;
 
     ivec2 displaySize;
+
+    // --- Resize --- //
+    // The window callback only records the size, ApplyPendingResize applies
+    // the last one once per frame
+    ivec2 pendingDisplaySize;
+    bool resizePending;
+    u32 resizeRequestCount;         // Callbacks since the last applied resize
+    u32 coalescedResizeCount;       // Callbacks merged into the last applied resize
+    u32 framesSinceResize;
+    bool oversizeWhileResizing;     // Keep rounded up targets until the size settles
+    ivec2 renderTargetSize;         // Of the frame graph transients, displaySize or larger
+
+    // --- Dynamic Resolution --- //
+    // The deferred mode renders a renderSize corner of the transients, the
+    // final pass stretches it over the backbuffer
+    DynamicResolution dynamicResolution;
+    ivec2 renderSize;               // displaySize times the scale
+    u32 upscaleProgramIdx;          // Render Quad Program index
+    GLuint linearSampler;           // Bilinear filtering of the upscaled image
     
     std::vector<Mesh> meshes;
     std::vector<Material> materials;
@@ -241,7 +374,6 @@ struct App
 
     // --- Patrick Model --- //
     u32 patrickIdx; // Model Index
-    u32 textureUniform; // Texture Index
 
     // --- Repo Model --- //
     u32 repoBodyIdx; // Model Index
@@ -260,6 +392,7 @@ struct App
 
     // Mode
     Mode mode;
+    std::vector<std::string> ModeItems;
 
     // VAO object to link our screen filling quad with our textured quad shader
     GLuint vao;
@@ -273,9 +406,6 @@ struct App
     GLuint embeddedVertices;
     GLuint embeddedElements;
 
-    // Location of the texture uniform in the textured quad shader
-    GLuint programUniformTexture;
-
     // --- Camera --- //
     Camera camera;
 
@@ -283,13 +413,44 @@ struct App
     OpenGLInfo glInfo;
 
     // --- Uniform Buffers --- //
+    // Ring buffer with one region per frame in flight, rewritten every frame
     Buffer globalUBO;
-    Buffer entityUBO;
+    bool supportsBufferStorage;     // GL_ARB_buffer_storage
+    f64 uniformStallTime;           // ms the CPU waited on the GPU this frame
+
+    // --- Entities SSBO --- //
+    // World matrices indexed by entity, uploaded only when the entity list changes
+    Buffer entitySSBO;
+    bool entitiesDirty;
+
+    // --- Vertex Compression --- //
+    // Load time choice, see PackVertices
+    bool compressVertices;
+    u64 vertexMemory;           // Bytes of vertex data uploaded
+    u64 vertexMemoryFloat;      // Same data as 32 bit floats
+
+    // --- Geometry Arenas --- //
+    // Every mesh vertex and index, see UploadSubmeshGeometry
+    GeometryArenas geometryArenas;
+    VaoCache vaoCache;
 
     std::vector<Entity> entities;
     std::vector<Light> lights;
 
-    FrameBuffer primaryFBO;
+    // --- Lights SSBO --- //
+    Buffer lightSSBO;
+    bool lightsDirty;
+    u32 directionalLightCount;
+    int stressLightCount;
+
+    // --- Frame Graph --- //
+    // Render passes of the frame; the G-buffer and the lighting output are
+    // transients placed in the render target pool
+    FrameGraph frameGraph;
+    RenderTargetPool renderTargets;
+
+    GBufferLayout gBufferLayout;
+    std::vector<std::string> GBufferLayoutItems;
 
     std::vector<std::string> GBufferItems;
     int currentGBufferItem;
@@ -297,6 +458,110 @@ struct App
     bool lightDebug;
     std::vector<Entity> lightModels;
 
+    // --- Geometry Submission --- //
+    SubmissionMode submissionMode;
+    std::vector<std::string> SubmissionModeItems;
+    bool supportsDrawParameters;            // GL_ARB_shader_draw_parameters
+    u32 texturedMeshIndirectProgramIdx;     // Mesh Program index (indirect variant)
+    GLuint indirectBufferHandle;
+    std::vector<DrawElementsIndirectCommand> indirectCommands;
+    std::vector<IndirectBatch> indirectBatches;
+    f64 geometrySubmitTime; // CPU ms spent submitting the geometry pass
+
+    // --- GPU Driven Submission --- //
+    u32 cullDrawsProgramIdx;            // Compute Program index
+    u32 cullMeshletsProgramIdx;         // Compute Program index
+    bool meshletConeCulling;            // Backface culling of whole meshlets
+    bool supportsIndirectCount;         // GL_ARB_indirect_parameters
+    PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC glMultiDrawElementsIndirectCountARB;
+    bool gpuDrawsDirty;                 // Templates are rebuilt only when the entity list changes
+    bool gpuDrawsMeshlets;              // Templates hold meshlets rather than submeshes
+    u32 gpuDrawCount;
+    std::vector<IndirectBatch> gpuDrivenBatches;    // Fixed command range per VAO/texture
+    GLuint gpuDrawTemplatesHandle;
+    GLuint gpuCommandsHandle;           // Written by the culling shader
+    GLuint gpuBatchCountsHandle;        // Draw count of every batch
+    GLuint gpuCullingStatsHandle;
+    ReadbackBuffer gpuCullingStatsReadback;
+    u32 gpuVisibleDrawCount;            // Read back from an earlier frame
+
+    // --- Instancing --- //
+    u32 texturedMeshInstancedProgramIdx;    // Mesh Program index (instanced variant)
+    GLuint instanceBufferHandle;    // Entity index of every instance, grouped
+    std::vector<InstanceGroup> instanceGroups;
+
+    // --- Render Queue --- //
+    RenderQueue renderQueue;
+
+    // --- GL State --- //
+    GLStateCache glState;       // Render passes change the tracked state through it only
+
+    // --- Frustum Culling --- //
+    bool frustumCulling;
+    CullingBounds entityBounds;         // World space AABB per entity, updated with the transforms
+    std::vector<u8> entityVisibility;   // EntityVisibility of every entity this frame
+    u32 visibleEntityCount;
+    f64 cullingTime;                    // CPU ms spent culling this frame
+    bool instanceGroupsDirty;
+    CullingBenchmarkResult cullingBenchmark;
+
+    // --- Entity BVH --- //
+    DynamicAABBTree entityTree;         // Entity world bounds, for sphere and ray queries
+    std::vector<i32> entityProxies;     // Tree leaf of every entity
+    std::vector<u32> queryResults;      // Scratch list filled by tree queries
+    i32 pickedEntity;                   // Last entity hit by a mouse pick, -1 if none
+    BVHBenchmarkResult bvhBenchmarks[BVH_BENCHMARK_SIZES];
+
+    // --- Mesh LODs --- //
+    bool lodSelection;
+    f32 lodErrorThreshold;              // Largest simplification error allowed on screen, in pixels
+    std::vector<u8> entityLods;         // LOD drawn for every entity this frame
+    u32 lodHistogram[MESH_LOD_COUNT];   // Visible entities per LOD
+
+    // --- Hi-Z Occlusion Culling --- //
+    bool occlusionCulling;
+    u32 hiZCopyProgramIdx;              // Compute Program index
+    u32 hiZReduceProgramIdx;            // Compute Program index
+    u32 hiZTestProgramIdx;              // Compute Program index
+    GLuint hiZTexture;                  // R32F max depth pyramid of the G-buffer depth, full mip chain, from the render target pool
+    u32 hiZLevelCount;
+    ivec2 hiZSize;                      // renderSize it was acquired for
+    GLuint hiZReadbackBuffer;           // Pixel pack buffer the readback level is copied into
+    GLsync hiZReadbackFence;            // Readback in flight, 0 when there is none
+    u32 hiZPendingWidth;
+    u32 hiZPendingHeight;
+    glm::mat4 hiZPendingViewProjection;
+    DepthPyramidReadback hiZReadback;   // Last completed readback, tested against in the first phase
+    GLuint occlusionCommandsHandle;     // Indirect commands of the rejected draws, patched in the second phase
+    GLuint occlusionBoundsHandle;       // World AABB of every rejected draw
+    GLuint occlusionStatsHandle;        // Draws the second phase found visible
+    ReadbackBuffer occlusionStatsReadback;
+    std::vector<DrawElementsIndirectCommand> occlusionCommands;
+    std::vector<IndirectBatch> occlusionBatches;
+    std::vector<glm::vec4> occlusionBounds;
+    u32 occludedEntityCount;            // Rejected by the first phase this frame
+    u32 occlusionRetestedCount;         // Draws re-tested by the second phase (previous frame)
+    u32 occlusionRecoveredCount;        // Of those, the ones drawn after all (an earlier frame)
+
+    // --- Lighting Pass --- //
+    LightingMode lightingMode;
+    std::vector<std::string> LightingModeItems;
+    u32 tiledLightingProgramIdx;    // Compute Program index
+    u32 lightVolumeProgramIdx;      // Light volume Program index
+    vec3 lightVolumeCenter;         // Sphere model bounds, see ComputeLightVolumeBounds
+    f32 lightVolumeScale;
+    GLuint lightingTimeQuery;
+    f64 lightingGpuTime;            // GPU ms spent in the lighting pass (previous frame)
+
+    // --- Clustered Forward --- //
+    u32 clusterLightsProgramIdx;    // Compute Program index
+    u32 clusteredForwardProgramIdx; // Mesh Program index (forward shaded)
+    GLuint clusterLightCountsHandle;    // Light count per cluster
+    GLuint clusterLightIndicesHandle;   // MAX_LIGHTS_PER_CLUSTER light indices per cluster
+    GLuint clusterStatsHandle;
+    ClusterStats clusterStats;          // Read back from an earlier frame
+    ReadbackBuffer clusterStatsReadback;
+
     void UpdateLights(App* app);
 
     void UpdateCameraUniforms(App* app);
@@ -309,13 +574,22 @@ void Gui(App* app);
 
 void Update(App* app);
 
+// Relinks the programs whose shader file changed since it was last read
+void ReloadChangedPrograms(App* app);
+
 void Render(App* app);
 
 void Cleanup(App* app);
 
-GLuint FindVAO(Mesh& mesh, u32 submeshIndex, const Program& program);
+// VaoCache entry for the submesh format and the program input layout,
+// created the first time the pair is seen
+u32 FindVAO(App* app, const Submesh& submesh, const Program& program);
 
-void CreateVAO(Mesh& mesh, Submesh& submesh, const Program& program, GLuint& vaoHandle);
+// Points the bound VAO at the arenas, only when they differ from the last ones
+void BindVAOArenas(App* app, u32 vaoIdx, u32 vertexArena, u32 indexArena);
+
+// Dequantization constants of the submesh for the single draw calls
+void SetVertexConstants(const Submesh& submesh);
 
 OpenGLInfo GetOpenGLInfo(OpenGLInfo& glInfo);
 
@@ -326,6 +600,12 @@ void ImGuiCameraTab(App* app);
 
 void ImGuiGbufferTab(App* app);
 
+// Passes and transients of the last frame, and a Graphviz dump of them
+void ImGuiFrameGraph(App* app);
+
+// Render scale and the GPU frame times driving it
+void ImGuiDynamicResolutionTab(App* app);
+
 void ImGuiLightTab(App* app);
 
 void ImGuiGLInfoTab(App* app);
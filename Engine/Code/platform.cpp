@@ -423,3 +423,8 @@ void LogString(const char* str)
     fprintf(stderr, "%s\n", str);
 #endif
 }
+
+void* GetGLProcAddress(const char* name)
+{
+    return (void*)glfwGetProcAddress(name);
+}
@@ -89,6 +89,12 @@ u64 GetFileLastWriteTimestamp(const char *filepath);
  */
 void LogString(const char* str);
 
+/**
+ * It returns the address of an OpenGL entry point, or NULL if the current context
+ * does not provide it. Use it for functions newer than the ones loaded by glad.
+ */
+void* GetGLProcAddress(const char* name);
+
 #define ILOG(...)                 \
 {                                 \
 char logBuffer[1024] = {};        \
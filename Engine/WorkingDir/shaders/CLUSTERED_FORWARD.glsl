@@ -0,0 +1,242 @@
+
+#if defined(CLUSTER_LIGHTS) || defined(CLUSTERED_FORWARD)
+
+// Froxel grid: screen split in CLUSTER_X x CLUSTER_Y tiles and CLUSTER_Z
+// exponential depth slices. Must match the CLUSTER_GRID_* values on the CPU.
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define MAX_LIGHTS_PER_CLUSTER 128
+
+// Must match GPULight on the CPU side (48 bytes, std430)
+struct Light {
+    vec3 color;
+    float intensity;
+    vec3 direction;
+    float range;
+    vec3 position;
+    int type;
+};
+
+layout(binding = 0, std140) uniform GlobalParams 
+{
+    mat4 uViewProjection;
+    vec3 uCameraPosition;
+    int uLightCount;
+    int uDirectionalLightCount; // Directional lights come first in uLight
+    int uCompactGBuffer;        // GBufferLayout_Compact
+    mat4 uInverseViewProjection;
+    ivec2 uViewportSize;        // Of the frame, the render targets may be larger
+};
+
+layout(binding = 2, std430) readonly buffer Lights
+{
+    Light uLight[];
+};
+
+uniform float uNear;
+uniform float uFar;
+
+// Depth slice containing the given positive view space depth
+uint DepthSlice(float aViewDepth)
+{
+    float slice = log(aViewDepth / uNear) / log(uFar / uNear) * float(CLUSTER_Z);
+    return uint(clamp(slice, 0.0, float(CLUSTER_Z - 1)));
+}
+
+#if defined(COMPUTE) //////////////////////////////////////////////////
+
+// One invocation per cluster: build its view space AABB and gather
+// the lights touching it into its fixed slot of the index list.
+
+layout(local_size_x = 64) in;
+
+layout(binding = 5, std430) writeonly buffer ClusterLightCounts
+{
+    uint uClusterLightCount[];
+};
+
+layout(binding = 6, std430) writeonly buffer ClusterLightIndices
+{
+    uint uClusterLightIndex[];
+};
+
+// Must match ClusterStats on the CPU side
+layout(binding = 7, std430) buffer ClusterStatsBuffer
+{
+    uint uOccupiedClusters;
+    uint uLightAssignments;
+    uint uMaxLightsPerCluster;
+    uint uOverflowedClusters;
+};
+
+uniform mat4 uView;
+uniform mat4 uInverseProjection;
+
+// View space point where the ray through the given NDC coordinates reaches aViewDepth
+vec3 PointAtDepth(vec2 aNdc, float aViewDepth)
+{
+    vec4 point = uInverseProjection * vec4(aNdc, 1.0, 1.0);
+    vec3 ray = point.xyz / point.w;
+    return ray * (aViewDepth / -ray.z);
+}
+
+bool SphereIntersectsAABB(vec3 aCenter, float aRadius, vec3 aMin, vec3 aMax)
+{
+    vec3 closest = clamp(aCenter, aMin, aMax);
+    vec3 delta = closest - aCenter;
+    return dot(delta, delta) <= aRadius * aRadius;
+}
+
+void main()
+{
+    uint clusterIndex = gl_GlobalInvocationID.x;
+    if (clusterIndex >= CLUSTER_COUNT)
+    {
+        return;
+    }
+
+    uvec3 cluster = uvec3(clusterIndex % CLUSTER_X,
+                          (clusterIndex / CLUSTER_X) % CLUSTER_Y,
+                          clusterIndex / (CLUSTER_X * CLUSTER_Y));
+
+    // --- Cluster bounds --- //
+    vec2 ndcMin = vec2(cluster.xy) / vec2(CLUSTER_X, CLUSTER_Y) * 2.0 - 1.0;
+    vec2 ndcMax = vec2(cluster.xy + 1u) / vec2(CLUSTER_X, CLUSTER_Y) * 2.0 - 1.0;
+    float depthNear = uNear * pow(uFar / uNear, float(cluster.z) / float(CLUSTER_Z));
+    float depthFar = uNear * pow(uFar / uNear, float(cluster.z + 1u) / float(CLUSTER_Z));
+
+    vec3 aabbMin = vec3(1e30);
+    vec3 aabbMax = vec3(-1e30);
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 ndc = vec2((i & 1) == 0 ? ndcMin.x : ndcMax.x, (i & 2) == 0 ? ndcMin.y : ndcMax.y);
+        vec3 nearPoint = PointAtDepth(ndc, depthNear);
+        vec3 farPoint = PointAtDepth(ndc, depthFar);
+        aabbMin = min(aabbMin, min(nearPoint, farPoint));
+        aabbMax = max(aabbMax, max(nearPoint, farPoint));
+    }
+
+    // --- Light assignment --- //
+    uint count = 0u;
+    uint overflow = 0u;
+    for (uint i = 0u; i < uint(uLightCount); ++i)
+    {
+        Light light = uLight[i];
+        bool visible = true;
+
+        if (light.type == 1)
+        {
+            vec3 position = (uView * vec4(light.position, 1.0)).xyz;
+            visible = SphereIntersectsAABB(position, light.range, aabbMin, aabbMax);
+        }
+
+        if (visible)
+        {
+            if (count < MAX_LIGHTS_PER_CLUSTER)
+            {
+                uClusterLightIndex[clusterIndex * MAX_LIGHTS_PER_CLUSTER + count] = i;
+                ++count;
+            }
+            else
+            {
+                overflow = 1u;
+            }
+        }
+    }
+
+    uClusterLightCount[clusterIndex] = count;
+
+    if (count > 0u)
+    {
+        atomicAdd(uOccupiedClusters, 1u);
+        atomicAdd(uLightAssignments, count);
+        atomicMax(uMaxLightsPerCluster, count);
+        atomicAdd(uOverflowedClusters, overflow);
+    }
+}
+
+#elif defined(VERTEX) /////////////////////////////////////////////////
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+layout(location = 3) in vec3 aTangent;
+layout(location = 4) in vec3 aBitangent;
+layout(location = 5) in vec4 aPositionDequantize;   // Per draw generic value, see SetVertexConstants
+layout(location = 6) in vec4 aTexCoordDequantize;
+
+// World matrices of every entity, tightly packed and indexed by entity
+layout(binding = 1, std430) readonly buffer EntityTransforms
+{
+    mat4 uEntityWorldMatrix[];
+};
+
+uniform uint uEntityIndex;
+
+out vec2 vTexCoord;
+out vec3 vPosition;
+out vec3 vNormal;
+out vec3 vViewDir;
+
+void main()
+{
+    mat4 worldMatrix = uEntityWorldMatrix[uEntityIndex];
+
+    vec3 position = aPositionDequantize.xyz + aPosition * aPositionDequantize.w;
+
+    vTexCoord = aTexCoordDequantize.xy + aTexCoord * aTexCoordDequantize.zw;
+    vPosition = vec3(worldMatrix * vec4(position, 1.0));
+    vNormal = vec3(worldMatrix * vec4(aNormal, 0.0));
+    vViewDir = uCameraPosition - vPosition;
+    gl_Position = uViewProjection * worldMatrix * vec4(position, 1.0);
+}
+
+#elif defined(FRAGMENT) ///////////////////////////////////////////////
+
+layout(binding = 5, std430) readonly buffer ClusterLightCounts
+{
+    uint uClusterLightCount[];
+};
+
+layout(binding = 6, std430) readonly buffer ClusterLightIndices
+{
+    uint uClusterLightIndex[];
+};
+
+in vec2 vTexCoord;
+in vec3 vPosition;
+in vec3 vNormal;
+in vec3 vViewDir;
+
+uniform sampler2D uTexture;
+uniform vec2 uScreenSize;
+
+layout(location = 0) out vec4 oColor;
+
+#include "LIGHTING.glsl"
+
+void main()
+{
+    vec3 Color = texture(uTexture, vTexCoord).rgb;
+    vec3 Normal = normalize(vNormal);
+
+    float viewDepth = (uNear * uFar) / (uFar - gl_FragCoord.z * (uFar - uNear));
+    uvec2 tile = uvec2(gl_FragCoord.xy / uScreenSize * vec2(CLUSTER_X, CLUSTER_Y));
+    tile = min(tile, uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    uint clusterIndex = tile.x + tile.y * CLUSTER_X + DepthSlice(viewDepth) * CLUSTER_X * CLUSTER_Y;
+
+    vec3 returnColor = vec3(0.0);
+    uint lightCount = uClusterLightCount[clusterIndex];
+    for (uint i = 0u; i < lightCount; ++i)
+    {
+        uint lightIndex = uClusterLightIndex[clusterIndex * MAX_LIGHTS_PER_CLUSTER + i];
+        returnColor += CalcLight(uLight[lightIndex], Normal, vPosition, vViewDir) * Color;
+    }
+
+    oColor = vec4(returnColor, 1.0);
+}
+
+#endif
+#endif
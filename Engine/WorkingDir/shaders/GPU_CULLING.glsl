@@ -0,0 +1,214 @@
+
+#if defined(CULL_DRAWS) || defined(CULL_MESHLETS)
+
+#if defined(COMPUTE) /////////////////////////////////////////////////
+
+// GPU driven submission: one invocation per submesh (CULL_DRAWS) or per
+// meshlet (CULL_MESHLETS) of every entity. The bounds are moved to world
+// space with the entity transform and tested, and the survivors are
+// appended to the command range of their VAO/texture batch.
+
+#define MESH_LOD_COUNT 4
+
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+layout(binding = 1, std430) readonly buffer EntityTransforms
+{
+    mat4 uEntityWorldMatrix[];
+};
+
+layout(binding = 12, std430) writeonly buffer Commands
+{
+    DrawCommand uCommands[];
+};
+
+// Commands written into every batch range, used as the draw count
+layout(binding = 13, std430) buffer BatchCounts
+{
+    uint uBatchCount[];
+};
+
+layout(binding = 14, std430) buffer CullingStats
+{
+    uint uVisibleDraws;
+};
+
+uniform uint uDrawCount;
+uniform int uFrustumCulling;
+uniform vec4 uFrustumPlanes[6]; // Normals pointing inwards
+uniform vec3 uCameraPosition;
+uniform float uNear;
+uniform float uLodScale;        // Pixels per world unit at distance one, 0 to always draw LOD 0
+uniform float uLodThreshold;    // Largest error allowed on screen, in pixels
+
+// Same as GetLodProjectionScale and SelectEntityLods on the CPU: pixels one
+// object space unit of the mesh covers at its point closest to the camera
+float PixelsPerUnit(mat4 world, vec4 meshSphere)
+{
+    float worldScale = max(length(world[0].xyz), max(length(world[1].xyz), length(world[2].xyz)));
+    vec3 sphereCenter = (world * vec4(meshSphere.xyz, 1.0)).xyz;
+    float distance = max(length(sphereCenter - uCameraPosition) - meshSphere.w * worldScale, uNear);
+    return uLodScale * worldScale / distance;
+}
+
+#if defined(CULL_DRAWS)
+
+// Must match GPUDrawTemplate on the CPU side (112 bytes, std430)
+struct DrawTemplate {
+    vec3 aabbMin;       // Submesh bounds, model space
+    uint entityIndex;
+    vec3 aabbMax;
+    uint batchIndex;
+    vec4 meshSphere;    // Whole mesh bounds, model space
+    uint firstCommand;  // First command of the batch range
+    uint baseVertex;
+    uint padding0;
+    uint padding1;
+    uint lodIndexCount[MESH_LOD_COUNT];
+    uint lodFirstIndex[MESH_LOD_COUNT];
+    float lodError[MESH_LOD_COUNT];
+};
+
+layout(binding = 11, std430) readonly buffer DrawTemplates
+{
+    DrawTemplate uDraws[];
+};
+
+void main()
+{
+    uint drawIndex = gl_GlobalInvocationID.x;
+    if (drawIndex >= uDrawCount)
+    {
+        return;
+    }
+
+    DrawTemplate draw = uDraws[drawIndex];
+    mat4 world = uEntityWorldMatrix[draw.entityIndex];
+
+    bool visible = true;
+    if (uFrustumCulling != 0)
+    {
+        vec3 center = (draw.aabbMin + draw.aabbMax) * 0.5;
+        vec3 extent = (draw.aabbMax - draw.aabbMin) * 0.5;
+
+        vec3 worldCenter = (world * vec4(center, 1.0)).xyz;
+        vec3 worldExtent = mat3(abs(world[0].xyz), abs(world[1].xyz), abs(world[2].xyz)) * extent;
+
+        for (int p = 0; p < 6 && visible; ++p)
+        {
+            vec4 plane = uFrustumPlanes[p];
+            visible = dot(plane.xyz, worldCenter) + dot(abs(plane.xyz), worldExtent) + plane.w >= 0.0;
+        }
+    }
+
+    if (visible)
+    {
+        // Same selection as SelectEntityLods on the CPU
+        uint lod = 0u;
+        if (uLodScale > 0.0)
+        {
+            float pixelsPerUnit = PixelsPerUnit(world, draw.meshSphere);
+            while (lod + 1u < MESH_LOD_COUNT && draw.lodError[lod + 1u] * pixelsPerUnit <= uLodThreshold)
+            {
+                lod++;
+            }
+        }
+
+        uint slot = atomicAdd(uBatchCount[draw.batchIndex], 1u);
+        uCommands[draw.firstCommand + slot] = DrawCommand(draw.lodIndexCount[lod], 1u, draw.lodFirstIndex[lod], draw.baseVertex, draw.entityIndex);
+        atomicAdd(uVisibleDraws, 1u);
+    }
+}
+
+#elif defined(CULL_MESHLETS)
+
+// Must match GPUMeshletTemplate on the CPU side (96 bytes, std430)
+struct MeshletTemplate {
+    vec4 sphere;        // Meshlet bounds, model space
+    vec4 cone;          // Normal cone axis and cutoff, model space
+    vec3 coneApex;
+    uint entityIndex;
+    vec4 meshSphere;    // Whole mesh bounds, model space
+    uint batchIndex;
+    uint firstCommand;  // First command of the batch range
+    uint firstIndex;
+    uint count;
+    float lodMinError;  // Error of the LODs using these indices
+    float lodMaxError;  // Error of the next LOD
+    uint firstLod;
+    uint baseVertex;
+};
+
+layout(binding = 11, std430) readonly buffer MeshletTemplates
+{
+    MeshletTemplate uMeshlets[];
+};
+
+uniform int uConeCulling;
+
+void main()
+{
+    uint meshletIndex = gl_GlobalInvocationID.x;
+    if (meshletIndex >= uDrawCount)
+    {
+        return;
+    }
+
+    MeshletTemplate meshlet = uMeshlets[meshletIndex];
+    mat4 world = uEntityWorldMatrix[meshlet.entityIndex];
+
+    // Every LOD has its own meshlets, only the ones of the selected LOD go on
+    bool selected = meshlet.firstLod == 0u;
+    if (uLodScale > 0.0)
+    {
+        float pixelsPerUnit = PixelsPerUnit(world, meshlet.meshSphere);
+        selected = meshlet.lodMinError * pixelsPerUnit <= uLodThreshold && meshlet.lodMaxError * pixelsPerUnit > uLodThreshold;
+    }
+    if (!selected)
+    {
+        return;
+    }
+
+    vec3 scale = vec3(length(world[0].xyz), length(world[1].xyz), length(world[2].xyz));
+    float maxScale = max(scale.x, max(scale.y, scale.z));
+
+    bool visible = true;
+    if (uFrustumCulling != 0)
+    {
+        vec3 center = (world * vec4(meshlet.sphere.xyz, 1.0)).xyz;
+        float radius = meshlet.sphere.w * maxScale;
+        for (int p = 0; p < 6 && visible; ++p)
+        {
+            visible = dot(uFrustumPlanes[p].xyz, center) + uFrustumPlanes[p].w >= -radius;
+        }
+    }
+
+    // Angles only survive uniform scales, skewed cones are not tested
+    bool uniformScale = maxScale - min(scale.x, min(scale.y, scale.z)) <= maxScale * 0.01;
+    if (visible && uConeCulling != 0 && meshlet.cone.w < 1.0 && uniformScale)
+    {
+        vec3 apex = (world * vec4(meshlet.coneApex, 1.0)).xyz;
+        vec3 axis = normalize(mat3(world) * meshlet.cone.xyz);
+        visible = dot(normalize(apex - uCameraPosition), axis) < meshlet.cone.w;
+    }
+
+    if (visible)
+    {
+        uint slot = atomicAdd(uBatchCount[meshlet.batchIndex], 1u);
+        uCommands[meshlet.firstCommand + slot] = DrawCommand(meshlet.count, 1u, meshlet.firstIndex, meshlet.baseVertex, meshlet.entityIndex);
+        atomicAdd(uVisibleDraws, 1u);
+    }
+}
+
+#endif
+
+#endif
+#endif
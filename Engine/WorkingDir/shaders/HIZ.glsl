@@ -0,0 +1,170 @@
+
+#if defined(HIZ_COPY) || defined(HIZ_REDUCE) || defined(HIZ_OCCLUSION_TEST)
+
+#if defined(COMPUTE) /////////////////////////////////////////////////
+
+#if defined(HIZ_COPY)
+
+// Level 0 of the pyramid: the G-buffer depth as it is
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D uDepth;
+
+layout(binding = 0, r32f) writeonly uniform image2D uOutput;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, imageSize(uOutput))))
+    {
+        return;
+    }
+
+    imageStore(uOutput, texel, vec4(texelFetch(uDepth, texel, 0).r));
+}
+
+#elif defined(HIZ_REDUCE)
+
+// Every texel keeps the farthest depth of the texels it covers in the level
+// above. Odd sizes make a texel cover three rows or columns, never fewer,
+// so nothing drawn on the previous level is lost.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = 0, r32f) readonly uniform image2D uInput;
+layout(binding = 1, r32f) writeonly uniform image2D uOutput;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 outputSize = imageSize(uOutput);
+    if (any(greaterThanEqual(texel, outputSize)))
+    {
+        return;
+    }
+
+    ivec2 inputSize = imageSize(uInput);
+    ivec2 first = (texel * inputSize) / outputSize;
+    ivec2 last = min(((texel + 1) * inputSize + outputSize - 1) / outputSize, inputSize);
+
+    float maxDepth = 0.0;
+    for (int y = first.y; y < last.y; ++y)
+    {
+        for (int x = first.x; x < last.x; ++x)
+        {
+            maxDepth = max(maxDepth, imageLoad(uInput, ivec2(x, y)).r);
+        }
+    }
+
+    imageStore(uOutput, texel, vec4(maxDepth));
+}
+
+#elif defined(HIZ_OCCLUSION_TEST)
+
+// Second phase of the occlusion culling: the draws rejected against last
+// frame's depth are tested against the pyramid of the current frame, and
+// the ones that turn out visible get their instance count set so the
+// following indirect draw picks them up.
+
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    uint baseVertex;
+    uint baseInstance;
+};
+
+layout(binding = 8, std430) buffer Commands
+{
+    DrawCommand uCommands[];
+};
+
+// World space AABB of every command, min and max
+layout(binding = 9, std430) readonly buffer CommandBounds
+{
+    vec4 uBounds[];
+};
+
+layout(binding = 10, std430) buffer OcclusionStats
+{
+    uint uRecoveredCount;
+};
+
+uniform sampler2D uPyramid;
+uniform mat4 uViewProjection;
+uniform uint uCommandCount;
+
+bool IsVisible(vec3 aMin, vec3 aMax)
+{
+    vec3 ndcMin = vec3(1.0);
+    vec3 ndcMax = vec3(-1.0);
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        vec3 position = vec3((corner & 1) != 0 ? aMax.x : aMin.x,
+                             (corner & 2) != 0 ? aMax.y : aMin.y,
+                             (corner & 4) != 0 ? aMax.z : aMin.z);
+        vec4 clip = uViewProjection * vec4(position, 1.0);
+        if (clip.w <= 0.0)
+        {
+            return true; // Crosses the near plane
+        }
+
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = corner == 0 ? ndc : min(ndcMin, ndc);
+        ndcMax = corner == 0 ? ndc : max(ndcMax, ndc);
+    }
+
+    float nearestDepth = ndcMin.z * 0.5 + 0.5;
+    if (nearestDepth <= 0.0)
+    {
+        return true;
+    }
+
+    vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+    vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+
+    // Level where the rectangle spans at most 2x2 texels
+    vec2 baseSize = vec2(textureSize(uPyramid, 0));
+    vec2 rectSize = (uvMax - uvMin) * baseSize;
+    int levelCount = textureQueryLevels(uPyramid);
+    int level = clamp(int(ceil(log2(max(max(rectSize.x, rectSize.y), 1.0)))), 0, levelCount - 1);
+
+    ivec2 levelSize = textureSize(uPyramid, level);
+    ivec2 first = min(ivec2(uvMin * vec2(levelSize)), levelSize - 1);
+    ivec2 last = min(ivec2(uvMax * vec2(levelSize)), levelSize - 1);
+
+    float maxDepth = 0.0;
+    for (int y = first.y; y <= last.y; ++y)
+    {
+        for (int x = first.x; x <= last.x; ++x)
+        {
+            maxDepth = max(maxDepth, texelFetch(uPyramid, ivec2(x, y), level).r);
+        }
+    }
+
+    return nearestDepth <= maxDepth;
+}
+
+void main()
+{
+    uint commandIndex = gl_GlobalInvocationID.x;
+    if (commandIndex >= uCommandCount)
+    {
+        return;
+    }
+
+    bool visible = IsVisible(uBounds[commandIndex * 2u].xyz, uBounds[commandIndex * 2u + 1u].xyz);
+    uCommands[commandIndex].instanceCount = visible ? 1u : 0u;
+    if (visible)
+    {
+        atomicAdd(uRecoveredCount, 1u);
+    }
+}
+
+#endif
+
+#endif
+#endif
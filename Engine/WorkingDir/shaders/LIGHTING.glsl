@@ -0,0 +1,56 @@
+// Light evaluation shared by the deferred and the clustered forward shaders,
+// pulled in with #include (see ReadShaderSource). Expects the Light struct
+// of the lights buffer to be declared first.
+
+vec3 CalcPointLight(Light alight, vec3 aNormal, vec3 aPosition, vec3 aViewDir)
+{
+    vec3 lightDir = normalize(alight.position - aPosition);
+    vec3 viewDir = normalize(aViewDir);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    
+    // Diffuse
+    float diff = max(dot(aNormal, lightDir), 0.0);
+    
+    // Specular (Blinn-Phong)
+    float spec = pow(max(dot(aNormal, halfwayDir), 0.0), 32.0);
+    
+    // Attenuation
+    float distance = length(alight.position - aPosition);
+    float attenuation = clamp(1.0 - distance/alight.range, 0.0, 1.0);
+    attenuation *= attenuation * 1.0 / (distance * distance + 1.0);
+    
+    // Combine all components and apply attenuation & intensity
+    vec3 ambient = alight.color * 0.1;
+    vec3 diffuse = alight.color * diff * 0.8;
+    vec3 specular = alight.color * spec * 0.5;
+    
+    vec3 result = (ambient + diffuse + specular) * attenuation;
+    return result * alight.intensity;
+}
+
+vec3 CalcDirLight(Light alight, vec3 aNormal, vec3 aViewDir)
+{
+    vec3 lightDir = -normalize(alight.direction); // Ensure direction is normalized
+    vec3 halfwayDir = normalize(lightDir + normalize(aViewDir));
+    
+    float diff = max(dot(aNormal, lightDir), 0.0);
+    float spec = pow(max(dot(aNormal, halfwayDir), 0.0), 64.0);
+    
+    // Apply intensity to all components
+    vec3 result = alight.color * (0.1 + diff * 0.7 + spec * 0.2);
+    return result * alight.intensity;
+}
+
+vec3 CalcLight(Light alight, vec3 aNormal, vec3 aPosition, vec3 aViewDir)
+{
+    if(alight.type == 0)
+    {
+        return CalcDirLight(alight, aNormal, aViewDir);
+        // lightResult * SSAO
+    }
+    else if(alight.type == 1)
+    {
+        return CalcPointLight(alight, aNormal, aPosition, aViewDir);
+    }
+    return vec3(0.0);
+}
@@ -1,5 +1,20 @@
 
-#ifdef RENDER_GEOMETRY
+#if defined(RENDER_GEOMETRY) || defined(RENDER_GEOMETRY_INDIRECT) || defined(RENDER_GEOMETRY_INSTANCED)
+
+#if defined(VERTEX) && defined(RENDER_GEOMETRY_INDIRECT)
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+layout(binding = 0, std140) uniform GlobalParams 
+{
+    mat4 uViewProjection;
+    vec3 uCameraPosition;
+    int uLightCount;
+    int uDirectionalLightCount; // Directional lights come first in uLight
+    int uCompactGBuffer;        // GBufferLayout_Compact
+    mat4 uInverseViewProjection;
+    ivec2 uViewportSize;        // Of the frame, the render targets may be larger
+};
 
 #if defined(VERTEX) ///////////////////////////////////////////////////
 
@@ -8,29 +23,39 @@ layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 layout(location = 3) in vec3 aTangent;
 layout(location = 4) in vec3 aBitangent;
+#if !defined(RENDER_GEOMETRY_INDIRECT)
+layout(location = 5) in vec4 aPositionDequantize;   // Per draw generic value, see SetVertexConstants
+layout(location = 6) in vec4 aTexCoordDequantize;
+#endif
 
-struct Light {
-    int type;
-    vec3 color;
-    vec3 direction;
-    vec3 position;
-    int intensity;
-    int range;
+// World matrices of every entity, tightly packed and indexed by entity
+layout(binding = 1, std430) readonly buffer EntityTransforms
+{
+    mat4 uEntityWorldMatrix[];
 };
 
-layout(binding = 0, std140) uniform GlobalParams 
+#if defined(RENDER_GEOMETRY_INSTANCED)
+// Entity index of every instance, grouped by model and material.
+// uInstanceOffset is the first instance of the group being drawn.
+layout(binding = 4, std430) readonly buffer InstanceEntities
 {
-    vec3 uCameraPosition;
-    int uLightCount;
-    Light uLight[16];
+    uint uInstanceEntity[];
 };
 
-layout(binding = 1, std140) uniform EntityParams 
+uniform uint uInstanceOffset;
+#elif defined(RENDER_GEOMETRY_INDIRECT)
+// The vertex arena of the batch, read as floats. The dequantization constants
+// of every submesh fill the whole vertices right before its base vertex.
+layout(binding = 3, std430) readonly buffer VertexArena
 {
-    mat4 uWorldMatrix;
-    mat4 uWorldViewProjectionMatrix;
+    float uVertexArena[];
 };
 
+uniform uint uVertexStride;     // In floats
+#else
+uniform uint uEntityIndex;
+#endif
+
 out vec2 vTexCoord;
 out vec3 vPosition;
 out vec3 vNormal;
@@ -38,11 +63,31 @@ out vec3 vViewDir;
 
 void main()
 {
-    vTexCoord = aTexCoord;
-    vPosition = vec3(uWorldMatrix * vec4(aPosition, 1.0));
-    vNormal = vec3(uWorldMatrix * vec4(aNormal, 0.0));
+#if defined(RENDER_GEOMETRY_INDIRECT)
+    uint entityIndex = uint(gl_BaseInstanceARB);
+#elif defined(RENDER_GEOMETRY_INSTANCED)
+    uint entityIndex = uInstanceEntity[uInstanceOffset + uint(gl_InstanceID)];
+#else
+    uint entityIndex = uEntityIndex;
+#endif
+
+    mat4 worldMatrix = uEntityWorldMatrix[entityIndex];
+    mat4 worldViewProjectionMatrix = uViewProjection * worldMatrix;
+
+#if defined(RENDER_GEOMETRY_INDIRECT)
+    uint constantsVertices = (8u + uVertexStride - 1u) / uVertexStride;
+    uint constants = (uint(gl_BaseVertexARB) - constantsVertices) * uVertexStride;
+    vec4 aPositionDequantize = vec4(uVertexArena[constants + 0u], uVertexArena[constants + 1u], uVertexArena[constants + 2u], uVertexArena[constants + 3u]);
+    vec4 aTexCoordDequantize = vec4(uVertexArena[constants + 4u], uVertexArena[constants + 5u], uVertexArena[constants + 6u], uVertexArena[constants + 7u]);
+#endif
+
+    vec3 position = aPositionDequantize.xyz + aPosition * aPositionDequantize.w;
+
+    vTexCoord = aTexCoordDequantize.xy + aTexCoord * aTexCoordDequantize.zw;
+    vPosition = vec3(worldMatrix * vec4(position, 1.0));
+    vNormal = vec3(worldMatrix * vec4(aNormal, 0.0));
     vViewDir = uCameraPosition - vPosition;
-    gl_Position = uWorldViewProjectionMatrix * vec4(aPosition, 1.0);
+    gl_Position = worldViewProjectionMatrix * vec4(position, 1.0);
 }
 
 #elif defined(FRAGMENT) ///////////////////////////////////////////////
@@ -54,15 +99,25 @@ in vec3 vViewDir;
 
 uniform sampler2D uTexture;
 
+// The compact G-buffer has no position and view direction targets, the
+// writes to them are dropped and the lighting rebuilds both from depth
 layout(location = 0) out vec4 oColor;
 layout(location = 1) out vec4 oNormals;
 layout(location = 2) out vec4 oPosition;
 layout(location = 3) out vec4 oViewDir;
 
+// Unit vector to the octahedron unfolded on [0, 1]^2, see DecodeOctahedral
+vec2 EncodeOctahedral(vec3 aNormal)
+{
+    vec3 n = aNormal / (abs(aNormal.x) + abs(aNormal.y) + abs(aNormal.z));
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
 void main()
 {
     oColor = texture(uTexture, vTexCoord);
-    oNormals = vec4(vNormal, 0.0);
+    oNormals = uCompactGBuffer != 0 ? vec4(EncodeOctahedral(normalize(vNormal)), 0.0, 0.0) : vec4(vNormal, 0.0);
     oPosition = vec4(vPosition, 0.0);
     oViewDir = vec4(vViewDir, 0.0);
 }
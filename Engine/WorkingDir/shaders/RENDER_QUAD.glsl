@@ -1,8 +1,60 @@
 
-#ifdef TEXTURED_GEOMETRY
+#if defined(TEXTURED_GEOMETRY) || defined(TILED_LIGHTING) || defined(LIGHT_VOLUME)
+
+// Must match GPULight on the CPU side (48 bytes, std430)
+struct Light {
+    vec3 color;
+    float intensity;
+    vec3 direction;
+    float range;
+    vec3 position;
+    int type;
+};
+
+layout(binding = 0, std140) uniform GlobalParams 
+{
+    mat4 uViewProjection;
+    vec3 uCameraPosition;
+    int uLightCount;
+    int uDirectionalLightCount; // Directional lights come first in uLight
+    int uCompactGBuffer;        // GBufferLayout_Compact
+    mat4 uInverseViewProjection;
+    ivec2 uViewportSize;        // Of the frame, the render targets may be larger
+};
+
+layout(binding = 2, std430) readonly buffer Lights
+{
+    Light uLight[];
+};
 
 #if defined(VERTEX) ///////////////////////////////////////////////////
 
+#if defined(LIGHT_VOLUME)
+
+// A sphere scaled to the light range. Lights are drawn one at a time with
+// uFirstLight set to theirs, instances index the following ones.
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 5) in vec4 aPositionDequantize;   // Per draw generic value, see SetVertexConstants
+
+uniform int uFirstLight;
+uniform vec3 uVolumeCenter; // Bounding sphere of the volume mesh
+uniform float uVolumeScale; // Mesh scale for a range of 1
+
+flat out int vLightIndex;
+
+void main()
+{
+    vLightIndex = uFirstLight + gl_InstanceID;
+    Light light = uLight[vLightIndex];
+
+    vec3 position = aPositionDequantize.xyz + aPosition * aPositionDequantize.w;
+    vec3 worldPosition = light.position + (position - uVolumeCenter) * light.range * uVolumeScale;
+    gl_Position = uViewProjection * vec4(worldPosition, 1.0);
+}
+
+#else
+
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec2 aTexCoord;
 
@@ -14,101 +66,108 @@ void main()
     gl_Position = vec4(aPosition, 1.0);
 }
 
-#elif defined(FRAGMENT) ///////////////////////////////////////////////
-
-struct Light {
-    int type;
-    vec3 color;
-    vec3 direction;
-    vec3 position;
-    int intensity;
-    int range;
-};
-
-layout(binding = 0, std140) uniform GlobalParams 
-{
-    vec3 uCameraPosition;
-    int uLightCount;
-    Light uLight[16];
-};
+#endif
 
-in vec2 vTexCoord;
+#elif defined(FRAGMENT) || defined(COMPUTE) ///////////////////////////
 
 uniform sampler2D uColor;
 uniform sampler2D uNormals;
 uniform sampler2D uDepth;
 uniform sampler2D uPosition;
 uniform sampler2D uViewDir;
-uniform int uGBuffer;
 uniform float uNear;
 uniform float uFar;
 
-layout(location = 0) out vec4 oColor;
+// Inverse of EncodeOctahedral in RENDER_GEOMETRY
+vec3 DecodeOctahedral(vec2 aEncoded)
+{
+    vec2 e = aEncoded * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
 
-vec3 CalcPointLight(Light alight, vec3 aNormal, vec3 aPosition, vec3 aViewDir)
+struct GBufferSample
 {
-    vec3 lightDir = normalize(alight.position - aPosition);
-    vec3 viewDir = normalize(aViewDir);
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    
-    // Diffuse
-    float diff = max(dot(aNormal, lightDir), 0.0);
-    
-    // Specular (Blinn-Phong)
-    float spec = pow(max(dot(aNormal, halfwayDir), 0.0), 32.0);
-    
-    // Attenuation
-    float distance = length(alight.position - aPosition);
-    float attenuation = clamp(1.0 - distance/float(alight.range), 0.0, 1.0);
-    attenuation *= attenuation * 1.0 / (distance * distance + 1.0);
-    
-    // Combine all components and apply attenuation & intensity
-    vec3 ambient = alight.color * 0.1;
-    vec3 diffuse = alight.color * diff * 0.8;
-    vec3 specular = alight.color * spec * 0.5;
-    
-    vec3 result = (ambient + diffuse + specular) * attenuation;
-    return result * float(alight.intensity);
+    vec3 color;
+    vec3 normal;
+    float depth;
+    vec3 position;
+    vec3 viewDir;
+};
+
+// Reads one pixel of either G-buffer layout. The compact one only stores the
+// depth, the world position comes back through the inverse view-projection.
+GBufferSample FetchGBuffer(ivec2 aPixel)
+{
+    GBufferSample gBuffer;
+    gBuffer.color = texelFetch(uColor, aPixel, 0).rgb;
+    gBuffer.depth = texelFetch(uDepth, aPixel, 0).r;
+
+    if (uCompactGBuffer != 0)
+    {
+        gBuffer.normal = DecodeOctahedral(texelFetch(uNormals, aPixel, 0).xy);
+
+        vec2 uv = (vec2(aPixel) + 0.5) / vec2(uViewportSize);
+        vec4 position = uInverseViewProjection * vec4(vec3(uv, gBuffer.depth) * 2.0 - 1.0, 1.0);
+        gBuffer.position = position.xyz / position.w;
+        gBuffer.viewDir = uCameraPosition - gBuffer.position;
+    }
+    else
+    {
+        gBuffer.normal = texelFetch(uNormals, aPixel, 0).xyz;
+        gBuffer.position = texelFetch(uPosition, aPixel, 0).xyz;
+        gBuffer.viewDir = texelFetch(uViewDir, aPixel, 0).xyz;
+    }
+    return gBuffer;
 }
 
-vec3 CalcDirLight(Light alight, vec3 aNormal, vec3 aViewDir)
+#include "LIGHTING.glsl"
+
+#if defined(FRAGMENT) && defined(LIGHT_VOLUME)
+
+flat in int vLightIndex;
+
+layout(location = 0) out vec4 oColor;
+
+void main()
 {
-    vec3 lightDir = -normalize(alight.direction); // Ensure direction is normalized
-    vec3 halfwayDir = normalize(lightDir + normalize(aViewDir));
-    
-    float diff = max(dot(aNormal, lightDir), 0.0);
-    float spec = pow(max(dot(aNormal, halfwayDir), 0.0), 64.0);
-    
-    // Apply intensity to all components
-    vec3 result = alight.color * (0.1 + diff * 0.7 + spec * 0.2);
-    return result * float(alight.intensity);
+    GBufferSample gBuffer = FetchGBuffer(ivec2(gl_FragCoord.xy));
+
+    // Blended additively over the directional lighting
+    oColor = vec4(CalcPointLight(uLight[vLightIndex], gBuffer.normal, gBuffer.position, gBuffer.viewDir) * gBuffer.color, 1.0);
 }
 
+#elif defined(FRAGMENT)
+
+in vec2 vTexCoord;
+
+uniform int uGBuffer;
+uniform int uDirectionalOnly; // Point lights are drawn as light volumes
+
+layout(location = 0) out vec4 oColor;
+
 void main()
 {
-    vec3 Color = texture(uColor, vTexCoord).rgb;
-    vec3 Normal = texture(uNormals, vTexCoord).xyz;
-    float Depth = texture(uDepth, vTexCoord).r;
-    vec3 ViewDir = texture(uViewDir, vTexCoord).xyz;
-    vec3 Position = texture(uPosition, vTexCoord).xyz;
+    // The quad covers the G-buffer pixel for pixel
+    GBufferSample gBuffer = FetchGBuffer(ivec2(gl_FragCoord.xy));
+    vec3 Color = gBuffer.color;
+    vec3 Normal = gBuffer.normal;
+    float Depth = gBuffer.depth;
+    vec3 ViewDir = gBuffer.viewDir;
+    vec3 Position = gBuffer.position;
 
     switch(uGBuffer) {
         case 0: // Final render
         
             vec3 returnColor = vec3(0.0);
-            for(int i = 0; i < uLightCount; ++i)
+            int lightCount = uDirectionalOnly != 0 ? uDirectionalLightCount : uLightCount;
+            for(int i = 0; i < lightCount; ++i)
             {
-                vec3 lightResult = vec3(0.0);
-                if(uLight[i].type == 0)
-                {
-                    lightResult += CalcDirLight(uLight[i], Normal, ViewDir);
-                    // lightResult * SSAO
-                }
-                else if(uLight[i].type == 1)
-                {
-                    lightResult += CalcPointLight(uLight[i], Normal, Position, ViewDir);
-                }
-                returnColor += lightResult * Color;
+                returnColor += CalcLight(uLight[i], Normal, Position, ViewDir) * Color;
             }
 
             oColor = vec4(returnColor, 1.0);
@@ -135,5 +194,181 @@ void main()
     }
 }
 
+#elif defined(COMPUTE)
+
+// Tiled deferred lighting: every work group owns a TILE_SIZE x TILE_SIZE
+// screen tile, culls the point lights against the tile frustum into a
+// shared list, and then shades its pixels with the surviving lights only.
+
+#define TILE_SIZE 16
+#define MAX_LIGHTS_PER_TILE 1024
+
+layout(local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+layout(binding = 0, rgba16f) writeonly uniform image2D uOutput;
+
+uniform mat4 uView;
+uniform mat4 uInverseProjection;
+
+shared uint sMinDepth;
+shared uint sMaxDepth;
+shared uint sTileLightCount;
+shared uint sTileLights[MAX_LIGHTS_PER_TILE];
+
+float LinearizeDepth(float aDepth)
+{
+    return (uNear * uFar) / (uFar - aDepth * (uFar - uNear));
+}
+
+// View space point on the far plane behind the given NDC coordinates
+vec3 UnprojectFar(vec2 aNdc)
+{
+    vec4 point = uInverseProjection * vec4(aNdc, 1.0, 1.0);
+    return point.xyz / point.w;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 screenSize = uViewportSize;
+    bool inside = all(lessThan(pixel, screenSize));
+    uint localIndex = gl_LocalInvocationIndex;
+
+    if (localIndex == 0)
+    {
+        sMinDepth = 0x7F7FFFFFu; // FLT_MAX bits
+        sMaxDepth = 0u;
+        sTileLightCount = 0u;
+    }
+    barrier();
+
+    // --- Tile depth bounds --- //
+    float depth = inside ? texelFetch(uDepth, pixel, 0).r : 1.0;
+    bool background = depth >= 1.0; // Nothing was drawn here
+    if (!background)
+    {
+        // Positive floats keep their order when compared as uints
+        uint linearDepth = floatBitsToUint(LinearizeDepth(depth));
+        atomicMin(sMinDepth, linearDepth);
+        atomicMax(sMaxDepth, linearDepth);
+    }
+    barrier();
+
+    float minDepth = uintBitsToFloat(sMinDepth);
+    float maxDepth = uintBitsToFloat(sMaxDepth);
+
+    // --- Tile frustum (view space, planes through the eye) --- //
+    vec2 tileMin = vec2(gl_WorkGroupID.xy * TILE_SIZE) / vec2(screenSize) * 2.0 - 1.0;
+    vec2 tileMax = vec2((gl_WorkGroupID.xy + 1u) * TILE_SIZE) / vec2(screenSize) * 2.0 - 1.0;
+
+    vec3 corners[4] = vec3[4](
+        UnprojectFar(vec2(tileMin.x, tileMin.y)),
+        UnprojectFar(vec2(tileMax.x, tileMin.y)),
+        UnprojectFar(vec2(tileMax.x, tileMax.y)),
+        UnprojectFar(vec2(tileMin.x, tileMax.y)));
+    vec3 center = UnprojectFar((tileMin + tileMax) * 0.5);
+
+    vec3 planes[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        planes[i] = normalize(cross(corners[i], corners[(i + 1) % 4]));
+        // Orient every plane so the tile lies on its positive side
+        if (dot(planes[i], center) < 0.0)
+        {
+            planes[i] = -planes[i];
+        }
+    }
+
+    // --- Light culling, one light per invocation per step --- //
+    if (sMaxDepth != 0u)
+    {
+        for (uint i = localIndex; i < uint(uLightCount); i += TILE_SIZE * TILE_SIZE)
+        {
+            Light light = uLight[i];
+            bool visible = true;
+
+            if (light.type == 1)
+            {
+                vec3 position = (uView * vec4(light.position, 1.0)).xyz;
+                float viewDepth = -position.z;
+
+                visible = viewDepth + light.range >= minDepth && viewDepth - light.range <= maxDepth;
+                for (int p = 0; p < 4 && visible; ++p)
+                {
+                    visible = dot(planes[p], position) >= -light.range;
+                }
+            }
+
+            if (visible)
+            {
+                uint slot = atomicAdd(sTileLightCount, 1u);
+                if (slot < MAX_LIGHTS_PER_TILE)
+                {
+                    sTileLights[slot] = i;
+                }
+            }
+        }
+    }
+    barrier();
+
+    if (!inside)
+    {
+        return;
+    }
+
+    // --- Shading --- //
+    vec3 returnColor = vec3(0.0);
+    if (!background)
+    {
+        GBufferSample gBuffer = FetchGBuffer(pixel);
+
+        uint lightCount = min(sTileLightCount, uint(MAX_LIGHTS_PER_TILE));
+        for (uint i = 0u; i < lightCount; ++i)
+        {
+            returnColor += CalcLight(uLight[sTileLights[i]], gBuffer.normal, gBuffer.position, gBuffer.viewDir) * gBuffer.color;
+        }
+    }
+
+    imageStore(uOutput, pixel, vec4(returnColor, 1.0));
+}
+
+#endif
+#endif
+#endif
+
+#if defined(UPSCALE)
+
+// Stretches the part of the lighting output the frame was rendered to over
+// the backbuffer, see DynamicResolution
+
+#if defined(VERTEX) ///////////////////////////////////////////////////
+
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec2 aTexCoord;
+
+out vec2 vTexCoord;
+
+void main()
+{
+    vTexCoord = aTexCoord;
+    gl_Position = vec4(aPosition, 1.0);
+}
+
+#elif defined(FRAGMENT) ///////////////////////////////////////////////
+
+in vec2 vTexCoord;
+
+uniform sampler2D uSource;      // Bilinear sampler
+uniform vec2 uSourceScale;      // Rendered size over the texture size
+
+layout(location = 0) out vec4 oColor;
+
+void main()
+{
+    // Half a texel in from the rendered edge, so nothing past it is filtered in
+    vec2 uv = min(vTexCoord * uSourceScale, uSourceScale - 0.5 / vec2(textureSize(uSource, 0)));
+    oColor = vec4(texture(uSource, uv).rgb, 1.0);
+}
+
 #endif
 #endif